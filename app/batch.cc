@@ -0,0 +1,234 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file batch.cc
+/// This file defines the functions used by `tam --batch` to run many programs
+/// concurrently.
+///
+/// Jobs are handed out to worker threads one at a time from a shared counter,
+/// so a worker that finishes a short job moves straight on to the next one.
+/// Workers share nothing but the counter and the decoded programs, which are
+/// never modified, so they do not otherwise need to synchronise.
+//
+//===-----------------------------------------------------------------------===//
+
+#include "tam/batch.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "tam/error.h"
+#include "tam/io.h"
+#include "tam/program.h"
+#include "tam/tam.h"
+
+namespace {
+
+/// A program file named by at least one job, loaded by the first worker to
+/// run one of those jobs.
+struct ProgramSlot {
+    std::once_flag once;                             ///< Guards loading
+    std::shared_ptr<const tam::TamProgram> program;  ///< Loaded program
+    std::string error;  ///< Error message if loading failed
+};
+
+/// Replace `contents` with the contents of a file, reusing its storage.
+///
+/// @return `true` if the whole file was read
+bool ReadFile(const std::string& filename, std::string& contents) {
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (!file) return false;
+
+    contents.clear();
+    char buffer[1 << 16];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof buffer, file)) > 0)
+        contents.append(buffer, count);
+
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+/// Load and run a single job.
+///
+/// @param emulator emulator to run the job in, which is left reading from and
+/// writing to nothing
+/// @param job the job to run
+/// @param slot the program named by the job
+/// @param input storage for the job's input
+/// @return the outcome of the job, apart from its wall time
+BatchResult RunJob(tam::TamEmulator& emulator, const BatchJob& job,
+                   ProgramSlot& slot, std::string& input) {
+    // report a missing program as `tam` itself does
+    if (!std::filesystem::is_regular_file(job.program))
+        return BatchResult{
+            1, "error: io error: file '" + job.program + "' not found"};
+
+    std::call_once(slot.once, [&] {
+        try {
+            slot.program = tam::TamProgram::FromFile(job.program);
+        } catch (const std::exception& e) {
+            slot.error = e.what();
+        }
+    });
+    if (!slot.program) return BatchResult{2, slot.error};
+
+    if (job.input.empty()) {
+        input.clear();
+    } else if (!ReadFile(job.input, input)) {
+        std::string message = "could not read input file '" + job.input + "'";
+        return BatchResult{1, tam::IoError(message.c_str()).what()};
+    }
+
+    std::unique_ptr<tam::OutputSink> output;
+    if (job.output.empty()) {
+        output = std::make_unique<tam::NullOutput>();
+    } else {
+        FILE* file = fopen(job.output.c_str(), "wb");
+        if (!file) {
+            std::string message =
+                "could not open output file '" + job.output + "'";
+            return BatchResult{1, tam::IoError(message.c_str()).what()};
+        }
+        output = std::make_unique<tam::BufferedFileOutput>(file, true);
+    }
+    tam::OutputSink* sink = output.get();
+
+    emulator.LoadProgram(slot.program);
+    emulator.Reset(std::make_unique<tam::MemoryInput>(input),
+                   std::move(output));
+    tam::RunResult run = emulator.Run(std::numeric_limits<uint64_t>::max());
+
+    BatchResult result;
+    if (run.reason == tam::StopReason::kError) {
+        result = BatchResult{3, run.error};
+    } else {
+        sink->Flush();
+        if (sink->Failed()) {
+            std::string message =
+                "could not write output file '" + job.output + "'";
+            result = BatchResult{1, tam::IoError(message.c_str()).what()};
+        }
+    }
+
+    // close the output file now rather than when the next job starts
+    emulator.Reset(std::make_unique<tam::MemoryInput>(nullptr, 0),
+                   std::make_unique<tam::NullOutput>());
+    return result;
+}
+
+}  // namespace
+
+std::vector<BatchJob> ReadBatchFile(std::istream& in, const std::string& name) {
+    std::vector<BatchJob> jobs;
+    std::string line;
+    for (int number = 1; std::getline(in, line); ++number) {
+        std::istringstream fields(line);
+        std::string names[4];
+        int count = 0;
+        while (count < 4 && fields >> names[count]) ++count;
+        if (count == 0 || names[0][0] == '#') continue;
+        if (count > 3) {
+            std::string message = "batch file '" + name + "' line " +
+                                  std::to_string(number) +
+                                  ": expected PROGRAM [INPUT [OUTPUT]]";
+            throw tam::IoError(message.c_str());
+        }
+
+        for (std::string& field : names)
+            if (field == "-") field.clear();
+        jobs.push_back(BatchJob{names[0], names[1], names[2]});
+    }
+    return jobs;
+}
+
+std::vector<BatchResult> RunBatch(const std::vector<BatchJob>& jobs,
+                                  int threads) {
+    // the map is complete before any worker starts, so lookups need no lock
+    std::map<std::string, ProgramSlot> slots;
+    std::vector<ProgramSlot*> job_slots;
+    for (const BatchJob& job : jobs) job_slots.push_back(&slots[job.program]);
+
+    std::vector<BatchResult> results(jobs.size());
+    std::atomic<size_t> next(0);
+    auto work = [&] {
+        tam::TamEmulator emulator(
+            std::make_unique<tam::MemoryInput>(nullptr, 0),
+            std::make_unique<tam::NullOutput>());
+        emulator.EnableJit();
+        std::string input;
+
+        size_t I;
+        while ((I = next.fetch_add(1, std::memory_order_relaxed)) <
+               jobs.size()) {
+            auto start = std::chrono::steady_clock::now();
+            results[I] = RunJob(emulator, jobs[I], *job_slots[I], input);
+            results[I].seconds = std::chrono::duration<double>(
+                                     std::chrono::steady_clock::now() - start)
+                                     .count();
+        }
+    };
+
+    // the calling thread is one of the workers
+    size_t count = std::min<size_t>(threads, jobs.size());
+    std::vector<std::thread> workers;
+    for (size_t I = 1; I < count; ++I) workers.emplace_back(work);
+    work();
+    for (std::thread& worker : workers) worker.join();
+
+    return results;
+}
+
+void PrintBatchSummary(std::ostream& out, const std::vector<BatchJob>& jobs,
+                       const std::vector<BatchResult>& results,
+                       double seconds) {
+    out << " job  status   time (ms)  program" << std::endl;
+
+    size_t failed = 0;
+    for (size_t I = 0; I < jobs.size(); ++I) {
+        const BatchResult& result = results[I];
+        out << std::setw(4) << I + 1 << "  " << std::setw(6) << result.status
+            << "  " << std::setw(10) << std::fixed << std::setprecision(3)
+            << result.seconds * 1000 << "  " << jobs[I].program;
+        if (result.status) {
+            out << "  " << result.error;
+            ++failed;
+        }
+        out << std::endl;
+    }
+
+    out << jobs.size() << " jobs, " << failed << " failed, " << std::fixed
+        << std::setprecision(3) << seconds * 1000 << " ms" << std::endl;
+}
@@ -43,6 +43,44 @@ static bool IsStepTok(const char* tok) {
     return (strncmp(tok, "-s", 2) == 0 || strncmp(tok, "--step", 6) == 0);
 }
 
+static bool IsStatsTok(const char* tok) {
+    return strcmp(tok, "--stats") == 0;
+}
+
+static bool IsProfileTok(const char* tok) {
+    return strcmp(tok, "--profile") == 0;
+}
+
+static bool IsCallGraphTok(const char* tok) {
+    return strcmp(tok, "--callgraph") == 0;
+}
+
+static bool IsHeapProfileTok(const char* tok) {
+    return strcmp(tok, "--heap-profile") == 0;
+}
+
+static bool IsTraceFileTok(const char* tok) {
+    return strcmp(tok, "--trace-file") == 0;
+}
+
+static bool IsBatchTok(const char* tok) {
+    return strcmp(tok, "--batch") == 0;
+}
+
+static bool IsJobsTok(const char* tok) {
+    return strcmp(tok, "-j") == 0 || strcmp(tok, "--jobs") == 0;
+}
+
+/// Parse a positive number of worker threads.
+///
+/// @return the number, or 0 if `tok` is not a positive decimal number
+static int ParseJobCount(const char* tok) {
+    char* end;
+    long count = strtol(tok, &end, 10);
+    if (end == tok || *end || count < 1 || count > 4096) return 0;
+    return count;
+}
+
 static bool IsTraceLvlTok(const char* tok) {
     switch (tok[0]) {
         case '1':
@@ -63,7 +101,20 @@ enum StackSymbol {
     tok_trace,
     tok_trace_lvl,
     tok_step,
+    tok_stats,
+    tok_profile,
+    tok_profile_file,
+    tok_call_graph,
+    tok_call_graph_file,
+    tok_heap_profile,
+    tok_heap_profile_file,
+    tok_trace_file,
+    tok_trace_file_name,
     tok_filename,
+    tok_batch,
+    tok_batch_file,
+    tok_jobs,
+    tok_job_count,
 };
 
 std::optional<CliArgs> ParseCli(int argc, const char** argv) noexcept {
@@ -83,6 +134,33 @@ std::optional<CliArgs> ParseCli(int argc, const char** argv) noexcept {
             case Cli:
                 if (IsHelpTok(argv[i])) {
                     stack.push(tok_help);
+                } else if (IsStatsTok(argv[i])) {
+                    // may precede any other arguments
+                    stack.push(Cli);
+                    stack.push(tok_stats);
+                } else if (IsProfileTok(argv[i])) {
+                    stack.push(Cli);
+                    stack.push(tok_profile_file);
+                    stack.push(tok_profile);
+                } else if (IsCallGraphTok(argv[i])) {
+                    stack.push(Cli);
+                    stack.push(tok_call_graph_file);
+                    stack.push(tok_call_graph);
+                } else if (IsHeapProfileTok(argv[i])) {
+                    stack.push(Cli);
+                    stack.push(tok_heap_profile_file);
+                    stack.push(tok_heap_profile);
+                } else if (IsTraceFileTok(argv[i])) {
+                    stack.push(Cli);
+                    stack.push(tok_trace_file_name);
+                    stack.push(tok_trace_file);
+                } else if (IsBatchTok(argv[i])) {
+                    stack.push(tok_batch_file);
+                    stack.push(tok_batch);
+                } else if (IsJobsTok(argv[i])) {
+                    stack.push(tok_batch_file);
+                    stack.push(tok_batch);
+                    stack.push(tok_jobs);
                 } else if (IsTraceTok(argv[i])) {
                     stack.push(TraceExt);
                     stack.push(Trace);
@@ -145,14 +223,78 @@ std::optional<CliArgs> ParseCli(int argc, const char** argv) noexcept {
                 }
                 i++;
                 break;
+            case tok_stats:
+                if (IsStatsTok(argv[i])) {
+                    args.stats = true;
+                } else {
+                    args.error = true;
+                }
+                i++;
+                break;
+            case tok_profile:
+                if (!IsProfileTok(argv[i])) args.error = true;
+                i++;
+                break;
+            case tok_profile_file:
+                args.profile = argv[i];
+                i++;
+                break;
+            case tok_call_graph:
+                if (!IsCallGraphTok(argv[i])) args.error = true;
+                i++;
+                break;
+            case tok_call_graph_file:
+                args.call_graph = argv[i];
+                i++;
+                break;
+            case tok_heap_profile:
+                if (!IsHeapProfileTok(argv[i])) args.error = true;
+                i++;
+                break;
+            case tok_heap_profile_file:
+                args.heap_profile = argv[i];
+                i++;
+                break;
+            case tok_trace_file:
+                if (!IsTraceFileTok(argv[i])) args.error = true;
+                i++;
+                break;
+            case tok_trace_file_name:
+                args.trace_file = argv[i];
+                i++;
+                break;
             case tok_filename:
                 args.filename = argv[i];
                 i++;
                 break;
+            case tok_batch:
+                if (!IsBatchTok(argv[i])) args.error = true;
+                i++;
+                break;
+            case tok_batch_file:
+                args.batch = argv[i];
+                i++;
+                // the job count may also follow the batch file
+                if (i < argc && !args.jobs) stack.push(tok_jobs);
+                break;
+            case tok_jobs:
+                if (IsJobsTok(argv[i])) {
+                    stack.push(tok_job_count);
+                } else {
+                    args.error = true;
+                }
+                i++;
+                break;
+            case tok_job_count:
+                args.jobs = ParseJobCount(argv[i]);
+                if (!args.jobs) args.error = true;
+                i++;
+                break;
         }
     }
 
-    if (!stack.empty() || args.error || (!args.help && !args.filename)) {
+    if (!stack.empty() || args.error ||
+        (!args.help && !args.filename && !args.batch)) {
         return {};
     }
     return args;
@@ -18,59 +18,36 @@
 //
 /// @file main.cc
 /// This file defines the entry point of the program, along with some auxiliary
-/// functions. All file IO is handled in this file.
+/// functions.
 //
 //===-----------------------------------------------------------------------===//
 
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
+#include <algorithm>
+#include <chrono>
 #include <exception>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <optional>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "tam/batch.h"
 #include "tam/cli.h"
 #include "tam/error.h"
+#include "tam/profiler.h"
 #include "tam/tam.h"
-
-/// Load a TAM program from a file.
-///
-/// This function does not verify that the bytes read from the file form valid
-/// TAM bytecode.
-///
-/// @param filename name of file to read from
-/// @return a vector of 32-bit code words
-/// @throws std::runtime_error if the file did not contain a multiple of 4
-/// number of bytes
-static std::vector<uint32_t> ReadProgramFromFile(const std::string& filename) {
-    std::ifstream in_stream(filename, std::ios::binary);
-
-    // find file size
-    in_stream.seekg(0, in_stream.end);
-    int file_len = in_stream.tellg();
-    in_stream.seekg(0, in_stream.beg);
-
-    if (file_len % 4 != 0)
-        throw tam::IoError("program file contained incomplete instruction");
-
-    // read instructions
-    std::vector<uint32_t> codes;
-    for (int j = 0; j < file_len / 4; ++j) {
-        int c;
-        uint32_t code = 0;
-        for (int i = 0; i < 4; ++i) {
-            c = in_stream.get();
-            code = (code << 8) | c;
-        }
-        codes.push_back(code);
-    }
-    return codes;
-}
+#include "tam/trace.h"
 
 static void PrintHelpMessage() {
     std::cout << "Usage: tam [OPTIONS] FILENAME" << std::endl
+              << "       tam --batch JOBFILE [-j N]" << std::endl
               << std::endl
               << "Options:" << std::endl
               << "  -t,--trace        print the stack and allocated heap "
@@ -86,6 +63,46 @@ static void PrintHelpMessage() {
               << std::endl
               << "                    (only if trace is also given)"
               << std::endl
+              << "  --batch JOBFILE   run every job listed in JOBFILE, one "
+                 "per line as"
+              << std::endl
+              << "                    PROGRAM [INPUT [OUTPUT]], and print a "
+                 "summary"
+              << std::endl
+              << "  -j,--jobs N       run up to N batch jobs at once (default: "
+                 "one per core)"
+              << std::endl
+              << "  --stats           count the instructions and primitives "
+                 "executed and print"
+              << std::endl
+              << "                    them when the program stops"
+              << std::endl
+              << "  --profile FILE    sample where the program is every "
+                 "few instructions and"
+              << std::endl
+              << "                    write its hot spots to FILE and its "
+                 "call stacks to"
+              << std::endl
+              << "                    FILE.folded" << std::endl
+              << "  --trace-file FILE write the trace to FILE in a compact "
+                 "binary format, which"
+              << std::endl
+              << "                    tam-trace prints (at level 3 unless "
+                 "-t is also given)"
+              << std::endl
+              << "  --callgraph FILE  count and time every call of each "
+                 "procedure and write"
+              << std::endl
+              << "                    a report to FILE and a timeline to "
+                 "FILE.json"
+              << std::endl
+              << "  --heap-profile FILE"
+              << std::endl
+              << "                    record where each heap block is "
+                 "allocated and disposed"
+              << std::endl
+              << "                    of, and write a report to FILE"
+              << std::endl
               << "  -h,--help         print this help message" << std::endl;
 }
 
@@ -94,12 +111,20 @@ static void PrintHelpMessage() {
 /// @param emulator emulator to run
 /// @param trace if greater than 0, print a memory trace before returning
 /// @param step if `true` wait for key press from user before returning
+/// @param writer if not `nullptr`, record the trace here instead of printing
+/// it
 /// @return `true` if execution should continue, `false` if not
-static bool CpuCycle(tam::TamEmulator& emulator, int trace, bool step) {
+static bool CpuCycle(tam::TamEmulator& emulator, int trace, bool step,
+                     tam::TraceWriter* writer) {
     const tam::TamAddr cp = emulator.RegisterValue(tam::CP);
     const tam::TamInstruction instr = emulator.FetchDecode();
     bool running = emulator.Execute(instr);
 
+    if (writer) {
+        writer->Record(instr);
+        return running;
+    }
+
     if (trace) {
         printf("\n%04x: %s\n", cp,
                tam::GetMnemonic(instr).c_str());
@@ -129,6 +154,157 @@ static bool CpuCycle(tam::TamEmulator& emulator, int trace, bool step) {
     return running;
 }
 
+/// Print the instructions leading up to a runtime error, and the stack and
+/// heap, to the standard error.
+///
+/// @param emulator emulator whose program failed
+static void PrintPostMortem(const tam::TamEmulator& emulator) {
+    std::cout << std::flush;
+    std::cerr << std::endl << emulator.GetPostMortem() << std::endl;
+}
+
+/// Print the statistics collected while running a program, with the opcodes
+/// and primitives in order of how often they were executed.
+///
+/// @param out stream to print to
+/// @param stats the statistics
+/// @param seconds wall time the program ran for
+static void PrintStats(std::ostream& out, const tam::ExecutionStats& stats,
+                       double seconds) {
+    char line[80];
+    snprintf(line, sizeof(line), "instructions  %20llu\n",
+             (unsigned long long)stats.instructions);
+    out << line;
+    snprintf(line, sizeof(line), "seconds       %20.6f\n", seconds);
+    out << line;
+    if (seconds > 0) {
+        snprintf(line, sizeof(line), "instr/second  %20.0f\n",
+                 stats.instructions / seconds);
+        out << line;
+    }
+    snprintf(line, sizeof(line), "peak ST       %20x\n", stats.peak_st);
+    out << line;
+    snprintf(line, sizeof(line), "lowest HT     %20x\n", stats.lowest_ht);
+    out << line;
+    snprintf(line, sizeof(line), "allocations   %20llu\n",
+             (unsigned long long)stats.allocations);
+    out << line;
+
+    // print the nonzero counts of `names`, most frequent first
+    auto print_counts = [&](const char* title, const std::string* names,
+                            const uint64_t* counts, size_t size) {
+        std::vector<size_t> order;
+        for (size_t I = 0; I < size; ++I)
+            if (counts[I]) order.push_back(I);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return counts[a] > counts[b];
+        });
+
+        out << std::endl << title << std::endl;
+        for (size_t I : order) {
+            snprintf(line, sizeof(line), "  %-8s %20llu %6.2f%%\n",
+                     names[I].c_str(), (unsigned long long)counts[I],
+                     100.0 * counts[I] / stats.instructions);
+            out << line;
+        }
+    };
+    print_counts("opcodes", tam::opcode_names, stats.opcodes.data(),
+                 stats.opcodes.size());
+    print_counts("primitives", tam::primitive_names, stats.primitives.data(),
+                 stats.primitives.size());
+}
+
+/// Write the hot spots found by a profiler to `filename`, and its folded
+/// stacks to `filename` with ".folded" appended.
+///
+/// @return `true` if both files were written
+static bool WriteProfile(const tam::SamplingProfiler& profiler,
+                         const std::string& filename) {
+    std::ofstream hot_spots(filename);
+    profiler.WriteHotSpots(hot_spots);
+    std::ofstream folded(filename + ".folded");
+    profiler.WriteFoldedStacks(folded);
+    if (!hot_spots || !folded) {
+        std::cerr << "error: io error: could not write profile '" << filename
+                  << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/// Calls kept for the timeline written by `--callgraph`.
+constexpr size_t kCallGraphEvents = 100000;
+
+/// Write the report of a call graph profiler to `filename`, and its timeline
+/// to `filename` with ".json" appended.
+///
+/// @return `true` if both files were written
+static bool WriteCallGraph(const tam::CallGraphProfiler& profiler,
+                           const std::string& filename) {
+    std::ofstream report(filename);
+    profiler.WriteReport(report);
+    std::ofstream trace(filename + ".json");
+    profiler.WriteChromeTrace(trace);
+    if (!report || !trace) {
+        std::cerr << "error: io error: could not write call graph '"
+                  << filename << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/// Write the report of a heap profiler to `filename`.
+///
+/// @return `true` if the file was written
+static bool WriteHeapProfile(const tam::HeapProfiler& profiler,
+                             const std::string& filename) {
+    std::ofstream report(filename);
+    profiler.WriteReport(report);
+    if (!report) {
+        std::cerr << "error: io error: could not write heap profile '"
+                  << filename << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/// Run every job in a batch file and print a summary of their outcomes.
+///
+/// @param filename name of the batch file
+/// @param jobs number of worker threads, or 0 for one per core
+/// @return 0 if every job succeeded, otherwise the largest exit status of any
+/// job
+static int RunBatchFile(const std::string& filename, int jobs) {
+    std::ifstream in(filename);
+    if (!in) {
+        std::cerr << "error: io error: file '" << filename << "' not found"
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<BatchJob> batch;
+    try {
+        batch = ReadBatchFile(in, filename);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (!jobs) jobs = std::max(1u, std::thread::hardware_concurrency());
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<BatchResult> results = RunBatch(batch, jobs);
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    PrintBatchSummary(std::cout, batch, results, seconds);
+
+    int status = 0;
+    for (const BatchResult& result : results)
+        status = std::max(status, result.status);
+    return status;
+}
+
 int main(int argc, const char** argv) {
     std::optional<CliArgs> args = ParseCli(argc - 1, argv + 1);
     if (!args) {
@@ -141,6 +317,8 @@ int main(int argc, const char** argv) {
         return 0;
     }
 
+    if (args->batch) return RunBatchFile(*args->batch, args->jobs);
+
     if (!std::filesystem::is_regular_file(*args->filename)) {
         std::cerr << "error: io error: file '" << *args->filename
                   << "' not found" << std::endl;
@@ -149,21 +327,85 @@ int main(int argc, const char** argv) {
 
     tam::TamEmulator emulator;
     try {
-        std::vector<uint32_t> program = ReadProgramFromFile(*args->filename);
-        emulator.LoadProgram(program);
+        emulator.LoadProgramFile(*args->filename);
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
         return 2;
     }
 
-    bool running = true;
-    do {
-        try {
-            running = CpuCycle(emulator, args->trace, args->step);
-        } catch (const std::exception& e) {
-            std::cerr << e.what() << std::endl;
-            return 3;
+    if (args->stats) emulator.EnableStats();
+    std::optional<tam::SamplingProfiler> profiler;
+    if (args->profile) profiler.emplace(emulator.GetProgram());
+    std::optional<tam::CallGraphProfiler> call_graph;
+    if (args->call_graph)
+        call_graph.emplace(emulator,
+                           tam::CallGraphOptions{true, kCallGraphEvents});
+    std::optional<tam::HeapProfiler> heap_profiler;
+    if (args->heap_profile) heap_profiler.emplace(emulator);
+    auto start = std::chrono::steady_clock::now();
+
+    std::optional<tam::TraceWriter> writer;
+    if (args->trace_file) {
+        FILE* file = fopen(args->trace_file->c_str(), "wb");
+        if (!file) {
+            std::cerr << "error: io error: could not write trace '"
+                      << *args->trace_file << "'" << std::endl;
+            return 1;
         }
-    } while (running);
-    return 0;
+        writer.emplace(file, emulator, args->trace ? args->trace : 3);
+    }
+
+    int status = 0;
+    if (!args->trace && !writer) {
+        emulator.EnableJit();
+        const uint64_t max_steps = std::numeric_limits<uint64_t>::max();
+        tam::RunResult result = profiler ? profiler->Run(emulator, max_steps)
+                                         : emulator.Run(max_steps);
+        if (result.reason == tam::StopReason::kError) {
+            std::cerr << result.error << std::endl;
+            PrintPostMortem(emulator);
+            status = 3;
+        }
+    } else {
+        bool running = true;
+        uint64_t steps = 0;
+        do {
+            try {
+                running = CpuCycle(emulator, args->trace, args->step,
+                                   writer ? &*writer : nullptr);
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << std::endl;
+                PrintPostMortem(emulator);
+                status = 3;
+                break;
+            }
+            if (profiler && running && ++steps % profiler->Period() == 0)
+                profiler->Sample(emulator);
+        } while (running);
+    }
+
+    if (writer && !writer->Flush()) {
+        std::cerr << "error: io error: could not write trace '"
+                  << *args->trace_file << "'" << std::endl;
+        if (!status) status = 1;
+    }
+
+    if (args->stats) {
+        double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+        std::cout << std::flush;
+        PrintStats(std::cerr, emulator.GetStats(), seconds);
+    }
+    if (profiler && !WriteProfile(*profiler, *args->profile) && !status)
+        status = 1;
+    if (call_graph) {
+        call_graph->Finish();
+        if (!WriteCallGraph(*call_graph, *args->call_graph) && !status)
+            status = 1;
+    }
+    if (heap_profiler &&
+        !WriteHeapProfile(*heap_profiler, *args->heap_profile) && !status)
+        status = 1;
+    return status;
 }
@@ -0,0 +1,109 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file tam_trace.cc
+/// This file defines the entry point of `tam-trace`, which prints a binary
+/// trace written by `tam --trace-file` in the same format as `tam --trace`.
+//
+//===-----------------------------------------------------------------------===//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "tam/tam.h"
+#include "tam/trace.h"
+
+static void PrintHelpMessage() {
+    std::cout << "Usage: tam-trace [-t LEVEL] FILENAME" << std::endl
+              << std::endl
+              << "Print the binary trace in FILENAME as tam --trace would "
+                 "have printed it while"
+              << std::endl
+              << "the program ran." << std::endl
+              << std::endl
+              << "Options:" << std::endl
+              << "  -t,--trace LEVEL  print at most this much information "
+                 "each tick (1 to 3)"
+              << std::endl
+              << "  -h,--help         print this help message" << std::endl;
+}
+
+int main(int argc, const char** argv) {
+    if (argc == 2 &&
+        (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        PrintHelpMessage();
+        return 0;
+    }
+
+    int level = 3;
+    if (argc == 4 &&
+        (strcmp(argv[1], "-t") == 0 || strcmp(argv[1], "--trace") == 0)) {
+        level = atoi(argv[2]);
+        if (level < 1 || level > 3) {
+            PrintHelpMessage();
+            return 1;
+        }
+    } else if (argc != 2) {
+        PrintHelpMessage();
+        return 1;
+    }
+
+    const char* filename = argv[argc - 1];
+    FILE* file = nullptr;
+    if (std::filesystem::is_regular_file(filename))
+        file = fopen(filename, "rb");
+    if (!file) {
+        std::cerr << "error: io error: file '" << filename << "' not found"
+                  << std::endl;
+        return 1;
+    }
+
+    try {
+        tam::TraceReader reader(file);
+        level = std::min(level, reader.Level());
+        while (reader.Next()) {
+            printf("\n%04x: %s\n", reader.Address(),
+                   tam::GetMnemonic(reader.Instruction()).c_str());
+
+            if (level > 1) {
+                printf("\nSB   LB   ST   HT   HB   CP\n");
+                printf("%04x %04x %04x %04x %04x %04x\n",
+                       reader.RegisterValue(tam::SB),
+                       reader.RegisterValue(tam::LB),
+                       reader.RegisterValue(tam::ST),
+                       reader.RegisterValue(tam::HT),
+                       reader.RegisterValue(tam::HB),
+                       reader.RegisterValue(tam::CP));
+            }
+
+            if (level > 2) printf("\n%s", reader.GetSnapshot().c_str());
+        }
+    } catch (const std::exception& e) {
+        fflush(stdout);
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file tamc.cc
+/// This file defines the entry point of `tamc`, which translates a TAM binary
+/// into a C++ translation unit that can be compiled into a native executable.
+//
+//===-----------------------------------------------------------------------===//
+
+#include <stdint.h>
+#include <string.h>
+
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "tam/loader.h"
+#include "tam/translator.h"
+
+static void PrintHelpMessage() {
+    std::cout << "Usage: tamc [OPTIONS] FILENAME [OUTPUT]" << std::endl
+              << std::endl
+              << "Translate the TAM program in FILENAME into C++, writing it "
+                 "to OUTPUT if given"
+              << std::endl
+              << "or to the standard output otherwise. The result must be "
+                 "linked against the tam"
+              << std::endl
+              << "library." << std::endl
+              << std::endl
+              << "Options:" << std::endl
+              << "  -h,--help         print this help message" << std::endl;
+}
+
+int main(int argc, const char** argv) {
+    if (argc == 2 &&
+        (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        PrintHelpMessage();
+        return 0;
+    }
+
+    if (argc < 2 || argc > 3) {
+        PrintHelpMessage();
+        return 1;
+    }
+
+    const std::string filename = argv[1];
+    if (!std::filesystem::is_regular_file(filename)) {
+        std::cerr << "error: io error: file '" << filename << "' not found"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string source;
+    try {
+        std::vector<uint32_t> program = tam::ReadProgramFromFile(filename);
+        source = TranslateProgram(
+            program, std::filesystem::path(filename).filename().string());
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    if (argc == 2) {
+        std::cout << source;
+        return 0;
+    }
+
+    std::ofstream out(argv[2]);
+    out << source;
+    if (!out) {
+        std::cerr << "error: io error: could not write '" << argv[2] << "'"
+                  << std::endl;
+        return 2;
+    }
+    return 0;
+}
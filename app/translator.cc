@@ -0,0 +1,444 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file translator.cc
+/// This file defines the `TranslateProgram` function used by `tamc`, along
+/// with static auxiliary functions that translate individual instructions.
+///
+/// Every instruction becomes a labelled block of C++ that mirrors the
+/// corresponding handler of `TamEmulator::Run`. Jumps to fixed addresses in
+/// code memory become `goto` statements; jumps whose target is only known at
+/// run time, such as `JUMPI`, `CALLI` and `RETURN`, go through a `switch`
+/// over every address in the program.
+//
+//===-----------------------------------------------------------------------===//
+
+#include "tam/translator.h"
+
+#include <ctype.h>
+#include <stdint.h>
+
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "tam/error.h"
+#include "tam/tam.h"
+
+using tam::TamAddr;
+using tam::TamInstruction;
+
+// Definitions placed before `kCodeTop`.
+static const char* const kPrologue = R"(
+#include <stdint.h>
+
+#include <exception>
+#include <iostream>
+#include <vector>
+
+#include "tam/error.h"
+#include "tam/tam.h"
+
+namespace {
+
+using tam::ExceptionKind;
+using tam::TamAddr;
+using tam::TamData;
+)";
+
+// Definitions placed between `kCodeTop` and the translated instructions.
+static const char* const kExecute = R"(
+/// Executes the translated program using the memory, registers, primitives
+/// and heap of an ordinary emulator.
+class TranslatedProgram : public tam::TamEmulator {
+   public:
+    TranslatedProgram(const std::vector<tam::TamCode>& program) {
+        this->LoadProgram(program);
+    }
+
+    /// Execute the program until it halts.
+    ///
+    /// @throws std::runtime_error if any error occurred during execution
+    void Execute();
+};
+
+void TranslatedProgram::Execute() {
+    TamData* data = this->data_store_.data();
+    TamAddr* regs = this->registers_.data();
+    TamAddr st = regs[tam::ST], lb = regs[tam::LB], ht = regs[tam::HT];
+    TamAddr target = 0;
+
+    // translated code does not record how far up the stack it writes
+    this->stack_used_ = tam::kMemSize;
+
+    [[maybe_unused]] auto sync = [&](TamAddr cp) {
+        regs[tam::CP] = cp;
+        regs[tam::ST] = st;
+        regs[tam::LB] = lb;
+    };
+    [[maybe_unused]] auto reload = [&] {
+        st = regs[tam::ST];
+        ht = regs[tam::HT];
+    };
+    [[maybe_unused]] auto fail = [](ExceptionKind kind, TamAddr addr) {
+        throw tam::RuntimeError(kind, addr);
+    };
+    [[maybe_unused]] auto push = [&](TamData value, TamAddr addr) {
+        if (st >= ht) fail(ExceptionKind::kStackOverflow, addr);
+        data[st++] = value;
+    };
+    [[maybe_unused]] auto pop = [&](TamAddr addr) -> TamData {
+        if (st == 0) fail(ExceptionKind::kStackUnderflow, addr);
+        return data[--st];
+    };
+    [[maybe_unused]] auto check_data = [&](TamAddr addr, TamAddr at) {
+        if (addr >= st && addr <= ht)
+            fail(ExceptionKind::kDataAccessViolation, at);
+    };
+    [[maybe_unused]] auto check_code = [&](int addr, TamAddr at) {
+        if (addr >= kCodeTop) fail(ExceptionKind::kCodeAccessViolation, at);
+    };
+)";
+
+// Definitions placed after the translated instructions.
+static const char* const kEpilogue = R"(
+int main() {
+    try {
+        TranslatedProgram program(kProgram);
+        program.Execute();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 3;
+    }
+    return 0;
+}
+)";
+
+/// Get a C++ expression for the value of a register as seen by the
+/// instruction at `addr`.
+static std::string RegisterExpr(uint8_t r, TamAddr addr, TamAddr ct) {
+    switch (r) {
+        case tam::CB:
+            return "0";
+        case tam::CT:
+        case tam::PB:
+            return std::to_string(ct);
+        case tam::PT:
+            return std::to_string(ct + 29);
+        case tam::ST:
+            return "st";
+        case tam::LB:
+            return "lb";
+        case tam::HT:
+            return "ht";
+        case tam::CP:
+            return std::to_string(addr + 1);
+        default:
+            return "regs[" + std::to_string(r) + "]";
+    }
+}
+
+/// Get a C++ expression for the address `d[r]` as seen by the instruction at
+/// `addr`.
+static std::string AddressExpr(uint8_t r, int16_t d, TamAddr addr,
+                               TamAddr ct) {
+    if (r == tam::CB) return std::to_string(d);
+    const std::string reg = RegisterExpr(r, addr, ct);
+    if (d == 0) return reg;
+    if (d < 0) return reg + " - " + std::to_string(-d);
+    return reg + " + " + std::to_string(d);
+}
+
+/// Check whether the target `d[r]` of a jump or call is a fixed address in
+/// the program.
+static bool IsStaticTarget(const TamInstruction& instr, TamAddr ct) {
+    return instr.r == tam::CB && instr.d >= 0 && instr.d < ct;
+}
+
+/// Translate a jump to `d[r]`, which is already known to be taken.
+///
+static void TranslateJump(std::ostream& out, const TamInstruction& instr,
+                          TamAddr addr, TamAddr ct, const char* indent) {
+    if (IsStaticTarget(instr, ct)) {
+        out << indent << "goto L" << instr.d << ";\n";
+        return;
+    }
+    out << indent << "target = " << AddressExpr(instr.r, instr.d, addr, ct)
+        << ";\n"
+        << indent << "check_code(target, " << addr << ");\n"
+        << indent << "goto dispatch;\n";
+}
+
+/// Translate a call to one of the primitives that `Run` executes inline.
+///
+/// @return `false` if the primitive is not one of them
+static bool TranslateInlinePrimitive(std::ostream& out, int16_t d,
+                                     TamAddr addr) {
+    static const char* const kUnary[] = {"", "", "arg ? 0 : 1", "", "",
+                                         "arg + 1", "arg - 1", "-arg"};
+    static const char* const kBinary[] = {
+        "arg1 != 0 && arg2 != 0 ? 1 : 0",
+        "arg1 != 0 || arg2 != 0 ? 1 : 0",
+        "",
+        "",
+        "",
+        "arg1 + arg2",
+        "arg1 - arg2",
+        "arg1 * arg2",
+        "arg1 / arg2",
+        "arg1 % arg2",
+        "arg1 < arg2 ? 1 : 0",
+        "arg1 <= arg2 ? 1 : 0",
+        "arg1 >= arg2 ? 1 : 0",
+        "arg1 > arg2 ? 1 : 0",
+    };
+
+    switch (d) {
+        case 1:
+            return true;
+        case 2:
+        case 5:
+        case 6:
+        case 7:
+            out << "    {\n"
+                << "        TamData arg = pop(" << addr << ");\n"
+                << "        push(" << kUnary[d] << ", " << addr << ");\n"
+                << "    }\n";
+            return true;
+        case 3:
+        case 4:
+        case 8:
+        case 9:
+        case 10:
+        case 11:
+        case 12:
+        case 13:
+        case 14:
+        case 15:
+        case 16:
+            out << "    {\n"
+                << "        TamData arg2 = pop(" << addr << "), arg1 = pop("
+                << addr << ");\n";
+            if (d == 11 || d == 12)
+                out << "        if (arg2 == 0)\n"
+                    << "            fail(ExceptionKind::kDivideByZero, " << addr
+                    << ");\n";
+            out << "        push(" << kBinary[d - 3] << ", " << addr << ");\n"
+                << "    }\n";
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// Translate a single instruction.
+///
+static void TranslateInstruction(std::ostream& out, const TamInstruction& instr,
+                                 TamAddr addr, TamAddr ct) {
+    const std::string target = AddressExpr(instr.r, instr.d, addr, ct);
+    const int n = instr.n, d = instr.d;
+
+    switch (instr.op) {
+        case tam::LOAD:
+            out << "    {\n"
+                << "        TamAddr base_addr = " << target << ";\n"
+                << "        for (int I = 0; I < " << n << "; ++I) {\n"
+                << "            check_data(base_addr + I, " << addr << ");\n"
+                << "            push(data[TamAddr(base_addr + I)], " << addr
+                << ");\n"
+                << "        }\n"
+                << "    }\n";
+            break;
+        case tam::LOADA:
+            out << "    push(" << target << ", " << addr << ");\n";
+            break;
+        case tam::LOADI:
+            out << "    {\n"
+                << "        TamAddr base_addr = pop(" << addr << ");\n"
+                << "        for (int I = 0; I < " << n << "; ++I) {\n"
+                << "            check_data(base_addr + I, " << addr << ");\n"
+                << "            push(data[TamAddr(base_addr + I)], " << addr
+                << ");\n"
+                << "        }\n"
+                << "    }\n";
+            break;
+        case tam::LOADL:
+            out << "    push(" << d << ", " << addr << ");\n";
+            break;
+        case tam::STORE:
+        case tam::STOREI:
+            out << "    {\n";
+            if (instr.op == tam::STOREI)
+                out << "        TamAddr base_addr = pop(" << addr << ");\n";
+            out << "        if (st < " << n
+                << ") fail(ExceptionKind::kStackUnderflow, " << addr << ");\n"
+                << "        st -= " << n << ";\n";
+            if (instr.op == tam::STORE)
+                out << "        TamAddr base_addr = " << target << ";\n";
+            out << "        for (int I = 0; I < " << n << "; ++I) {\n"
+                << "            check_data(base_addr + I, " << addr << ");\n"
+                << "            data[TamAddr(base_addr + I)] = data[st + I];\n"
+                << "        }\n"
+                << "    }\n";
+            break;
+        case tam::CALL:
+            if (instr.r == tam::PB && d > 0 && d < 29) {
+                if (TranslateInlinePrimitive(out, d, addr)) break;
+                std::string name = tam::primitive_names[d];
+                name[0] = toupper(name[0]);
+                out << "    sync(" << addr + 1 << ");\n"
+                    << "    this->Primitive" << name << "();\n"
+                    << "    reload();\n";
+                break;
+            }
+            out << "    {\n"
+                << "        check_code(" << target << ", " << addr << ");\n"
+                << "        TamAddr static_link = "
+                << RegisterExpr(instr.n, addr, ct) << ";\n"
+                << "        push(static_link, " << addr << ");\n"
+                << "        push(lb, " << addr << ");\n"
+                << "        push(" << addr + 1 << ", " << addr << ");\n"
+                << "        lb = st - 3;\n";
+            if (IsStaticTarget(instr, ct)) {
+                out << "        goto L" << d << ";\n";
+            } else {
+                out << "        target = " << target << ";\n"
+                    << "        goto dispatch;\n";
+            }
+            out << "    }\n";
+            break;
+        case tam::CALLI:
+            out << "    {\n"
+                << "        TamAddr call_addr = pop(" << addr << ");\n"
+                << "        TamAddr static_link = pop(" << addr << ");\n"
+                << "        check_code(call_addr, " << addr << ");\n"
+                << "        push(static_link, " << addr << ");\n"
+                << "        push(lb, " << addr << ");\n"
+                << "        push(" << addr + 1 << ", " << addr << ");\n"
+                << "        lb = st - 3;\n"
+                << "        target = call_addr;\n"
+                << "        goto dispatch;\n"
+                << "    }\n";
+            break;
+        case tam::RETURN:
+            out << "    {\n"
+                << "        if (st < " << n
+                << ") fail(ExceptionKind::kStackUnderflow, " << addr << ");\n"
+                << "        st -= " << n << ";\n"
+                << "        TamAddr result_addr = st;\n"
+                << "        TamAddr dynamic_link = data[TamAddr(lb + 1)];\n"
+                << "        TamAddr return_addr = data[TamAddr(lb + 2)];\n"
+                << "        check_code(return_addr, " << addr << ");\n"
+                << "        if (st > lb) st = lb;\n"
+                << "        for (int I = 0; I < " << d << "; ++I) pop(" << addr
+                << ");\n"
+                << "        for (int I = 0; I < " << n << "; ++I)\n"
+                << "            push(data[TamAddr(result_addr + I)], " << addr
+                << ");\n"
+                << "        lb = dynamic_link;\n"
+                << "        target = return_addr;\n"
+                << "        goto dispatch;\n"
+                << "    }\n";
+            break;
+        case tam::PUSH:
+            // reported at `CT - 1` for consistency with `ExecutePush`
+            out << "    if (st + " << d << " >= ht)\n"
+                << "        fail(ExceptionKind::kStackOverflow, " << ct - 1
+                << ");\n"
+                << "    st += " << d << ";\n";
+            break;
+        case tam::POP:
+            out << "    {\n"
+                << "        if (st < " << n
+                << ") fail(ExceptionKind::kStackUnderflow, " << addr << ");\n"
+                << "        st -= " << n << ";\n"
+                << "        TamAddr result_addr = st;\n"
+                << "        for (int I = 0; I < " << d << "; ++I) pop(" << addr
+                << ");\n"
+                << "        for (int I = 0; I < " << n << "; ++I)\n"
+                << "            push(data[TamAddr(result_addr + I)], " << addr
+                << ");\n"
+                << "    }\n";
+            break;
+        case tam::JUMP:
+            TranslateJump(out, instr, addr, ct, "    ");
+            break;
+        case tam::JUMPI:
+            out << "    target = pop(" << addr << ");\n"
+                << "    check_code(target, " << addr << ");\n"
+                << "    goto dispatch;\n";
+            break;
+        case tam::JUMPIF:
+            out << "    if (pop(" << addr << ") == " << n << ") {\n";
+            TranslateJump(out, instr, addr, ct, "        ");
+            out << "    }\n";
+            break;
+        case tam::HALT:
+            out << "    sync(" << addr + 1 << ");\n"
+                << "    return;\n";
+            break;
+        default:
+            out << "    fail(ExceptionKind::kUnknownOpcode, " << addr << ");\n";
+            break;
+    }
+}
+
+std::string TranslateProgram(const std::vector<uint32_t>& program,
+                             const std::string& name) {
+    if (program.size() >= tam::kMemSize)
+        throw tam::IoError("program file too large");
+    const TamAddr ct = program.size();
+
+    std::ostringstream out;
+    out << "// Translated by tamc from " << name << ". Do not edit.\n"
+        << kPrologue << "\n"
+        << "constexpr const int kCodeTop = " << ct << ";\n"
+        << kExecute << "\n";
+
+    for (TamAddr addr = 0; addr < ct; ++addr) {
+        TamInstruction instr = tam::DecodeInstruction(program[addr]);
+        out << "L" << addr << ":  // " << tam::GetMnemonic(instr) << "\n";
+        TranslateInstruction(out, instr, addr, ct);
+    }
+
+    // running off the end of the program, or jumping to an address that is
+    // not in it, fails when the next instruction is fetched
+    out << "    target = " << ct << ";\n"
+        << "    goto dispatch;\n"
+        << "dispatch:\n"
+        << "    switch (target) {\n";
+    for (TamAddr addr = 0; addr < ct; ++addr)
+        out << "        case " << addr << ":\n"
+            << "            goto L" << addr << ";\n";
+    out << "        default:\n"
+        << "            fail(ExceptionKind::kCodeAccessViolation, target);\n"
+        << "    }\n"
+        << "}\n\n"
+        << "const std::vector<tam::TamCode> kProgram = {";
+
+    for (size_t I = 0; I < program.size(); ++I) {
+        out << (I % 6 ? " " : "\n    ") << "0x" << std::hex
+            << std::setfill('0') << std::setw(8) << program[I] << std::dec
+            << ",";
+    }
+    out << "\n};\n\n"
+        << "}  // namespace\n"
+        << kEpilogue;
+    return out.str();
+}
@@ -0,0 +1,41 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file bench_util.h
+/// This file defines the timing helpers shared by the benchmarks.
+//
+//===-----------------------------------------------------------------------===//
+
+#ifndef TAM_BENCH_UTIL_H__
+#define TAM_BENCH_UTIL_H__
+
+#include <stdio.h>
+
+#include <chrono>
+
+using Clock = std::chrono::steady_clock;
+
+/// Prints the mean time per operation of a phase that started at `start`.
+///
+inline void Report(const char* phase, Clock::time_point start, long ops) {
+    double ns =
+        std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    printf("%-28s %8ld ops %10.1f ns/op\n", phase, ops, ns / ops);
+}
+
+#endif  // TAM_BENCH_UTIL_H__
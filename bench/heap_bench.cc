@@ -0,0 +1,99 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file heap_bench.cc
+/// This file defines a benchmark of the heap primitives with many thousands of
+/// live blocks.
+//
+//===-----------------------------------------------------------------------===//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "tam/tam.h"
+
+#include "bench_util.h"
+
+namespace {
+
+/// Exposes the heap operations behind `new` and `dispose`.
+///
+class HeapBench : public tam::TamEmulator {
+   public:
+    using tam::TamEmulator::Allocate;
+    using tam::TamEmulator::Free;
+};
+
+}  // namespace
+
+/// Usage: heap_bench [BLOCKS [ROUNDS]]
+///
+/// Allocates BLOCKS small blocks, then performs ROUNDS of freeing and
+/// reallocating random blocks while all others stay live, and finally frees
+/// every block in random order.
+int main(int argc, char** argv) {
+    long blocks = argc > 1 ? atol(argv[1]) : 16000;
+    long rounds = argc > 2 ? atol(argv[2]) : 200000;
+    if (blocks <= 0 || blocks * 2 > tam::kMaxAddr / 2 || rounds < 0) {
+        fprintf(stderr, "heap_bench: BLOCKS must be between 1 and %d\n",
+                tam::kMaxAddr / 4);
+        return 1;
+    }
+
+    std::mt19937 rng(42);
+    HeapBench emulator;
+    std::vector<tam::TamAddr> live(blocks);
+    std::vector<int> sizes(blocks);
+
+    Clock::time_point start = Clock::now();
+    for (long I = 0; I < blocks; ++I) {
+        sizes[I] = 1 + I % 2;
+        live[I] = emulator.Allocate(sizes[I]);
+    }
+    Report("allocate", start, blocks);
+
+    start = Clock::now();
+    std::uniform_int_distribution<long> pick(0, blocks - 1);
+    for (long I = 0; I < rounds; ++I) {
+        long victim = pick(rng);
+        emulator.Free(live[victim], sizes[victim]);
+        live[victim] = emulator.Allocate(sizes[victim]);
+    }
+    Report("free + reallocate (live)", start, 2 * rounds);
+
+    std::vector<long> order(blocks);
+    for (long I = 0; I < blocks; ++I) order[I] = I;
+    std::shuffle(order.begin(), order.end(), rng);
+
+    start = Clock::now();
+    for (long I : order) emulator.Free(live[I], sizes[I]);
+    Report("free (random order)", start, blocks);
+
+    tam::HeapStats stats = emulator.GetHeapStats();
+    if (stats.heap_words != 0 || stats.allocated_blocks != 0) {
+        fprintf(stderr,
+                "heap_bench: heap not empty after freeing all blocks\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file io_bench.cc
+/// This file defines a benchmark of the `getint` and `putint` primitives
+/// against `fscanf` and `fprintf`.
+//
+//===-----------------------------------------------------------------------===//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+
+#include "tam/io.h"
+#include "tam/tam.h"
+
+#include "bench_util.h"
+
+namespace {
+
+/// Exposes the integer I/O primitives.
+///
+class IoBench : public tam::TamEmulator {
+   public:
+    IoBench(std::unique_ptr<tam::InputSource> input,
+            std::unique_ptr<tam::OutputSink> output)
+        : TamEmulator(std::move(input), std::move(output)) {}
+
+    /// Read an integer into address 0.
+    ///
+    tam::TamData Getint() {
+        this->registers_[tam::ST] = 1;
+        this->data_store_[0] = 0;
+        this->PrimitiveGetint();
+        return this->data_store_[0];
+    }
+
+    /// Write an integer.
+    ///
+    void Putint(tam::TamData n) {
+        this->data_store_[0] = n;
+        this->registers_[tam::ST] = 1;
+        this->PrimitivePutint();
+    }
+};
+
+}  // namespace
+
+/// Usage: io_bench [LINES]
+///
+/// Reads LINES random integers, one per line, with `getint` and with `fscanf`,
+/// then writes LINES integers with `putint` and with `fprintf`.
+int main(int argc, char** argv) {
+    long lines = argc > 1 ? atol(argv[1]) : 1000000;
+    if (lines <= 0) {
+        fprintf(stderr, "io_bench: LINES must be positive\n");
+        return 1;
+    }
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> value(-32768, 32767);
+    std::string input;
+    for (long I = 0; I < lines; ++I) input += std::to_string(value(rng)) + "\n";
+
+    auto output = std::make_unique<tam::BufferOutput>();
+    tam::BufferOutput& buffer = *output;
+    IoBench emulator(std::make_unique<tam::MemoryInput>(input),
+                     std::move(output));
+
+    FILE* file = tmpfile();
+    if (!file) {
+        fprintf(stderr, "io_bench: cannot create a temporary file\n");
+        return 1;
+    }
+    fwrite(input.data(), 1, input.size(), file);
+
+    long sum = 0, expected_sum = 0;
+    Clock::time_point start = Clock::now();
+    for (long I = 0; I < lines; ++I) sum += emulator.Getint();
+    Report("getint", start, lines);
+
+    rewind(file);
+    start = Clock::now();
+    for (long I = 0, n; I < lines && fscanf(file, "%ld\n", &n) == 1; ++I)
+        expected_sum += n;
+    Report("fscanf", start, lines);
+
+    start = Clock::now();
+    for (long I = 0; I < lines; ++I)
+        emulator.Putint(static_cast<tam::TamData>(I));
+    Report("putint", start, lines);
+
+    rewind(file);
+    start = Clock::now();
+    for (long I = 0; I < lines; ++I)
+        fprintf(file, "%d", static_cast<tam::TamData>(I));
+    Report("fprintf", start, lines);
+
+    std::string expected_output(buffer.str().size(), '\0');
+    rewind(file);
+    size_t read = fread(&expected_output[0], 1, expected_output.size(), file);
+    fclose(file);
+
+    if (sum != expected_sum || read != expected_output.size() ||
+        buffer.str() != expected_output) {
+        fprintf(stderr, "io_bench: primitives disagree with the C library\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file setup_bench.cc
+/// This file defines a benchmark of the cost of preparing an emulator for a
+/// short job, either by constructing a new one or by resetting an old one.
+//
+//===-----------------------------------------------------------------------===//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "tam/io.h"
+#include "tam/tam.h"
+
+#include "bench_util.h"
+
+namespace {
+
+/// Runs a job to completion and checks that it halted.
+///
+void RunJob(tam::TamEmulator& emulator) {
+    tam::RunResult result = emulator.Run(1000);
+    if (result.reason != tam::StopReason::kHalted) {
+        fprintf(stderr, "setup_bench: job did not halt\n");
+        exit(1);
+    }
+}
+
+}  // namespace
+
+/// Usage: setup_bench [JOBS]
+///
+/// Runs JOBS copies of a tiny program, first constructing an emulator for each
+/// job and then reusing one emulator with `Reset`.
+int main(int argc, char** argv) {
+    long jobs = argc > 1 ? atol(argv[1]) : 100000;
+    if (jobs <= 0) {
+        fprintf(stderr, "setup_bench: JOBS must be positive\n");
+        return 1;
+    }
+
+    // PUSH 3, LOADL 1, STORE(1) 2[SB], LOADL 2, CALL new, LOADL 1,
+    // CALL putint, HALT
+    std::vector<tam::TamCode> program{0xa0000003, 0x30000001, 0x44010002,
+                                      0x30000002, 0x6200001b, 0x30000001,
+                                      0x6200001a, 0xf0000000};
+
+    Clock::time_point start = Clock::now();
+    for (long I = 0; I < jobs; ++I) {
+        tam::TamEmulator emulator(std::make_unique<tam::MemoryInput>(""),
+                                  std::make_unique<tam::BufferOutput>());
+        emulator.LoadProgram(program);
+        RunJob(emulator);
+    }
+    Report("construct + load + run", start, jobs);
+
+    tam::TamEmulator emulator(std::make_unique<tam::MemoryInput>(""),
+                              std::make_unique<tam::BufferOutput>());
+    emulator.LoadProgram(program);
+    start = Clock::now();
+    for (long I = 0; I < jobs; ++I) {
+        emulator.Reset(std::make_unique<tam::MemoryInput>(""),
+                       std::make_unique<tam::BufferOutput>());
+        RunJob(emulator);
+    }
+    Report("reset + run", start, jobs);
+    return 0;
+}
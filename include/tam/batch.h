@@ -0,0 +1,88 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file batch.h
+/// This file declares the functions used by `tam --batch` to run many programs
+/// concurrently: `ReadBatchFile`, which parses a list of jobs, `RunBatch`,
+/// which runs them on a pool of worker threads, and `PrintBatchSummary`.
+//
+//===-----------------------------------------------------------------------===//
+
+#ifndef TAM_BATCH_H__
+#define TAM_BATCH_H__
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// A program to run, together with the files it reads from and writes to.
+///
+/// An empty `input` gives the program no input, and an empty `output`
+/// discards everything it writes.
+struct BatchJob {
+    std::string program;  ///< Name of binary file
+    std::string input;    ///< Name of file to read input from
+    std::string output;   ///< Name of file to write output to
+};
+
+/// The outcome of running a single job.
+///
+struct BatchResult {
+    int status = 0;      ///< Exit status `tam` would return for the job alone
+    std::string error;   ///< Error message if `status` is not 0
+    double seconds = 0;  ///< Wall time taken to load and run the program
+};
+
+/// Parse a list of jobs, one per line.
+///
+/// Each line holds the name of a program, optionally followed by the names of
+/// its input and output files, separated by whitespace. A name of `-` is the
+/// same as leaving it out. Blank lines and lines beginning with `#` are
+/// ignored.
+///
+/// @param in stream to read from
+/// @param name name of the stream, used in error messages
+/// @return the jobs in the order they appear
+/// @throws std::runtime_error if a line names more than three files
+std::vector<BatchJob> ReadBatchFile(std::istream& in, const std::string& name);
+
+/// Run each job in a fresh emulator state, using up to `threads` worker
+/// threads.
+///
+/// Each program file is loaded only once, however many jobs run it, and the
+/// decoded program is shared by every worker. Each worker reuses a single
+/// emulator for all the jobs it runs.
+///
+/// @param jobs the jobs to run
+/// @param threads maximum number of worker threads, which must be positive
+/// @return the outcome of each job, in the same order as `jobs`
+std::vector<BatchResult> RunBatch(const std::vector<BatchJob>& jobs,
+                                  int threads);
+
+/// Print a table of the outcome of each job, followed by a line of totals.
+///
+/// @param out stream to print to
+/// @param jobs the jobs that were run
+/// @param results the outcome of each job
+/// @param seconds wall time taken to run the whole batch
+void PrintBatchSummary(std::ostream& out, const std::vector<BatchJob>& jobs,
+                       const std::vector<BatchResult>& results,
+                       double seconds);
+
+#endif  // TAM_BATCH_H__
@@ -34,8 +34,18 @@
 /// The three flags all default to `false` for simplicity.
 struct CliArgs {
     std::optional<std::string> filename = {};  ///< Name of binary file
-    int trace = 0;                             ///< Level of trace info to print
+    std::optional<std::string> batch = {};     ///< Name of batch file
+    std::optional<std::string> profile = {};   ///< Name of profile to write
+    std::optional<std::string> call_graph = {};  ///< Name of call graph to
+                                                 ///< write
+    std::optional<std::string> heap_profile = {};  ///< Name of heap profile
+                                                   ///< to write
+    std::optional<std::string> trace_file = {};  ///< Name of binary trace to
+                                                 ///< write
+    int jobs = 0;   ///< Number of worker threads, or 0 for one per core
+    int trace = 0;  ///< Level of trace info to print
     bool step = false,  ///< If `true` wait after each instruction
+        stats = false,  ///< If `true` print execution statistics at exit
         help = false,   ///< If `true` print the help message and exit
         error = false;  ///< If `true` an error occurred during parsing
 };
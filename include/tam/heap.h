@@ -0,0 +1,119 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file heap.h
+/// This file declares the `HeapAllocator` interface, which decides where in the
+/// heap new blocks are placed, and `BestFitAllocator`, the allocator used by
+/// default.
+//
+//===-----------------------------------------------------------------------===//
+
+#ifndef TAM_HEAP_H__
+#define TAM_HEAP_H__
+
+#include <map>
+#include <optional>
+#include <set>
+#include <utility>
+
+#include "tam/tam.h"
+
+namespace tam {
+
+/// Keeps track of the free blocks inside the heap of a `TamEmulator`.
+///
+/// The emulator records allocated blocks itself, and grows the heap by moving
+/// `HT` when the allocator has no free block large enough. An allocator only
+/// ever sees blocks that lie above `HT`.
+class HeapAllocator {
+   public:
+    virtual ~HeapAllocator() = default;
+
+    /// Take a free block with room for `n` words.
+    ///
+    /// If the block chosen is larger than `n` words, the remainder is kept as
+    /// a free block.
+    ///
+    /// @param n number of words required
+    /// @return address of the first word, or nothing if no free block is
+    /// large enough
+    virtual std::optional<TamAddr> Take(int n) = 0;
+
+    /// Add a block to the free blocks, merging it with any free blocks
+    /// immediately before or after it.
+    ///
+    /// @param addr address of the first word of the block
+    /// @param n size of the block
+    virtual void Release(TamAddr addr, int n) = 0;
+
+    /// Remove the free block beginning at an address, if there is one.
+    ///
+    /// @param addr address of the first word of the block
+    /// @return size of the block removed, or 0 if none began at `addr`
+    virtual int TakeAt(TamAddr addr) = 0;
+
+    /// Get the size of the free block beginning at an address.
+    ///
+    /// @param addr address of the first word of the block
+    /// @return size of the block, or 0 if no free block begins at `addr`
+    virtual int FreeBlockSize(TamAddr addr) const = 0;
+
+    /// Fill in the `free_blocks`, `free_words` and `largest_free_block`
+    /// fields of a set of heap statistics.
+    ///
+    /// @param stats statistics to update
+    virtual void CountFreeBlocks(HeapStats& stats) const = 0;
+
+    /// Forget every free block, as when the heap is emptied.
+    ///
+    virtual void Clear() = 0;
+};
+
+/// Allocates from the smallest free block large enough, preferring the lowest
+/// address among blocks of that size.
+///
+/// Free blocks are indexed both by size and by address, so `Take`, `Release`
+/// and `TakeAt` each take logarithmic time in the number of free blocks. No two
+/// free blocks are ever adjacent.
+class BestFitAllocator : public HeapAllocator {
+   public:
+    std::optional<TamAddr> Take(int n) override;
+    void Release(TamAddr addr, int n) override;
+    int TakeAt(TamAddr addr) override;
+    int FreeBlockSize(TamAddr addr) const override;
+    void CountFreeBlocks(HeapStats& stats) const override;
+    void Clear() override;
+
+   private:
+    /// Add a free block without merging it with its neighbours.
+    ///
+    void Insert(TamAddr addr, int n);
+
+    /// Remove the free block at `block`.
+    ///
+    void Erase(std::map<TamAddr, int>::iterator block);
+
+    std::set<std::pair<int, TamAddr>>
+        by_size_;                     ///< Free blocks ordered by size
+    std::map<TamAddr, int> by_addr_;  ///< Free blocks ordered by address
+    int free_words_ = 0;              ///< Total size of all free blocks
+};
+
+}  // namespace tam
+
+#endif  // TAM_HEAP_H__
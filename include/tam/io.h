@@ -0,0 +1,309 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file io.h
+/// This file declares the `InputSource` and `OutputSink` interfaces through
+/// which the I/O primitives read and write characters, along with the sources
+/// and sinks provided by the library.
+//
+//===-----------------------------------------------------------------------===//
+
+#ifndef TAM_IO_H__
+#define TAM_IO_H__
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+
+namespace tam {
+
+/// A stream of characters read by the input primitives.
+///
+/// End of input is reported in the same way as by `feof`: `Eof` only becomes
+/// true once a call to `Get` or `Peek` has tried to read past the end.
+///
+/// A source may also report that no character is ready yet by returning
+/// `kWouldBlock`. The input primitive that was reading then returns what it
+/// read to the source with `Unget`, and the program is suspended until `Run`
+/// is called again.
+class InputSource {
+   public:
+    /// Returned by `Get` and `Peek` if no character is ready yet, but more
+    /// input may arrive later.
+    static constexpr int kWouldBlock = EOF - 1;
+
+    virtual ~InputSource() = default;
+
+    /// Read the next character.
+    ///
+    /// @return the character as an `unsigned char`, `EOF` if there is none,
+    /// or `kWouldBlock`
+    virtual int Get() = 0;
+
+    /// Read the next character without consuming it.
+    ///
+    /// @return the character as an `unsigned char`, `EOF` if there is none,
+    /// or `kWouldBlock`
+    virtual int Peek() = 0;
+
+    /// Return characters to the source so that they are read again.
+    ///
+    /// This is only called after `Get` or `Peek` has returned `kWouldBlock`,
+    /// so sources that never do so need not implement it.
+    ///
+    /// @param count number of characters most recently read by `Get`
+    virtual void Unget(size_t /*count*/) {}
+
+    /// @return `true` if a read has been attempted past the end of the input
+    virtual bool Eof() const = 0;
+
+    /// @return `true` if an error has occurred while reading
+    virtual bool Failed() const { return false; }
+};
+
+/// A stream of characters written by the output primitives.
+///
+class OutputSink {
+   public:
+    virtual ~OutputSink() = default;
+
+    /// Write a single character.
+    ///
+    /// @param c character to write
+    virtual void Put(char c) = 0;
+
+    /// Write several characters at once.
+    ///
+    /// @param data first character to write
+    /// @param size number of characters to write
+    virtual void Write(const char* data, size_t size) = 0;
+
+    /// Pass any buffered characters on to their destination.
+    ///
+    virtual void Flush() {}
+
+    /// @return `true` if an error has occurred while writing
+    virtual bool Failed() const { return false; }
+};
+
+/// Reads characters from a `FILE*` one at a time.
+///
+/// Nothing is read ahead, so the file can still be used directly between
+/// reads.
+class StdioInput : public InputSource {
+   public:
+    /// @param file file to read from
+    /// @param owned whether to close `file` on destruction
+    StdioInput(FILE* file, bool owned) : file_(file), owned_(owned) {}
+    ~StdioInput() override;
+
+    int Get() override { return getc(this->file_); }
+    int Peek() override;
+    bool Eof() const override { return feof(this->file_); }
+    bool Failed() const override { return ferror(this->file_); }
+
+   private:
+    FILE* file_;
+    bool owned_;
+};
+
+/// Writes characters to a `FILE*` as soon as they are produced.
+///
+/// Characters only pass through the file's own buffer, so output appears in
+/// order with anything else written to the file.
+class StdioOutput : public OutputSink {
+   public:
+    /// @param file file to write to
+    /// @param owned whether to close `file` on destruction
+    StdioOutput(FILE* file, bool owned) : file_(file), owned_(owned) {}
+    ~StdioOutput() override;
+
+    void Put(char c) override { putc(c, this->file_); }
+    void Write(const char* data, size_t size) override {
+        fwrite(data, 1, size, this->file_);
+    }
+    void Flush() override { fflush(this->file_); }
+    bool Failed() const override { return ferror(this->file_); }
+
+   private:
+    FILE* file_;
+    bool owned_;
+};
+
+/// Reads characters from a block of memory owned by the caller.
+///
+/// The memory is not copied and must outlive the source.
+class MemoryInput : public InputSource {
+   public:
+    /// @param data first character of the input
+    /// @param size number of characters of input
+    MemoryInput(const char* data, size_t size)
+        : next_(data), end_(data + size) {}
+
+    /// @param data input, which must not be modified while it is being read
+    explicit MemoryInput(const std::string& data)
+        : MemoryInput(data.data(), data.size()) {}
+
+    int Get() override {
+        if (this->next_ == this->end_) {
+            this->eof_ = true;
+            return EOF;
+        }
+        return static_cast<unsigned char>(*this->next_++);
+    }
+
+    int Peek() override {
+        if (this->next_ == this->end_) {
+            this->eof_ = true;
+            return EOF;
+        }
+        return static_cast<unsigned char>(*this->next_);
+    }
+
+    bool Eof() const override { return this->eof_; }
+
+   private:
+    const char *next_, *end_;
+    bool eof_ = false;
+};
+
+/// Reads characters that are supplied a piece at a time while the program
+/// runs.
+///
+/// Until `Close` is called, reading past the characters supplied so far
+/// returns `kWouldBlock` rather than `EOF`, so `TamEmulator::Run` returns
+/// `StopReason::kInputBlocked` and can be called again once more input has
+/// been supplied. This lets a single thread serve many interactive programs,
+/// feeding each from its own pipe as input arrives. A channel is not safe to
+/// use from several threads at once.
+class ChannelInput : public InputSource {
+   public:
+    /// Supply more input, after any that has not been read yet.
+    ///
+    /// @param data first character of the input
+    /// @param size number of characters of input
+    void Feed(const char* data, size_t size);
+
+    /// Supply whatever input is ready on a file descriptor, such as the read
+    /// end of a pipe that `poll` has reported readable.
+    ///
+    /// This makes a single call to `read`, so it only blocks if the descriptor
+    /// is in blocking mode and has nothing ready. If the descriptor has reached
+    /// end of file, the channel is closed.
+    ///
+    /// @param fd file descriptor to read from
+    /// @return the number of characters read, 0 at end of file, or -1 if
+    /// reading failed, in which case `errno` is set as by `read`
+    long FeedFrom(int fd);
+
+    /// Mark the end of the input, so that reading past it returns `EOF`.
+    ///
+    void Close() { this->closed_ = true; }
+
+    /// @return `true` if `Close` has been called
+    bool Closed() const { return this->closed_; }
+
+    int Get() override {
+        if (this->next_ == this->buffer_.size()) return this->End();
+        return static_cast<unsigned char>(this->buffer_[this->next_++]);
+    }
+
+    int Peek() override {
+        if (this->next_ == this->buffer_.size()) return this->End();
+        return static_cast<unsigned char>(this->buffer_[this->next_]);
+    }
+
+    void Unget(size_t count) override { this->next_ -= count; }
+    bool Eof() const override { return this->eof_; }
+
+   private:
+    int End() {
+        if (!this->closed_) return kWouldBlock;
+        this->eof_ = true;
+        return EOF;
+    }
+
+    std::string buffer_;  ///< Input supplied so far, from `next_` unread
+    size_t next_ = 0;     ///< Index of the next character to read
+    bool closed_ = false, eof_ = false;
+};
+
+/// Collects characters in a growable buffer in memory.
+///
+class BufferOutput : public OutputSink {
+   public:
+    void Put(char c) override { this->buffer_.push_back(c); }
+    void Write(const char* data, size_t size) override {
+        this->buffer_.append(data, size);
+    }
+
+    /// @return everything written so far
+    const std::string& str() const { return this->buffer_; }
+
+    /// Discard everything written so far, keeping the allocated space.
+    ///
+    void Clear() { this->buffer_.clear(); }
+
+   private:
+    std::string buffer_;
+};
+
+/// Discards every character written to it.
+///
+class NullOutput : public OutputSink {
+   public:
+    void Put(char /*c*/) override {}
+    void Write(const char* /*data*/, size_t /*size*/) override {}
+};
+
+/// Writes characters to a `FILE*` through a large buffer of its own.
+///
+/// Characters are only passed to the file when the buffer fills, when `Flush`
+/// is called, or when the sink is destroyed.
+class BufferedFileOutput : public OutputSink {
+   public:
+    static constexpr size_t kDefaultBufferSize = 1 << 16;
+
+    /// @param file file to write to
+    /// @param owned whether to close `file` on destruction
+    /// @param buffer_size number of characters to hold before writing
+    BufferedFileOutput(FILE* file, bool owned,
+                       size_t buffer_size = kDefaultBufferSize);
+    ~BufferedFileOutput() override;
+
+    void Put(char c) override {
+        if (this->used_ == this->capacity_) this->Flush();
+        this->buffer_[this->used_++] = c;
+    }
+    void Write(const char* data, size_t size) override;
+    void Flush() override;
+    bool Failed() const override { return this->failed_; }
+
+   private:
+    FILE* file_;
+    bool owned_;
+    std::unique_ptr<char[]> buffer_;
+    size_t capacity_, used_ = 0;
+    bool failed_ = false;
+};
+
+}  // namespace tam
+
+#endif  // TAM_IO_H__
@@ -0,0 +1,109 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file jit.h
+/// This file declares the `JitCode` class, which holds native x86-64 code
+/// translated from the basic blocks of a TAM program.
+//
+//===-----------------------------------------------------------------------===//
+
+#ifndef TAM_JIT_H__
+#define TAM_JIT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <exception>
+#include <memory>
+#include <vector>
+
+#include "tam/tam.h"
+
+namespace tam {
+
+/// Native code for the basic blocks of a TAM program.
+///
+/// Each block is a function taking the emulator, its data memory and its
+/// registers. It returns the address of the next instruction to execute in
+/// bits 0-15, the number of instructions executed in bits 16-47, and sets bit
+/// 63 if a primitive threw an exception, which is then held by the emulator.
+/// Blocks keep no state of their own, so emulators sharing a program can run
+/// them at the same time.
+///
+/// A block checks every way an instruction could fail before it has any side
+/// effects. If a check fails, the block returns early with the address of that
+/// instruction so that the interpreter can execute it and raise the error.
+class JitCode {
+   public:
+    typedef uint64_t (*Block)(TamEmulator*, TamData*, TamAddr*);
+
+    /// Set in the result of a block if a primitive threw an exception.
+    ///
+    static constexpr const uint64_t kExceptionFlag = uint64_t(1) << 63;
+
+    /// Whether native code can be generated on this platform.
+    ///
+    static bool Supported();
+
+    /// Translate all the basic blocks of a program.
+    ///
+    /// @param program decoded instructions of the program
+    /// @return the native code, or `nullptr` if it could not be allocated
+    static std::unique_ptr<JitCode> Compile(
+        const std::vector<DecodedInstruction>& program);
+
+    ~JitCode();
+
+    /// Get the block beginning at the given address.
+    ///
+    /// @param addr address of the first instruction of the block
+    /// @return the block, or `nullptr` if none begins there
+    Block BlockAt(TamAddr addr) const {
+        return this->offsets_[addr] < 0
+                   ? nullptr
+                   : reinterpret_cast<Block>(static_cast<uint8_t*>(
+                                                 this->memory_) +
+                                             this->offsets_[addr]);
+    }
+
+    /// Get the number of instructions in the block beginning at `addr`.
+    ///
+    uint16_t BlockLength(TamAddr addr) const { return this->lengths_[addr]; }
+
+    /// Get an upper bound on the number of words above `ST` that the block
+    /// beginning at `addr` writes.
+    uint32_t BlockPushes(TamAddr addr) const { return this->pushes_[addr]; }
+
+   private:
+    JitCode() = default;
+
+    /// Executes primitive `d` on behalf of a block.
+    ///
+    /// @return 0 on success, or 1 if the primitive threw an exception
+    static int CallPrimitive(TamEmulator* emulator, int d);
+
+    void* memory_ = nullptr;       ///< Executable memory holding all blocks
+    size_t size_ = 0;              ///< Size of `memory_` in bytes
+    std::vector<int32_t> offsets_;   ///< Offset of each block, or -1
+    std::vector<uint16_t> lengths_;  ///< Number of instructions per block
+    std::vector<uint32_t> pushes_;   ///< Words each block may push
+};
+
+}  // namespace tam
+
+#endif  // TAM_JIT_H__
@@ -0,0 +1,58 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file loader.h
+/// This file declares the functions used to read TAM binaries, in which each
+/// code word is stored as 4 big-endian bytes.
+//
+//===-----------------------------------------------------------------------===//
+
+#ifndef TAM_LOADER_H__
+#define TAM_LOADER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "tam/tam.h"
+
+namespace tam {
+
+/// Convert the big-endian words of a TAM binary into code words.
+///
+/// @param bytes first byte of the binary
+/// @param count number of words to convert
+/// @param words destination for `count` code words
+void DecodeProgramBytes(const uint8_t* bytes, size_t count, TamCode* words);
+
+/// Load a TAM program from a file.
+///
+/// This function does not verify that the bytes read from the file form valid
+/// TAM bytecode.
+///
+/// @param filename name of file to read from
+/// @return a vector of 32-bit code words
+/// @throws std::runtime_error if the file could not be read or did not contain
+/// a multiple of 4 number of bytes
+std::vector<TamCode> ReadProgramFromFile(const std::string& filename);
+
+}  // namespace tam
+
+#endif  // TAM_LOADER_H__
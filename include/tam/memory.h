@@ -0,0 +1,95 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file memory.h
+/// This file declares `ZeroedMemory`, the storage used for the code and data
+/// memory of a `TamEmulator`.
+//
+//===-----------------------------------------------------------------------===//
+
+#ifndef TAM_MEMORY_H__
+#define TAM_MEMORY_H__
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace tam {
+
+/// Obtain a block of memory that reads as zero.
+///
+/// Where the platform supports it, the memory comes straight from the
+/// operating system, which only provides and zeroes each page once it is first
+/// used.
+///
+/// @param bytes size of the block
+/// @return the start of the block
+/// @throws std::bad_alloc if no memory is available
+void* AllocateZeroedPages(size_t bytes);
+
+/// Return a block obtained from `AllocateZeroedPages`.
+///
+/// @param memory start of the block
+/// @param bytes size of the block
+void FreeZeroedPages(void* memory, size_t bytes);
+
+/// A fixed number of words, initially zero, that are only zeroed in physical
+/// memory as they are used.
+///
+/// The interface follows the parts of `std::array` used by the emulator.
+template <typename T, size_t N>
+class ZeroedMemory {
+   public:
+    ZeroedMemory()
+        : words_(static_cast<T*>(AllocateZeroedPages(N * sizeof(T)))) {}
+    ~ZeroedMemory() {
+        if (this->words_) FreeZeroedPages(this->words_, N * sizeof(T));
+    }
+
+    ZeroedMemory(const ZeroedMemory&) = delete;
+    ZeroedMemory& operator=(const ZeroedMemory&) = delete;
+    ZeroedMemory(ZeroedMemory&& other)
+        : words_(std::exchange(other.words_, nullptr)) {}
+    ZeroedMemory& operator=(ZeroedMemory&& other) {
+        std::swap(this->words_, other.words_);
+        return *this;
+    }
+
+    T& operator[](size_t I) { return this->words_[I]; }
+    const T& operator[](size_t I) const { return this->words_[I]; }
+
+    T* data() { return this->words_; }
+    const T* data() const { return this->words_; }
+    T* begin() { return this->words_; }
+    const T* begin() const { return this->words_; }
+    T* end() { return this->words_ + N; }
+    const T* end() const { return this->words_ + N; }
+    constexpr size_t size() const { return N; }
+
+    /// Set every word to `value`.
+    ///
+    void fill(const T& value) { std::fill(this->begin(), this->end(), value); }
+
+   private:
+    T* words_;
+};
+
+}  // namespace tam
+
+#endif  // TAM_MEMORY_H__
@@ -0,0 +1,395 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file profiler.h
+/// This file declares `SamplingProfiler`, which finds where a TAM program
+/// spends its time by recording where it is every so many instructions,
+/// `CallGraphProfiler`, which measures every call of every procedure, and
+/// `HeapProfiler`, which finds where a program allocates its heap blocks.
+//
+//===-----------------------------------------------------------------------===//
+
+#ifndef TAM_PROFILER_H__
+#define TAM_PROFILER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "tam/tam.h"
+
+namespace tam {
+
+class TamProgram;
+
+/// Default number of instructions between samples. It is prime so that loops
+/// whose length divides a round number are not always sampled at the same
+/// instruction.
+constexpr uint64_t kDefaultSamplePeriod = 997;
+
+/// Profiles a program by sampling `CP` and the call stack of an emulator
+/// running it every `period` instructions.
+///
+/// Procedures are inferred from the program's code: every address that is
+/// the target of a `CALL`, or loaded as a closure by `LOADA d[CB]`, is taken to
+/// be the start of a procedure. The procedure of each frame on the call stack
+/// is the one its `CALL` targeted, and otherwise the procedure that starts
+/// closest below the address being executed. Code outside any procedure,
+/// and frames whose base is 0, belong to the main program.
+///
+/// Samples are counted per address and per call stack. The counts can then be
+/// written out as a list of the hottest procedures and instructions, or as
+/// folded stacks from which flame graphs can be drawn.
+class SamplingProfiler {
+   public:
+    /// Create a profiler for a program.
+    ///
+    /// @param program program that will be profiled
+    /// @param period instructions between samples, at least 1
+    explicit SamplingProfiler(std::shared_ptr<const TamProgram> program,
+                              uint64_t period = kDefaultSamplePeriod);
+
+    /// Run an emulator as `TamEmulator::Run` does, taking a sample every
+    /// `period` instructions.
+    ///
+    /// Only native code or interpreter loops run between samples, so the
+    /// overhead is one return from `Run` and one sample per period.
+    ///
+    /// @param emulator emulator running the profiled program
+    /// @param max_steps maximum number of instructions to execute
+    /// @return the reason execution stopped and the number of steps taken
+    RunResult Run(TamEmulator& emulator, uint64_t max_steps);
+
+    /// Record where an emulator running the profiled program currently is.
+    ///
+    /// @param emulator the emulator, stopped between instructions
+    void Sample(const TamEmulator& emulator);
+
+    /// Get the number of instructions between samples.
+    ///
+    /// @return the sample period
+    uint64_t Period() const { return this->period_; }
+
+    /// Get the total number of samples taken.
+    ///
+    /// @return the number of samples
+    uint64_t SampleCount() const { return this->total_; }
+
+    /// Get the number of samples taken just before executing an address.
+    ///
+    /// @param addr code address
+    /// @return the number of samples at `addr`
+    uint64_t SamplesAt(TamAddr addr) const;
+
+    /// Get the procedure that starts closest at or below an address.
+    ///
+    /// @param addr code address
+    /// @return address of the first instruction of the procedure, or 0 for
+    /// the main program
+    TamAddr ProcedureAt(TamAddr addr) const;
+
+    /// Write the procedures and then the instructions with the most samples,
+    /// each with its share of the samples, most frequent first.
+    ///
+    /// @param out stream to write to
+    /// @param limit maximum number of instructions to list
+    void WriteHotSpots(std::ostream& out, size_t limit = 50) const;
+
+    /// Write one line per distinct call stack, with the procedures from
+    /// outermost to innermost separated by `;` and followed by the number of
+    /// samples, as read by flame graph tools.
+    ///
+    /// @param out stream to write to
+    void WriteFoldedStacks(std::ostream& out) const;
+
+   private:
+    /// Find the procedures on the call stack of an emulator, outermost first.
+    ///
+    /// @param emulator the emulator
+    /// @param stack vector to replace with the procedures
+    void FindCallStack(const TamEmulator& emulator,
+                       std::vector<TamAddr>& stack) const;
+
+    std::shared_ptr<const TamProgram> program_;  ///< Program being profiled
+    uint64_t period_;                            ///< Instructions per sample
+    uint64_t until_sample_;  ///< Instructions left before the next sample
+    uint64_t total_ = 0;     ///< Number of samples taken
+
+    std::vector<TamAddr> entries_;   ///< Start of each procedure, in order
+    std::vector<uint64_t> samples_;  ///< Samples taken at each address
+    std::vector<TamAddr> owners_;  ///< Procedure last sampled at each address
+    std::map<std::vector<TamAddr>, uint64_t>
+        stacks_;  ///< Samples per call stack, outermost procedure first
+    std::vector<TamAddr> stack_;  ///< Call stack of the latest sample
+};
+
+/// Options controlling what a `CallGraphProfiler` records.
+///
+struct CallGraphOptions {
+    bool wall_time = false;       ///< Whether to also time calls by the clock
+    size_t max_trace_events = 0;  ///< Calls kept for `WriteChromeTrace`
+};
+
+/// Totals for one procedure collected by a `CallGraphProfiler`.
+///
+/// Inclusive totals cover the procedure and everything it called. A recursive
+/// call is only included in the outermost call of the same procedure, so that
+/// no time is counted twice.
+struct ProcedureProfile {
+    uint64_t calls = 0;             ///< Times the procedure was called
+    uint64_t inclusive_steps = 0;   ///< Instructions in and below the calls
+    uint64_t exclusive_steps = 0;   ///< Instructions in the procedure itself
+    double inclusive_seconds = 0;   ///< Wall time in and below the calls
+    double exclusive_seconds = 0;   ///< Wall time in the procedure itself
+};
+
+/// Profiles a program by keeping a shadow call stack, updated on every call
+/// and return of a procedure in an emulator.
+///
+/// The main program is the outermost procedure, at address 0. Each `CALL` or
+/// `CALLI` counts as an instruction of the caller and each `RETURN` as one of
+/// the procedure returning.
+///
+/// The first `max_trace_events` calls are also kept, so that they can be shown
+/// on a timeline.
+class CallGraphProfiler : public CallListener {
+   public:
+    /// Start profiling everything an emulator executes from now on.
+    ///
+    /// @param emulator emulator to profile, which must outlive the profiler
+    /// @param options what to record
+    explicit CallGraphProfiler(TamEmulator& emulator,
+                               CallGraphOptions options = {});
+
+    /// Stop profiling the emulator.
+    ///
+    ~CallGraphProfiler() override;
+
+    CallGraphProfiler(const CallGraphProfiler&) = delete;
+    CallGraphProfiler& operator=(const CallGraphProfiler&) = delete;
+
+    void OnCall(TamAddr site, TamAddr target, uint64_t steps) override;
+    void OnReturn(TamAddr site, uint64_t steps) override;
+
+    /// End every call still in progress, including the main program, as if
+    /// they had returned after the last instruction executed.
+    ///
+    /// This should be called once the program halts or fails, before the
+    /// results are read.
+    void Finish();
+
+    /// Get the totals for each procedure called so far.
+    ///
+    /// @return the totals, by address of the procedure
+    const std::map<TamAddr, ProcedureProfile>& Procedures() const {
+        return this->procedures_;
+    }
+
+    /// Write a table of the totals for each procedure, in order of exclusive
+    /// instructions.
+    ///
+    /// @param out stream to write to
+    void WriteReport(std::ostream& out) const;
+
+    /// Write the calls that were kept in the Chrome trace event format, which
+    /// can be viewed in `chrome://tracing` or Perfetto.
+    ///
+    /// Times are in microseconds of wall time if it was recorded, and
+    /// otherwise each instruction counts as a microsecond.
+    ///
+    /// @param out stream to write to
+    void WriteChromeTrace(std::ostream& out) const;
+
+   private:
+    typedef std::chrono::steady_clock Clock;
+
+    /// A call in progress.
+    ///
+    struct Frame {
+        TamAddr entry;                ///< Procedure called
+        ProcedureProfile* procedure;  ///< Totals of `entry`
+        int* active;                  ///< Calls in progress of `entry`
+        uint64_t start_steps;    ///< Instructions executed before the call
+        Clock::time_point start_time;  ///< When the call was made
+        size_t event;  ///< Index in `events_`, or `events_.size()` if none
+    };
+
+    /// A call kept for the timeline.
+    ///
+    struct Event {
+        TamAddr entry;
+        double start;     ///< Microseconds from the start of profiling
+        double duration;  ///< Microseconds, or -1 while in progress
+    };
+
+    /// Charge the instructions and time since the last call or return to the
+    /// innermost call in progress.
+    void Charge(uint64_t steps, Clock::time_point now);
+
+    /// Begin a call of `entry`.
+    ///
+    void Push(TamAddr entry, uint64_t steps, Clock::time_point now);
+
+    /// End the innermost call in progress.
+    ///
+    void Pop(uint64_t steps, Clock::time_point now);
+
+    /// Get the time on the timeline of an event at `steps` and `now`.
+    ///
+    double Timestamp(uint64_t steps, Clock::time_point now) const;
+
+    TamEmulator& emulator_;     ///< Emulator being profiled
+    CallGraphOptions options_;  ///< What to record
+    uint64_t start_steps_;      ///< Instructions when profiling started
+    Clock::time_point start_time_;  ///< When profiling started
+
+    std::vector<Frame> frames_;  ///< Shadow call stack, innermost last
+    std::map<TamAddr, ProcedureProfile> procedures_;  ///< Totals so far
+    std::map<TamAddr, int> active_;  ///< Calls in progress of each procedure
+    std::vector<Event> events_;      ///< Calls kept for the timeline
+
+    uint64_t last_steps_ = 0;          ///< Instructions at the last event
+    Clock::time_point last_time_;      ///< Time of the last event
+};
+
+/// Totals for one allocation site collected by a `HeapProfiler`.
+///
+/// Lifetimes are measured in instructions, and only cover blocks that have
+/// been disposed of.
+struct HeapSiteProfile {
+    uint64_t allocations = 0;      ///< Blocks allocated by `new` here
+    uint64_t allocated_words = 0;  ///< Words in those blocks
+    uint64_t disposals = 0;        ///< Blocks disposed of by `dispose` here
+    uint64_t freed = 0;            ///< Blocks allocated here, since disposed of
+    uint64_t total_lifetime = 0;   ///< Sum of the lifetimes of `freed` blocks
+    uint64_t max_lifetime = 0;     ///< Longest lifetime of a `freed` block
+    uint64_t live_blocks = 0;      ///< Blocks allocated here still in use
+    uint64_t live_words = 0;       ///< Words in `live_blocks`
+};
+
+/// Profiles the heap usage of a program by following every `new` and
+/// `dispose` executed by an emulator.
+///
+/// Each call is attributed to its site: the address of the `CALL new` or
+/// `CALL dispose` and the addresses of the `CALL`s of every frame on the call
+/// stack, found as `SamplingProfiler` finds call stacks. Blocks still
+/// allocated when the program stops have leaked, or show what filled the heap
+/// if it overflowed.
+class HeapProfiler : public HeapListener {
+   public:
+    /// Start profiling every block an emulator allocates from now on.
+    ///
+    /// @param emulator emulator to profile, which must outlive the profiler
+    /// and already have a program loaded
+    explicit HeapProfiler(TamEmulator& emulator);
+
+    /// Stop profiling the emulator.
+    ///
+    ~HeapProfiler() override;
+
+    HeapProfiler(const HeapProfiler&) = delete;
+    HeapProfiler& operator=(const HeapProfiler&) = delete;
+
+    void OnAllocate(TamAddr site, TamAddr addr, int size,
+                    uint64_t steps) override;
+    void OnDispose(TamAddr site, TamAddr addr, int size,
+                   uint64_t steps) override;
+
+    /// Get the totals for each site that allocated or disposed of a block.
+    ///
+    /// @return the totals, by the addresses of the calls on the stack,
+    /// outermost first and ending with the `CALL` of the primitive
+    const std::map<std::vector<TamAddr>, HeapSiteProfile>& Sites() const {
+        return this->sites_;
+    }
+
+    /// Get the number of blocks allocated and not yet disposed of.
+    ///
+    /// @return the number of blocks
+    uint64_t LiveBlocks() const { return this->live_.size(); }
+
+    /// Get the number of words in blocks allocated and not yet disposed of.
+    ///
+    /// @return the number of words
+    uint64_t LiveWords() const { return this->live_words_; }
+
+    /// Get the largest number of words that were allocated at once.
+    ///
+    /// @return the number of words
+    uint64_t PeakLiveWords() const { return this->peak_words_; }
+
+    /// Get the number of blocks allocated of each size.
+    ///
+    /// @return the number of blocks, by size in words
+    const std::map<int, uint64_t>& SizeHistogram() const {
+        return this->sizes_;
+    }
+
+    /// Write the totals, the sites by words still in use and then by words
+    /// allocated, the sites that disposed of blocks, and the sizes of the
+    /// blocks.
+    ///
+    /// @param out stream to write to
+    void WriteReport(std::ostream& out) const;
+
+   private:
+    /// A block allocated while profiling and not yet disposed of.
+    ///
+    struct Block {
+        HeapSiteProfile* site;  ///< Totals of the site that allocated it
+        int size;               ///< Words in the block
+        uint64_t allocated_at;  ///< Instructions executed before it
+    };
+
+    /// Get the totals of the site of a call, adding it if it is new.
+    ///
+    /// @param site address of the `CALL` of the primitive
+    HeapSiteProfile& SiteOf(TamAddr site);
+
+    /// Get a description of a site, naming the procedure of each call.
+    ///
+    std::string SiteName(const std::vector<TamAddr>& site) const;
+
+    TamEmulator& emulator_;         ///< Emulator being profiled
+    std::vector<TamAddr> entries_;  ///< Start of each procedure, in order
+    size_t code_size_;              ///< Instructions in the program
+
+    std::map<std::vector<TamAddr>, HeapSiteProfile> sites_;  ///< Totals so far
+    std::map<TamAddr, Block> live_;  ///< Blocks in use, by address
+    std::map<int, uint64_t> sizes_;  ///< Blocks allocated of each size
+    std::vector<TamAddr> site_;      ///< Site of the latest call
+
+    uint64_t allocations_ = 0;      ///< Blocks allocated while profiling
+    uint64_t allocated_words_ = 0;  ///< Words in those blocks
+    uint64_t disposals_ = 0;        ///< Blocks disposed of while profiling
+    uint64_t live_words_ = 0;       ///< Words in `live_`
+    uint64_t peak_words_ = 0;       ///< Largest value of `live_words_`
+    uint64_t peak_blocks_ = 0;      ///< Blocks live when it was reached
+    uint64_t peak_steps_ = 0;       ///< Instructions when it was reached
+    uint64_t start_steps_;          ///< Instructions when profiling started
+};
+
+}  // namespace tam
+
+#endif  // TAM_PROFILER_H__
@@ -0,0 +1,134 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file program.h
+/// This file declares `TamProgram`, a decoded TAM program that any number of
+/// emulators can run at once.
+//
+//===-----------------------------------------------------------------------===//
+
+#ifndef TAM_PROGRAM_H__
+#define TAM_PROGRAM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tam/tam.h"
+
+namespace tam {
+
+class JitCode;
+
+/// A program that has been loaded and decoded once and is never modified.
+///
+/// Programs are shared between emulators through `std::shared_ptr`, so that
+/// emulators running the same program only hold their own data memory,
+/// registers and heap. All methods are safe to call from several threads.
+class TamProgram {
+   public:
+    /// Decode a program from its code words.
+    ///
+    /// @param code first code word of the program
+    /// @param size number of code words
+    /// @return the decoded program
+    /// @throws std::runtime_error if the program is too large to fit in memory
+    static std::shared_ptr<const TamProgram> FromCode(const TamCode* code,
+                                                      size_t size);
+
+    /// Decode a program from its code words.
+    ///
+    /// @param code the code words of the program
+    /// @return the decoded program
+    /// @throws std::runtime_error if the program is too large to fit in memory
+    static std::shared_ptr<const TamProgram> FromCode(
+        const std::vector<TamCode>& code);
+
+    /// Decode a program from the contents of a TAM binary, in which each code
+    /// word is stored as 4 big-endian bytes.
+    ///
+    /// @param bytes first byte of the binary
+    /// @param size number of bytes
+    /// @return the decoded program
+    /// @throws std::runtime_error if the binary does not contain a whole number
+    /// of code words, or is too large to fit in memory
+    static std::shared_ptr<const TamProgram> FromImage(const uint8_t* bytes,
+                                                       size_t size);
+
+    /// Decode a program from a TAM binary file.
+    ///
+    /// @param filename name of the file to load
+    /// @return the decoded program
+    /// @throws std::runtime_error if the file cannot be read, does not contain
+    /// a whole number of code words, or is too large to fit in memory
+    static std::shared_ptr<const TamProgram> FromFile(
+        const std::string& filename);
+
+    /// Get the program with no instructions, which emulators run until another
+    /// is loaded.
+    ///
+    static const std::shared_ptr<const TamProgram>& Empty();
+
+    ~TamProgram();
+
+    /// @return the number of code words, which is the value of `CT`
+    size_t size() const { return this->code_.size(); }
+
+    /// @return the code words of the program
+    const std::vector<TamCode>& code() const { return this->code_; }
+
+    /// @return the decoded instructions, with superinstructions substituted
+    const std::vector<DecodedInstruction>& decoded() const {
+        return this->decoded_;
+    }
+
+    /// @return the fused sequences, in order of address
+    const std::vector<Fusion>& fusions() const { return this->fusions_; }
+
+    /// Get native code for the program, translating it on first use.
+    ///
+    /// @return the native code, or `nullptr` if it could not be generated
+    const JitCode* GetJitCode() const;
+
+   private:
+    explicit TamProgram(std::vector<TamCode> code);
+
+    /// Decode every word of `code_` into `decoded_`.
+    ///
+    void Decode();
+
+    /// Replace the handlers of common instruction sequences in `decoded_` with
+    /// superinstructions, recording each in `fusions_`.
+    ///
+    void FuseInstructions();
+
+    std::vector<TamCode> code_;                ///< Code words
+    std::vector<DecodedInstruction> decoded_;  ///< Decoded code words
+    std::vector<Fusion> fusions_;              ///< Superinstructions in use
+
+    mutable std::once_flag jit_once_;       ///< Guards translation
+    mutable std::unique_ptr<JitCode> jit_;  ///< Native code for `decoded_`
+};
+
+}  // namespace tam
+
+#endif  // TAM_PROGRAM_H__
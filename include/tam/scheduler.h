@@ -0,0 +1,174 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file scheduler.h
+/// This file declares `Scheduler`, which runs many TAM programs at once on a
+/// small pool of threads by giving each a slice of instructions in turn.
+//
+//===-----------------------------------------------------------------------===//
+
+#ifndef TAM_SCHEDULER_H__
+#define TAM_SCHEDULER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "tam/io.h"
+#include "tam/tam.h"
+
+namespace tam {
+
+class TamProgram;
+
+/// Options controlling how a `Scheduler` runs its tasks.
+///
+struct SchedulerOptions {
+    int threads = 1;           ///< Number of worker threads
+    uint64_t quantum = 10000;  ///< Instructions run before switching task
+    bool jit = false;          ///< Whether to run tasks natively if possible
+};
+
+/// Runs any number of TAM programs, called tasks, on a fixed pool of worker
+/// threads.
+///
+/// Each task has its own emulator. A worker runs a task for at most `quantum`
+/// instructions and then puts it at the back of its run queue, so long-running
+/// tasks share the workers fairly. Each worker has its own queue, and takes
+/// tasks from the other queues when its own is empty.
+///
+/// A task reads from a `ChannelInput`, supplied through `Feed`. A task that
+/// tries to read input that has not been supplied yet is parked, and uses no
+/// worker until more input is supplied or its input is closed.
+///
+/// All public methods are safe to call from any thread, including from a
+/// task's completion callback.
+class Scheduler {
+   public:
+    typedef uint64_t TaskId;
+
+    /// Called on a worker thread when a task halts or fails.
+    ///
+    /// @param id the task
+    /// @param emulator the task's emulator, which is destroyed on return
+    /// @param result why the task stopped, with the number of instructions it
+    /// executed in total
+    typedef std::function<void(TaskId id, TamEmulator& emulator,
+                               const RunResult& result)>
+        Callback;
+
+    /// Start the worker threads.
+    ///
+    explicit Scheduler(const SchedulerOptions& options = SchedulerOptions());
+
+    /// Stop the worker threads, abandoning any tasks that have not finished
+    /// without calling their callbacks.
+    ///
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    /// Start running a program as a new task.
+    ///
+    /// @param program the program to run
+    /// @param output sink the program writes to
+    /// @param done called when the program halts or fails
+    /// @return the new task
+    TaskId Submit(std::shared_ptr<const TamProgram> program,
+                  std::unique_ptr<OutputSink> output, Callback done);
+
+    /// Supply more input to a task.
+    ///
+    /// @param id the task
+    /// @param data first character of the input
+    /// @param size number of characters of input
+    /// @return `false` if the task has already finished
+    bool Feed(TaskId id, const char* data, size_t size);
+
+    /// Mark the end of a task's input.
+    ///
+    /// @param id the task
+    /// @return `false` if the task has already finished
+    bool CloseInput(TaskId id);
+
+    /// Wait until every task has either finished or is parked waiting for
+    /// input.
+    ///
+    void WaitIdle();
+
+    /// @return the number of tasks that have not finished yet
+    size_t TaskCount();
+
+   private:
+    struct Task;
+
+    /// A run queue belonging to one worker.
+    ///
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task*> tasks;
+    };
+
+    /// Make a task runnable, adding it to a queue and waking a worker.
+    ///
+    void Enqueue(Task* task, size_t queue);
+
+    /// Take the next task to run, from queue `self` if possible or otherwise
+    /// from another worker's queue, waiting until there is one.
+    ///
+    /// @return the task, or `nullptr` if the scheduler is stopping
+    Task* Dequeue(size_t self);
+
+    /// Run a task for one slice and decide what happens to it next.
+    ///
+    /// @return `true` if the task can run again straight away
+    bool RunSlice(Task* task);
+
+    /// Run by each worker thread.
+    ///
+    void Work(size_t self);
+
+    const SchedulerOptions options_;
+    std::vector<Queue> queues_;
+    std::vector<std::thread> workers_;
+
+    std::atomic<size_t> queued_{0};  ///< Tasks waiting in any queue
+    std::atomic<int> sleeping_{0};   ///< Workers waiting for a task
+    std::atomic<bool> stopping_{false};
+
+    std::mutex mutex_;  ///< Guards everything below, and the input of tasks
+    std::condition_variable work_ready_;  ///< Signalled when a task is queued
+    std::condition_variable idle_;        ///< Signalled when `runnable_` is 0
+    std::unordered_map<TaskId, std::unique_ptr<Task>> tasks_;
+    TaskId next_id_ = 1;
+    size_t runnable_ = 0;  ///< Tasks queued or being run
+};
+
+}  // namespace tam
+
+#endif  // TAM_SCHEDULER_H__
@@ -26,14 +26,21 @@
 #ifndef TAM_TAM_H__
 #define TAM_TAM_H__
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
+#include <algorithm>
 #include <array>
+#include <exception>
 #include <map>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "tam/memory.h"
+
 namespace tam {
 
 typedef uint32_t TamCode;
@@ -99,6 +106,109 @@ struct TamInstruction {
     int16_t d;   ///< Signed operand
 };
 
+/// Reasons for which `TamEmulator::Run` may stop executing.
+///
+enum class StopReason {
+    kHalted,           ///< A `HALT` instruction was executed
+    kBudgetExhausted,  ///< The maximum number of steps was executed
+    kError,            ///< A runtime or I/O error occurred
+    kInputBlocked,     ///< An input primitive found no input ready yet
+};
+
+/// The outcome of a call to `TamEmulator::Run`.
+///
+struct RunResult {
+    StopReason reason;  ///< Why execution stopped
+    uint64_t steps;     ///< Number of instructions executed, including any
+                        ///< instruction that halted or failed
+    std::string error;  ///< Error message if `reason` is `kError`
+};
+
+/// Thrown by the input primitives when their input source has no character
+/// ready yet, after returning what they read to the source.
+///
+/// `Run` catches it, leaves `CP` at the `CALL` of the primitive and reports
+/// `StopReason::kInputBlocked`. It is not derived from `std::exception`, so
+/// that handlers for errors do not catch it.
+struct InputBlocked {};
+
+/// A summary of how the heap is being used.
+///
+struct HeapStats {
+    int heap_words;          ///< Words between `HT` and `HB`
+    int allocated_blocks;    ///< Number of blocks in use
+    int allocated_words;     ///< Total size of blocks in use
+    int free_blocks;         ///< Number of unused blocks below `HB`
+    int free_words;          ///< Total size of unused blocks
+    int largest_free_block;  ///< Size of the largest unused block
+};
+
+/// Counts of what a program did while statistics were enabled.
+///
+/// Each instruction of a superinstruction is counted separately, as if it had
+/// not been fused.
+struct ExecutionStats {
+    std::array<uint64_t, 16> opcodes{};  ///< Instructions run of each opcode
+    std::array<uint64_t, 29> primitives{};  ///< Calls of each primitive, by
+                                            ///< offset from `PB`
+    uint64_t instructions = 0;              ///< Total instructions run
+    TamAddr peak_st = 0;                    ///< Highest value `ST` has taken
+    TamAddr lowest_ht = kMaxAddr;           ///< Lowest value `HT` has taken
+    uint64_t allocations = 0;  ///< Number of blocks allocated on the heap
+};
+
+/// Index of the first handler in `TamEmulator::Run` that executes a primitive.
+///
+/// Handlers below this index execute the opcode of the same value, and handler
+/// `kPrimitiveHandlerBase + d` executes the primitive at offset `d`.
+constexpr const int kPrimitiveHandlerBase = 16;
+
+/// Superinstructions, each of which executes a common sequence of instructions
+/// in a single handler of `TamEmulator::Run`.
+///
+/// Only the handler of the first instruction in a sequence is replaced, so a
+/// jump into the middle of the sequence still executes the original
+/// instructions.
+enum Superinstruction {
+    kLoadlAdd = kPrimitiveHandlerBase + 29,  ///< `LOADL k; CALL add`
+    kLoadaLoadi,                             ///< `LOADA d[r]; LOADI(n)`
+    kLoadLoadLt,  ///< `LOAD(1) d[r]; LOAD(1) d'[r']; CALL lt; JUMPIF(n)`
+    kLoadLoadLe,  ///< `LOAD(1) d[r]; LOAD(1) d'[r']; CALL le; JUMPIF(n)`
+    kLoadLoadGe,  ///< `LOAD(1) d[r]; LOAD(1) d'[r']; CALL ge; JUMPIF(n)`
+    kLoadLoadGt,  ///< `LOAD(1) d[r]; LOAD(1) d'[r']; CALL gt; JUMPIF(n)`
+};
+
+/// A transfer of control recorded by the flight recorder of `TamEmulator`.
+///
+/// Instructions between two transfers run in sequence, so the recent
+/// transfers are enough to tell which instructions were executed recently.
+struct FlightRecord {
+    TamAddr from;  ///< Address of the jump, call or return
+    TamAddr to;    ///< Address of the next instruction executed
+    TamAddr st;    ///< Value of `ST` after the transfer
+    TamAddr lb;    ///< Value of `LB` after the transfer
+    TamAddr ht;    ///< Value of `HT` after the transfer
+};
+
+/// Number of transfers of control kept by the flight recorder. It must be a
+/// power of two.
+constexpr size_t kFlightRecords = 256;
+static_assert((kFlightRecords & (kFlightRecords - 1)) == 0);
+
+/// A sequence of instructions that was fused into a superinstruction.
+///
+struct Fusion {
+    TamAddr addr;         ///< Address of the first instruction in sequence
+    Superinstruction op;  ///< Superinstruction that replaced the sequence
+};
+
+/// A pre-decoded instruction, as stored in the emulator's instruction cache.
+///
+struct DecodedInstruction {
+    TamInstruction instr;  ///< The instruction itself
+    uint8_t handler;       ///< Index of the handler `Run` dispatches it to
+};
+
 // clang-format off
 
 /// List of TAM primitive routine names.
@@ -143,6 +253,18 @@ static const std::string opcode_names[] = {
     "HALT",
 };
 
+/// List of superinstruction names.
+///
+/// Index into this array corresponds to `op - kLoadlAdd`.
+static const std::string superinstruction_names[] = {
+    "LOADL;add",
+    "LOADA;LOADI",
+    "LOAD;LOAD;lt;JUMPIF",
+    "LOAD;LOAD;le;JUMPIF",
+    "LOAD;LOAD;ge;JUMPIF",
+    "LOAD;LOAD;gt;JUMPIF",
+};
+
 /// List of TAM register names.
 ///
 /// Index into this array corresponds to `instr.r`.
@@ -166,6 +288,67 @@ static const std::string register_names[] = {
 };
 // clang-format on
 
+class HeapAllocator;
+class InputSource;
+class JitCode;
+class OutputSink;
+class TamProgram;
+
+/// Receives the calls and returns of procedures executed by an emulator, see
+/// `TamEmulator::SetCallListener`.
+///
+/// `steps` is the number of instructions the emulator has executed while a
+/// listener was set, including the instruction that called or returned. The
+/// registers of the emulator may not be up to date while it is notified, and
+/// the listener must not run the emulator.
+class CallListener {
+   public:
+    virtual ~CallListener() = default;
+
+    /// Called after a `CALL` of a procedure, but not of a primitive, or after
+    /// a `CALLI`.
+    ///
+    /// @param site address of the calling instruction
+    /// @param target address of the procedure called
+    /// @param steps instructions executed so far
+    virtual void OnCall(TamAddr site, TamAddr target, uint64_t steps) = 0;
+
+    /// Called after a `RETURN`.
+    ///
+    /// @param site address of the `RETURN`
+    /// @param steps instructions executed so far
+    virtual void OnReturn(TamAddr site, uint64_t steps) = 0;
+};
+
+/// Receives the blocks allocated and disposed of by the `new` and `dispose`
+/// primitives of an emulator, see `TamEmulator::SetHeapListener`.
+///
+/// `steps` counts instructions as for `CallListener`. The registers and data
+/// memory of the emulator are up to date while it is notified, so the listener
+/// may inspect its call stack, but it must not run the emulator.
+class HeapListener {
+   public:
+    virtual ~HeapListener() = default;
+
+    /// Called after `new` allocates a block.
+    ///
+    /// @param site address of the `CALL new`
+    /// @param addr address of the block, or 0 if `size` is 0
+    /// @param size words in the block
+    /// @param steps instructions executed so far
+    virtual void OnAllocate(TamAddr site, TamAddr addr, int size,
+                            uint64_t steps) = 0;
+
+    /// Called after `dispose` frees a block.
+    ///
+    /// @param site address of the `CALL dispose`
+    /// @param addr address of the block
+    /// @param size words in the block
+    /// @param steps instructions executed so far
+    virtual void OnDispose(TamAddr site, TamAddr addr, int size,
+                           uint64_t steps) = 0;
+};
+
 /// A TAM emulator.
 ///
 /// The emulator class is responsible for simulating all operations that would
@@ -186,30 +369,73 @@ class TamEmulator {
     /// Members are initialised in the same manner as the default constructor.
     TamEmulator(FILE*, FILE*);
 
-    /// Close the input and output streams if they are not stdin or stdout.
+    /// Construct a new emulator that reads input from `input` and writes
+    /// output to `output`.
     ///
-    ~TamEmulator() {
-        if (this->instream_ != stdin) {
-            fclose(this->instream_);
-        }
+    /// Members are initialised in the same manner as the default constructor.
+    TamEmulator(std::unique_ptr<InputSource> input,
+                std::unique_ptr<OutputSink> output);
 
-        if (this->outstream_ != stdout) {
-            fclose(this->outstream_);
-        }
-    }
+    /// Flush any buffered output, and close the input and output streams if
+    /// they are not stdin or stdout.
+    ~TamEmulator();
 
     /// Sets the program to be run by this emulator.
     ///
     /// This method also sets `CT`, `PB`, `PT` based on the size of the program.
+    /// The program may be shared with any number of other emulators, which
+    /// only need their own data memory, registers and heap.
+    ///
+    /// @param program decoded program to run
+    void LoadProgram(std::shared_ptr<const TamProgram> program);
+
+    /// Sets the program to be run by this emulator.
+    ///
+    /// This method decodes every instruction of the program up front into a
+    /// new `TamProgram`, so that they do not need to be decoded again each
+    /// time they are executed.
     ///
     /// @param program program code to load
     /// @throws std::runtime_error if the provided program is too large to
     /// fit in memory
     void LoadProgram(const std::vector<TamCode>& program);
 
+    /// Sets the program to be run by this emulator from a buffer of code words
+    /// held by the caller.
+    ///
+    /// This behaves exactly like the `std::vector` overload. The words are
+    /// copied, so the buffer may be released afterwards.
+    ///
+    /// @param program first code word of the program
+    /// @param size number of code words
+    /// @throws std::runtime_error if the provided program is too large to
+    /// fit in memory
+    void LoadProgram(const TamCode* program, size_t size);
+
+    /// Sets the program to be run by this emulator from the contents of a TAM
+    /// binary, in which each code word is stored as 4 big-endian bytes.
+    ///
+    /// @param bytes first byte of the binary
+    /// @param size number of bytes
+    /// @throws std::runtime_error if the binary does not contain a whole number
+    /// of code words, or is too large to fit in memory
+    void LoadProgramImage(const uint8_t* bytes, size_t size);
+
+    /// Sets the program to be run by this emulator from a TAM binary file.
+    ///
+    /// The file is mapped into memory where the platform supports it, and
+    /// its words are converted straight into code memory.
+    ///
+    /// @param filename name of the file to load
+    /// @throws std::runtime_error if the file cannot be read, does not contain
+    /// a whole number of code words, or is too large to fit in memory
+    void LoadProgramFile(const std::string& filename);
+
     /// Obtains the next instruction to execute.
     ///
-    /// This method increments the code pointer as part of its operation.
+    /// The instruction is read from the cache of instructions decoded by
+    /// `LoadProgram`. This method increments the code pointer as part of its
+    /// operation.
     ///
     /// @return the instruction
     /// @throws std::runtime_error if the code pointer pointed outside of
@@ -221,20 +447,173 @@ class TamEmulator {
     /// @param instr instruction to execute
     /// @return `true` if execution should continue, `false` if not
     /// @throws std::runtime_error if any error occurred during execution
+    /// @throws InputBlocked if an input primitive found no input ready
     bool Execute(TamInstruction instr);
 
+    /// Executes instructions until the program halts, an error occurs, or
+    /// `max_steps` instructions have been executed.
+    ///
+    /// This is equivalent to repeatedly calling `FetchDecode` and `Execute`,
+    /// but avoids the overhead of doing so from outside the emulator. Errors
+    /// are reported in the result rather than thrown. Execution may be
+    /// continued by calling this method again.
+    ///
+    /// If the input source reports that no input is ready, execution stops
+    /// with `CP` at the input primitive that was reading, as if it had not
+    /// been executed, and continues from there when this method is next
+    /// called.
+    ///
+    /// @param max_steps maximum number of instructions to execute
+    /// @return the reason execution stopped and the number of steps taken
+    RunResult Run(uint64_t max_steps);
+
+    /// Return the emulator to the state it was in just after the program was
+    /// loaded, so that the program can be run again.
+    ///
+    /// Data memory, the heap and all registers other than `CT`, `PB` and `PT`
+    /// are cleared. The program and the input and output streams are kept.
+    /// Only the parts of data memory that the stack and heap have reached
+    /// since the last reset are cleared.
+    void Reset();
+
+    /// Return the emulator to the state it was in just after the program was
+    /// loaded, and replace its input and output.
+    ///
+    /// Any output buffered by the previous sink is flushed before it is
+    /// destroyed.
+    ///
+    /// @param input source to read input from
+    /// @param output sink to write output to
+    void Reset(std::unique_ptr<InputSource> input,
+               std::unique_ptr<OutputSink> output);
+
+    /// Make `Run` translate the program into native code and execute that
+    /// instead of interpreting it, if this is supported on the current
+    /// platform.
+    ///
+    /// Execution is otherwise identical: steps are counted per instruction and
+    /// errors are reported at the same address as by the interpreter.
+    ///
+    /// @return `true` if native code will be used
+    bool EnableJit();
+
     /// Return a string representing the current contents of the stack and any
     /// allocated blocks on the heap.
     ///
     /// @return the stack and heap contents
     const std::string GetSnapshot() const;
 
+    /// Describe the last instructions executed and the current contents of
+    /// the stack and heap, to explain how a program came to fail.
+    ///
+    /// Unless the library was built without `TAM_FLIGHT_RECORDER`, the
+    /// emulator always records the last `kFlightRecords` jumps, calls and
+    /// returns, from which the instructions are recovered. Instructions
+    /// before the oldest transfer still recorded are left out. The last
+    /// instruction listed is the one before `CP`, which is the one that
+    /// failed if execution stopped with an error. The values of `ST`, `LB`
+    /// and `HT` are shown before each instruction that was jumped to.
+    ///
+    /// @param max_instructions maximum number of instructions to list
+    /// @return the instructions, followed by a snapshot as from `GetSnapshot`
+    std::string GetPostMortem(size_t max_instructions = 32) const;
+
+    /// Get the blocks currently allocated on the heap.
+    ///
+    /// @return the size of each block, by address of its first word
+    const std::map<TamAddr, int>& GetAllocatedBlocks() const {
+        return this->allocated_blocks_;
+    }
+
+    /// Get the range of data memory written by the last call to `Execute`.
+    ///
+    /// Words outside the range were not written by that instruction. `Run`
+    /// does not keep the range up to date.
+    ///
+    /// @return the first address written and one past the last, with the first
+    /// not below the second if nothing was written
+    std::pair<int, int> GetLastWrites() const {
+        return {this->written_begin_, this->written_end_};
+    }
+
+    /// Get statistics describing the use and fragmentation of the heap.
+    ///
+    /// @return the heap statistics
+    HeapStats GetHeapStats() const;
+
+    /// Start or stop counting the instructions and primitives executed.
+    ///
+    /// Enabling statistics clears any counts collected before. While they are
+    /// enabled, `Run` interprets the program even if `EnableJit` was called,
+    /// and without superinstructions. When they are disabled, the only cost
+    /// is a test in `Execute` and `Allocate`.
+    ///
+    /// @param enabled whether to count
+    void EnableStats(bool enabled = true);
+
+    /// Get the counts collected since statistics were last enabled.
+    ///
+    /// @return the statistics
+    const ExecutionStats& GetStats() const { return this->stats_; }
+
+    /// Report every call and return of a procedure to `listener`.
+    ///
+    /// While a listener is set, `Run` interprets the program as it does while
+    /// statistics are enabled.
+    ///
+    /// @param listener listener to report to, which must outlive its use by
+    /// the emulator, or `nullptr` to stop reporting
+    void SetCallListener(CallListener* listener);
+
+    /// Report every block allocated by `new` or disposed of by `dispose` to
+    /// `listener`.
+    ///
+    /// While a listener is set, `Run` interprets the program as it does while
+    /// statistics are enabled.
+    ///
+    /// @param listener listener to report to, which must outlive its use by
+    /// the emulator, or `nullptr` to stop reporting
+    void SetHeapListener(HeapListener* listener);
+
+    /// Get the number of instructions executed while a call or heap listener
+    /// was set, as last passed to a listener.
+    ///
+    /// @return the number of instructions
+    uint64_t ListenerSteps() const { return this->listener_steps_; }
+
+    /// Get the program being run, which can be passed to `LoadProgram` of
+    /// other emulators to share it.
+    ///
+    /// @return the program
+    const std::shared_ptr<const TamProgram>& GetProgram() const {
+        return this->program_;
+    }
+
+    /// Get the superinstructions substituted in the program being run.
+    ///
+    /// @return the fused sequences, in order of address
+    const std::vector<Fusion>& GetFusions() const;
+
+    /// Replace the allocator that places blocks in the heap.
+    ///
+    /// This must be called before the program allocates any memory.
+    ///
+    /// @param allocator the new allocator
+    void SetHeapAllocator(std::unique_ptr<HeapAllocator> allocator);
+
     /// Get the current value of the specified register.
     ///
     /// @return the register value
     TamAddr RegisterValue(TamRegister r) const { return this->registers_[r]; }
 
+    /// Get the word at the specified address of data memory.
+    ///
+    /// @return the data word
+    TamData DataValue(TamAddr addr) const { return this->data_store_[addr]; }
+
    protected:
+    friend class JitCode;
+
     /// Attempt to allocate some memory on the heap.
     ///
     /// @param n size of requested block
@@ -261,6 +640,64 @@ class TamEmulator {
     /// @throws std::runtime_error if the pop would cause a stack underflow
     TamData PopData();
 
+    /// Remove `n` words from the top of the stack, leaving their values in
+    /// place above `ST`.
+    ///
+    /// @param n number of words to pop
+    /// @return address of the first word popped
+    /// @throws std::runtime_error if the stack holds fewer than `n` words
+    TamAddr PopBlock(int n);
+
+    /// Push copies of the `n` words beginning at `src`, which must not be
+    /// below `ST`.
+    ///
+    /// @param src address of the first word to push
+    /// @param n number of words to push
+    /// @throws std::runtime_error if the push would cause a stack overflow
+    void PushBlock(TamAddr src, int n);
+
+    /// Push copies of the `n` words beginning at `src`, as `LOAD` does.
+    ///
+    /// @param src address of the first word to push
+    /// @param n number of words to push
+    /// @throws std::runtime_error if a word lies between the stack and the
+    /// heap, or the push would cause a stack overflow
+    void LoadBlock(TamAddr src, int n);
+
+    /// Check that none of the `n` words beginning at `addr` lie between the
+    /// top of the stack and the top of the heap.
+    ///
+    /// @param addr address of the first word
+    /// @param n number of words
+    /// @throws std::runtime_error if any word may not be accessed
+    void CheckDataAccess(TamAddr addr, int n) const;
+
+    /// Record that a primitive has written a word that may lie between the
+    /// stack and the heap, so that `Reset` clears it.
+    ///
+    /// @param addr address of the word
+    void MarkWritten(TamAddr addr);
+
+    /// Widen the range returned by `GetLastWrites` to include `[begin, end)`.
+    ///
+    void NoteWrites(int begin, int end) {
+        this->written_begin_ = std::min(this->written_begin_, begin);
+        this->written_end_ = std::max(this->written_end_, end);
+    }
+
+    /// Copy `n` words of data memory from `src` to `dest`.
+    ///
+    /// @param dest address of the first word to write
+    /// @param src address of the first word to read
+    /// @param n number of words
+    void MoveData(TamAddr dest, TamAddr src, int n);
+
+    /// Pop the width and both operands of `eq` or `ne` from the stack.
+    ///
+    /// @return `true` if the operands are equal
+    /// @throws std::runtime_error if the stack holds too few words
+    bool PopEqualOperands();
+
     void ExecuteLoad(TamInstruction instr);
     void ExecuteLoada(TamInstruction instr);
     void ExecuteLoadi(TamInstruction instr);
@@ -305,18 +742,77 @@ class TamEmulator {
     void PrimitiveNew();
     void PrimitiveDispose();
 
-    std::array<TamCode, kMemSize> code_store_;  ///< Stores code words
-    std::array<TamData, kMemSize> data_store_;  ///< Stores data words
-    std::array<TamAddr, 16> registers_;         ///< Stores register values
+    /// Implements `Run` by interpreting the decoded program.
+    ///
+    /// @tparam kInstrumented whether to update `stats_` and count
+    /// `listener_steps_`, if they are enabled
+    template <bool kInstrumented>
+    RunResult Interpret(uint64_t max_steps);
+
+    /// Record a transfer of control in the flight recorder.
+    ///
+    void RecordTransfer(TamAddr from, TamAddr to, TamAddr st, TamAddr lb,
+                        TamAddr ht) {
+        this->flight_records_[this->flight_count_++ & (kFlightRecords - 1)] =
+            FlightRecord{from, to, st, lb, ht};
+    }
+
+    /// Count an instruction about to be executed in `stats_`.
+    ///
+    /// @param instr the instruction
+    /// @param st value of `ST` before the instruction
+    /// @param ht value of `HT` before the instruction
+    void CountInstruction(TamInstruction instr, TamAddr st, TamAddr ht);
+
+    /// Implements `Run` by executing native code where possible.
+    ///
+    RunResult RunJit(uint64_t max_steps);
+
+    std::shared_ptr<const TamProgram> program_;   ///< Program being run
+    ZeroedMemory<TamData, kMemSize> data_store_;  ///< Stores data words
+    std::array<TamAddr, 16> registers_;           ///< Stores register values
+    bool jit_enabled_ = false;  ///< Whether `Run` uses native code
+    std::exception_ptr jit_pending_;  ///< Exception thrown under native code
+    bool stats_enabled_ = false;      ///< Whether `stats_` is updated
+    ExecutionStats stats_;            ///< Counts since stats were enabled
+    CallListener* call_listener_ = nullptr;  ///< Notified of calls, if set
+    HeapListener* heap_listener_ = nullptr;  ///< Notified of blocks, if set
+    uint64_t listener_steps_ = 0;  ///< Instructions while a listener was set
+    std::array<FlightRecord, kFlightRecords>
+        flight_records_;  ///< Latest transfers, used as a ring buffer
+    uint64_t flight_count_ = 0;  ///< Transfers recorded since the last reset
+
+    int stack_used_ = 0;  ///< Words from address 0 the stack may have written
+    TamAddr heap_low_ = kMaxAddr;  ///< Lowest value `HT` has taken, or
+                                   ///< below a word a primitive wrote
+    int written_begin_ = kMemSize;  ///< First word written by the instruction
+    int written_end_ = 0;  ///< One past the last word written by it
 
     std::map<TamAddr, int>
-        allocated_blocks_,  ///< Records blocks of heap memory in use
-        free_blocks_;       ///< Records blocks of unused heap memory
+        allocated_blocks_;  ///< Records blocks of heap memory in use
+    std::unique_ptr<HeapAllocator>
+        heap_allocator_;  ///< Records blocks of unused heap memory
 
-    FILE *instream_,  ///< File that input is read from
-        *outstream_;  ///< File that output is written to
+    std::unique_ptr<InputSource> input_;  ///< Source that input is read from
+    std::unique_ptr<OutputSink> output_;  ///< Sink that output is written to
 };
 
+/// Split a code word into its component fields.
+///
+/// @param code code word to decode
+/// @return the decoded instruction
+TamInstruction DecodeInstruction(TamCode code);
+
+/// Format the contents of the stack and of allocated heap blocks, as returned
+/// by `TamEmulator::GetSnapshot`.
+///
+/// @param data data memory
+/// @param st value of `ST`
+/// @param blocks size of each allocated block, by address
+/// @return the stack and heap contents
+std::string FormatSnapshot(const TamData* data, TamAddr st,
+                           const std::map<TamAddr, int>& blocks);
+
 /// Get Mnemonic of an instruction.
 ///
 /// @param instr Instruction
@@ -27,8 +27,12 @@
 
 #include <assert.h>
 
+#include <memory>
+#include <utility>
 #include <vector>
 
+#include "tam/io.h"
+#include "tam/program.h"
 #include "tam/tam.h"
 
 #include <gtest/gtest.h>
@@ -40,22 +44,17 @@ typedef std::vector<tam::TamData>
 
 class EmulatorTest : public testing::Test, public tam::TamEmulator {
    protected:
-    /// Populate the emulator's code memory with the provided code and
-    /// set the `CT`, `PB`, and `PT` registers.
+    /// Load the provided code as a new program, set the `CT`, `PB`, and `PT`
+    /// registers, and decode the new code.
     ///
     /// @param code words of code memory to set
     void setCode(CodeVec& code) {
         assert(code.size() < 65536);
-        this->code_store_.fill(0);
+        this->LoadProgram(code);
 
-        std::copy(code.begin(), code.end(), this->code_store_.begin());
         for (int I = 0; I < code.size(); ++I) {
-            assert(code[I] == this->code_store_[I]);
+            assert(code[I] == this->program_->code()[I]);
         }
-
-        this->registers_[tam::CT] = code.size();
-        this->registers_[tam::PB] = this->registers_[tam::CT];
-        this->registers_[tam::PT] = this->registers_[tam::PB] + 29;
         assert(this->registers_[tam::CT] == code.size());
     }
 
@@ -78,18 +77,38 @@ class EmulatorTest : public testing::Test, public tam::TamEmulator {
 
     /// Set the emulator's input stream.
     ///
+    /// The stream is not closed by the emulator.
+    ///
     /// @param instream
     void setInstream(FILE* instream) {
         assert(instream);
-        this->instream_ = instream;
+        this->input_ = std::make_unique<tam::StdioInput>(instream, false);
     }
 
     /// Set the emulator's output stream.
     ///
+    /// The stream is not closed by the emulator.
+    ///
     /// @param outstream
     void setOutstream(FILE* outstream) {
         assert(outstream);
-        this->outstream_ = outstream;
+        this->output_ = std::make_unique<tam::StdioOutput>(outstream, false);
+    }
+
+    /// Set the source the emulator reads input from.
+    ///
+    /// @param input
+    void setInput(std::unique_ptr<tam::InputSource> input) {
+        assert(input);
+        this->input_ = std::move(input);
+    }
+
+    /// Set the sink the emulator writes output to.
+    ///
+    /// @param output
+    void setOutput(std::unique_ptr<tam::OutputSink> output) {
+        assert(output);
+        this->output_ = std::move(output);
     }
 };
 
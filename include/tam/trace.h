@@ -0,0 +1,206 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file trace.h
+/// This file declares `TraceWriter`, which records a compact binary trace of
+/// each instruction an emulator executes, and `TraceReader`, which replays
+/// such a trace.
+///
+/// A trace begins with a header:
+///
+/// | bytes | contents                                     |
+/// |-------|----------------------------------------------|
+/// | 8     | `kTraceMagic`                                |
+/// | 1     | format version, `kTraceVersion`              |
+/// | 1     | trace level, from 1 to 3                     |
+/// | 4     | number of code words                         |
+/// | 4 * n | the code words of the program                |
+/// | 2 * 16| the registers before the first instruction   |
+///
+/// Each instruction executed is then recorded as a tick. The first byte holds
+/// the opcode in its low four bits, and flags saying which of these follow:
+///
+/// - `kTraceRegisters`: a 16-bit mask of the registers that changed, then the
+///   new value of each, in order of register number
+/// - `kTraceWrites`: the number of runs of data words that changed, then for
+///   each its address, its length and its new words, all 16 bits
+/// - `kTraceBlocks`: the number of allocated heap blocks, then the address
+///   and size of each, all 16 bits
+///
+/// Changes are recorded after the instruction has executed, so the address of
+/// each instruction is the value of `CP` left by the one before. Registers are
+/// recorded at every level for this reason. Words and blocks are only recorded
+/// at level 3, and only words on the stack or in the heap, which are all that
+/// a snapshot shows. All values are little-endian.
+//
+//===-----------------------------------------------------------------------===//
+
+#ifndef TAM_TRACE_H__
+#define TAM_TRACE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "tam/io.h"
+#include "tam/memory.h"
+#include "tam/tam.h"
+
+namespace tam {
+
+/// First bytes of every binary trace.
+constexpr const char kTraceMagic[8] = {'T', 'A', 'M', 'T', 'R', 'A', 'C', 'E'};
+
+/// Version of the binary trace format written by `TraceWriter`.
+constexpr uint8_t kTraceVersion = 1;
+
+/// Flags in the first byte of a tick.
+enum TraceFlags : uint8_t {
+    kTraceRegisters = 0x10,  ///< Changed registers follow
+    kTraceWrites = 0x20,     ///< Changed data words follow
+    kTraceBlocks = 0x40,     ///< Allocated heap blocks follow
+};
+
+/// Records a binary trace of the instructions executed by an emulator.
+///
+/// Ticks are written through a large buffer, so the trace is only complete
+/// once the writer has been flushed or destroyed.
+class TraceWriter {
+   public:
+    /// Start a trace of an emulator that has a program loaded, and write its
+    /// header.
+    ///
+    /// @param file file to write to, which is closed by the writer
+    /// @param emulator emulator to trace, which must outlive the writer
+    /// @param level 1 to record instructions, 2 to also record registers, or
+    /// 3 to also record the stack and heap
+    TraceWriter(FILE* file, const TamEmulator& emulator, int level);
+
+    /// Record that the emulator has just executed an instruction by calling
+    /// `Execute`, which reports the words the instruction wrote.
+    ///
+    /// @param instr the instruction
+    void Record(TamInstruction instr);
+
+    /// Write out any buffered ticks.
+    ///
+    /// @return `false` if writing the trace has failed
+    bool Flush();
+
+   private:
+    /// Append a 16-bit value to `tick_`.
+    ///
+    void Put16(uint16_t value);
+
+    /// Append the runs of data words in `[begin, end)` that differ from
+    /// `shadow_` to `tick_`, and update `shadow_`.
+    ///
+    /// @return the number of runs
+    uint16_t PutWrites(int begin, int end);
+
+    const TamEmulator& emulator_;  ///< Emulator being traced
+    int level_;                    ///< What to record
+    BufferedFileOutput out_;       ///< Destination of the trace
+
+    std::array<TamAddr, 16> registers_;  ///< Registers as last recorded
+    ZeroedMemory<TamData, kMemSize> shadow_;  ///< Words as last recorded
+    std::map<TamAddr, int> blocks_;  ///< Heap blocks as last recorded
+    bool check_blocks_ = true;  ///< Whether to compare blocks on the first tick
+    bool check_words_ = true;   ///< Whether to compare all words on the first
+                                ///< tick
+    std::vector<uint8_t> tick_;  ///< Tick being assembled
+};
+
+/// Replays a binary trace one instruction at a time.
+///
+class TraceReader {
+   public:
+    /// Open a trace and read its header.
+    ///
+    /// @param file file to read from, which is closed by the reader
+    /// @throws std::runtime_error if the file is not a trace
+    explicit TraceReader(FILE* file);
+    ~TraceReader();
+
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    /// Get the level the trace was recorded at.
+    ///
+    /// @return the level, from 1 to 3
+    int Level() const { return this->level_; }
+
+    /// Read the next tick and apply its changes.
+    ///
+    /// @return `false` at the end of the trace
+    /// @throws std::runtime_error if the trace is truncated or corrupt
+    bool Next();
+
+    /// Get the address of the instruction read by the last call to `Next`.
+    ///
+    /// @return the address
+    TamAddr Address() const { return this->addr_; }
+
+    /// Get the instruction read by the last call to `Next`.
+    ///
+    /// @return the instruction
+    TamInstruction Instruction() const;
+
+    /// Get the value of a register after the instruction.
+    ///
+    /// @return the register value
+    TamAddr RegisterValue(TamRegister r) const { return this->registers_[r]; }
+
+    /// Get the stack and allocated heap blocks after the instruction, in the
+    /// same format as `TamEmulator::GetSnapshot`.
+    ///
+    /// @return the stack and heap contents
+    std::string GetSnapshot() const;
+
+   private:
+    /// Read `size` bytes into `dest`.
+    ///
+    /// @return `false` if the trace ended first
+    bool Read(void* dest, size_t size);
+
+    /// Read a 16-bit value.
+    ///
+    /// @throws std::runtime_error if the trace ended first
+    uint16_t Read16();
+
+    FILE* file_;                     ///< Trace being read
+    std::vector<uint8_t> buffer_;    ///< Bytes read but not yet consumed
+    size_t pos_ = 0, end_ = 0;       ///< Unconsumed part of `buffer_`
+
+    int level_;                          ///< Level the trace was recorded at
+    std::vector<TamCode> code_;          ///< Program being traced
+    TamAddr addr_ = 0;                   ///< Address of the last instruction
+    uint8_t opcode_ = 0;                 ///< Opcode recorded in the last tick
+    std::array<TamAddr, 16> registers_;  ///< Registers after the last tick
+    ZeroedMemory<TamData, kMemSize> data_;  ///< Stack and heap words
+    std::map<TamAddr, int> blocks_;         ///< Allocated heap blocks
+};
+
+}  // namespace tam
+
+#endif  // TAM_TRACE_H__
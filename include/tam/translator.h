@@ -0,0 +1,46 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file translator.h
+/// This file declares the `TranslateProgram` function used by `tamc` to
+/// translate TAM programs into C++.
+//
+//===-----------------------------------------------------------------------===//
+
+#ifndef TAM_TRANSLATOR_H__
+#define TAM_TRANSLATOR_H__
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+/// Translate a TAM program into a standalone C++ translation unit.
+///
+/// The generated code defines `main`, which executes the program and reports
+/// errors in the same way as `tam`. It must be linked against the `tam`
+/// library, which provides the primitives and heap management.
+///
+/// @param program code words of the program
+/// @param name name of the program, recorded in a comment
+/// @return the generated source code
+/// @throws std::runtime_error if the program is too large to fit in memory
+std::string TranslateProgram(const std::vector<uint32_t>& program,
+                             const std::string& name);
+
+#endif  // TAM_TRANSLATOR_H__
@@ -0,0 +1,94 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file fusion.cc
+/// This file defines the `FuseInstructions` method of `TamProgram`, which
+/// replaces common sequences of instructions with superinstructions.
+//
+//===-----------------------------------------------------------------------===//
+
+#include <string>
+#include <vector>
+
+#include "tam/program.h"
+#include "tam/tam.h"
+
+namespace tam {
+
+/// Get the name of the primitive called by an instruction.
+///
+/// @param decoded the instruction
+/// @return the name of the primitive, or `""` if it is not a primitive call
+static const std::string& PrimitiveName(const DecodedInstruction& decoded) {
+    static const std::string none;
+    if (decoded.handler <= kPrimitiveHandlerBase ||
+        decoded.handler >= kPrimitiveHandlerBase + 29)
+        return none;
+    return primitive_names[decoded.handler - kPrimitiveHandlerBase];
+}
+
+/// Check whether an instruction is `LOAD(1) d[r]` for a register `r` that
+/// cannot change between two consecutive loads.
+static bool IsFrameLoad(const DecodedInstruction& decoded) {
+    const TamInstruction& instr = decoded.instr;
+    return instr.op == LOAD && instr.n == 1 && (instr.r == SB || instr.r == LB);
+}
+
+/// Scans every address for the start of a sequence that has a superinstruction.
+/// Sequences may overlap, since each superinstruction reads the operands of
+/// the original instructions that follow it.
+void TamProgram::FuseInstructions() {
+    std::vector<DecodedInstruction>& code = this->decoded_;
+    const size_t size = code.size();
+
+    this->fusions_.clear();
+    for (size_t I = 0; I < size; ++I) {
+        const TamInstruction& instr = code[I].instr;
+        Superinstruction op;
+
+        if (instr.op == LOADL && I + 1 < size &&
+            PrimitiveName(code[I + 1]) == "add") {
+            op = kLoadlAdd;
+        } else if (instr.op == LOADA && I + 1 < size &&
+                   code[I + 1].instr.op == LOADI) {
+            op = kLoadaLoadi;
+        } else if (IsFrameLoad(code[I]) && I + 3 < size &&
+                   IsFrameLoad(code[I + 1]) &&
+                   code[I + 3].instr.op == JUMPIF) {
+            const std::string& name = PrimitiveName(code[I + 2]);
+            if (name == "lt") {
+                op = kLoadLoadLt;
+            } else if (name == "le") {
+                op = kLoadLoadLe;
+            } else if (name == "ge") {
+                op = kLoadLoadGe;
+            } else if (name == "gt") {
+                op = kLoadLoadGt;
+            } else {
+                continue;
+            }
+        } else {
+            continue;
+        }
+
+        code[I].handler = op;
+        this->fusions_.push_back(Fusion{static_cast<TamAddr>(I), op});
+    }
+}
+
+}  // namespace tam
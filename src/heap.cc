@@ -17,43 +17,37 @@
 //===-----------------------------------------------------------------------===//
 //
 /// @file heap.cc
-/// This file defines the `Allocate` and `Free` methods of `TamEmulator`.
+/// This file defines the `Allocate` and `Free` methods of `TamEmulator`, and
+/// the `BestFitAllocator` class.
 //
 //===-----------------------------------------------------------------------===//
 
 #include <assert.h>
 
 #include <map>
+#include <memory>
+#include <optional>
+#include <utility>
 
 #include "tam/error.h"
+#include "tam/heap.h"
 #include "tam/tam.h"
 
 namespace tam {
 
-/// Iterates through all existing free blocks in the heap to try and find one of
-/// the correct size. If none is found, the heap is expanded.
+/// Asks the heap allocator for a free block of the correct size. If it has
+/// none, the heap is expanded.
 TamAddr TamEmulator::Allocate(int n) {
     // if allocating zero bytes, just return 0. otherwise we will have duplicate block addresses
     if (n == 0)
         return 0;
+    if (this->stats_enabled_) ++this->stats_.allocations;
 
     // try to find unallocated space inside heap
-    for (auto block_iter = this->free_blocks_.begin(),
-              iter_end = this->free_blocks_.end();
-         block_iter != iter_end; ++block_iter) {
-        assert(block_iter->first > this->registers_[HT]);
-
-        if (block_iter->second < n)  // block not big enough
-            continue;
-
-        TamAddr block_start = block_iter->first;
-
-        this->allocated_blocks_.emplace(block_start, n);
-        if (block_iter->second > n)
-            this->free_blocks_.emplace(block_start + n, block_iter->second - n);
-        this->free_blocks_.erase(block_iter);
-
-        return block_start;
+    if (std::optional<TamAddr> block_start = this->heap_allocator_->Take(n)) {
+        assert(*block_start > this->registers_[HT]);
+        this->allocated_blocks_.emplace(*block_start, n);
+        return *block_start;
     }
 
     // expand heap
@@ -62,13 +56,14 @@ TamAddr TamEmulator::Allocate(int n) {
         throw RuntimeError(ExceptionKind::kHeapOverflow,
                            this->registers_[CP] - 1);
 
+    this->heap_low_ = std::min(this->heap_low_, this->registers_[HT]);
     this->allocated_blocks_.emplace(this->registers_[HT] + 1, n);
     return this->registers_[HT] + 1;
 }
 
 /// Attempts to locate an allocated block of the given address and size.
-/// If the block was at the end of the heap then the heap is contracted,
-/// otherwise the freed block is added to the list of available blocks.
+/// The freed block is merged with any neighbouring free blocks, and if the
+/// result lies at the end of the heap then the heap is contracted over it.
 void TamEmulator::Free(TamAddr addr, TamData size) {
     if (addr == 0) {
         // address 0 is for zero-sized allocations.
@@ -82,32 +77,109 @@ void TamEmulator::Free(TamAddr addr, TamData size) {
         throw RuntimeError(ExceptionKind::kDataAccessViolation,
                            this->registers_[CP] - 1);
 
-    if (!this->allocated_blocks_.count(addr))
+    auto block_iter = this->allocated_blocks_.find(addr);
+    if (block_iter == this->allocated_blocks_.end())
         throw RuntimeError(ExceptionKind::kDataAccessViolation,
                            this->registers_[CP] - 1);
+    assert(block_iter->first > this->registers_[HT]);
 
-    for (auto block_iter = this->allocated_blocks_.begin(),
-              iter_end = this->allocated_blocks_.end();
-         block_iter != iter_end; ++block_iter) {
-        assert(block_iter->first > this->registers_[HT]);
+    if (block_iter->second != size)  // block does not have specified size
+        throw RuntimeError(ExceptionKind::kDataAccessViolation,
+                           this->registers_[CP] - 1);
 
-        if (block_iter->first != addr)  // not the specified block
-            continue;
+    // mark block as available, then shrink heap over any free blocks on top
+    // of it
+    this->heap_allocator_->Release(block_iter->first, block_iter->second);
+    this->allocated_blocks_.erase(block_iter);
+    while (int size = this->heap_allocator_->TakeAt(this->registers_[HT] + 1))
+        this->registers_[HT] += size;
+}
 
-        if (block_iter->second != size)  // block does not have specified size
-            throw RuntimeError(ExceptionKind::kDataAccessViolation,
-                               this->registers_[CP] - 1);
+HeapStats TamEmulator::GetHeapStats() const {
+    HeapStats stats{};
+    stats.heap_words = this->registers_[HB] - this->registers_[HT];
+    stats.allocated_blocks = this->allocated_blocks_.size();
+    for (auto block : this->allocated_blocks_)
+        stats.allocated_words += block.second;
 
-        if (addr == this->registers_[HT] + 1) {
-            // block on top of heap, shrink heap
-            this->registers_[HT] += block_iter->second;
-        } else {
-            // mark block as available
-            this->free_blocks_.emplace(block_iter->first, block_iter->second);
+    this->heap_allocator_->CountFreeBlocks(stats);
+    return stats;
+}
+
+void TamEmulator::SetHeapAllocator(std::unique_ptr<HeapAllocator> allocator) {
+    assert(allocator);
+    this->heap_allocator_ = std::move(allocator);
+}
+
+std::optional<TamAddr> BestFitAllocator::Take(int n) {
+    auto best = this->by_size_.lower_bound({n, 0});
+    if (best == this->by_size_.end()) return std::nullopt;
+
+    auto [size, addr] = *best;
+    this->Erase(this->by_addr_.find(addr));
+    if (size > n) this->Insert(addr + n, size - n);
+    return addr;
+}
+
+void BestFitAllocator::Release(TamAddr addr, int n) {
+    if (addr + n < kMemSize) {
+        auto next = this->by_addr_.find(addr + n);
+        if (next != this->by_addr_.end()) {
+            n += next->second;
+            this->Erase(next);
         }
-        this->allocated_blocks_.erase(block_iter);
-        break;
     }
+
+    auto prev = this->by_addr_.lower_bound(addr);
+    if (prev != this->by_addr_.begin()) {
+        --prev;
+        if (prev->first + prev->second == addr) {
+            addr = prev->first;
+            n += prev->second;
+            this->Erase(prev);
+        }
+    }
+
+    this->Insert(addr, n);
+}
+
+int BestFitAllocator::TakeAt(TamAddr addr) {
+    auto block = this->by_addr_.find(addr);
+    if (block == this->by_addr_.end()) return 0;
+
+    int size = block->second;
+    this->Erase(block);
+    return size;
+}
+
+int BestFitAllocator::FreeBlockSize(TamAddr addr) const {
+    auto block = this->by_addr_.find(addr);
+    return block == this->by_addr_.end() ? 0 : block->second;
+}
+
+void BestFitAllocator::CountFreeBlocks(HeapStats& stats) const {
+    stats.free_blocks = this->by_addr_.size();
+    stats.free_words = this->free_words_;
+    stats.largest_free_block =
+        this->by_size_.empty() ? 0 : this->by_size_.rbegin()->first;
+}
+
+void BestFitAllocator::Clear() {
+    this->by_size_.clear();
+    this->by_addr_.clear();
+    this->free_words_ = 0;
+}
+
+void BestFitAllocator::Insert(TamAddr addr, int n) {
+    this->by_size_.emplace(n, addr);
+    this->by_addr_.emplace(addr, n);
+    this->free_words_ += n;
+}
+
+void BestFitAllocator::Erase(std::map<TamAddr, int>::iterator block) {
+    this->by_size_.erase({block->second, block->first});
+    this->free_words_ -= block->second;
+    this->by_addr_.erase(block);
 }
 
 }  // namespace tam
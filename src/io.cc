@@ -0,0 +1,114 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file io.cc
+/// This file implements the input sources and output sinks provided by the
+/// library.
+//
+//===-----------------------------------------------------------------------===//
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TAM_POSIX_IO 1
+#include <unistd.h>
+#else
+#define TAM_POSIX_IO 0
+#endif
+
+#include "tam/io.h"
+
+namespace tam {
+
+StdioInput::~StdioInput() {
+    if (this->owned_) fclose(this->file_);
+}
+
+int StdioInput::Peek() {
+    int c = getc(this->file_);
+    ungetc(c, this->file_);
+    return c;
+}
+
+// Characters already read are only discarded here, which never happens while a
+// primitive is reading, so `Unget` can always return to its first character.
+void ChannelInput::Feed(const char* data, size_t size) {
+    if (this->next_ > this->buffer_.size() / 2) {
+        this->buffer_.erase(0, this->next_);
+        this->next_ = 0;
+    }
+    this->buffer_.append(data, size);
+}
+
+long ChannelInput::FeedFrom(int fd) {
+#if TAM_POSIX_IO
+    char buffer[1 << 16];
+    ssize_t count = read(fd, buffer, sizeof buffer);
+    if (count > 0) this->Feed(buffer, count);
+    if (count == 0) this->Close();
+    return count;
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+StdioOutput::~StdioOutput() {
+    if (this->owned_) fclose(this->file_);
+}
+
+BufferedFileOutput::BufferedFileOutput(FILE* file, bool owned,
+                                       size_t buffer_size)
+    : file_(file),
+      owned_(owned),
+      buffer_(new char[std::max<size_t>(buffer_size, 1)]),
+      capacity_(std::max<size_t>(buffer_size, 1)) {}
+
+BufferedFileOutput::~BufferedFileOutput() {
+    this->Flush();
+    if (this->owned_) fclose(this->file_);
+}
+
+void BufferedFileOutput::Write(const char* data, size_t size) {
+    if (size > this->capacity_ - this->used_) {
+        this->Flush();
+        if (size >= this->capacity_) {
+            // too large to be worth copying into the buffer
+            if (fwrite(data, 1, size, this->file_) != size)
+                this->failed_ = true;
+            return;
+        }
+    }
+
+    memcpy(this->buffer_.get() + this->used_, data, size);
+    this->used_ += size;
+}
+
+void BufferedFileOutput::Flush() {
+    if (this->used_ &&
+        fwrite(this->buffer_.get(), 1, this->used_, this->file_) != this->used_)
+        this->failed_ = true;
+    this->used_ = 0;
+    if (fflush(this->file_)) this->failed_ = true;
+}
+
+}  // namespace tam
@@ -0,0 +1,1050 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file jit.cc
+/// This file defines the `JitCode` class, which translates TAM programs into
+/// x86-64 machine code, and the `EnableJit` and `RunJit` methods of
+/// `TamEmulator`.
+///
+/// Native code is only generated when built with `TAM_JIT` for x86-64 on a
+/// POSIX system. Elsewhere `JitCode::Supported` returns `false` and the
+/// emulator always interprets.
+//
+//===-----------------------------------------------------------------------===//
+
+#include "tam/jit.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <vector>
+
+#include "tam/error.h"
+#include "tam/program.h"
+#include "tam/tam.h"
+
+#if TAM_JIT && defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define TAM_JIT_X86_64 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define TAM_JIT_X86_64 0
+#endif
+
+namespace tam {
+
+#if TAM_JIT_X86_64
+
+namespace {
+
+enum X64Reg {
+    RAX = 0,
+    RCX = 1,
+    RDX = 2,
+    RBX = 3,
+    RSP = 4,
+    RBP = 5,
+    RSI = 6,
+    RDI = 7,
+    R8 = 8,
+    R9 = 9,
+    R10 = 10,
+    R11 = 11,
+    R12 = 12,
+    R13 = 13,
+    R14 = 14,
+    R15 = 15,
+};
+
+enum X64Cond {
+    kBelow = 0x2,
+    kAboveEqual = 0x3,
+    kEqual = 0x4,
+    kNotEqual = 0x5,
+    kBelowEqual = 0x6,
+    kAbove = 0x7,
+    kLess = 0xc,
+    kGreaterEqual = 0xd,
+    kLessEqual = 0xe,
+    kGreater = 0xf,
+};
+
+// Opcodes of the `op r/m32, r32` forms of the basic ALU instructions.
+enum X64Alu {
+    kAdd = 0x01,
+    kOr = 0x09,
+    kAnd = 0x21,
+    kSub = 0x29,
+    kCmp = 0x39,
+    kTest = 0x85,
+};
+
+// Opcode extensions of the `op r/m32, imm32` forms of the same instructions.
+enum X64AluImm {
+    kAddImm = 0,
+    kSubImm = 5,
+    kCmpImm = 7,
+};
+
+// Registers with a fixed role inside every block.
+constexpr const X64Reg kEmulator = RBX;  // TamEmulator*
+constexpr const X64Reg kRegisters = R13;  // TamAddr* registers
+constexpr const X64Reg kSt = R14;         // current value of ST
+constexpr const X64Reg kData = R15;       // TamData* data memory
+
+/// A minimal assembler for the subset of x86-64 needed by the translator.
+///
+/// All arithmetic is on 32-bit registers; TAM words are zero- or sign-extended
+/// when loaded and truncated when stored.
+class X64Emitter {
+   public:
+    std::vector<uint8_t> code;
+
+    size_t Here() const { return this->code.size(); }
+
+    void Byte(uint8_t b) { this->code.push_back(b); }
+
+    void Imm16(int16_t v) {
+        this->Byte(v & 0xff);
+        this->Byte((v >> 8) & 0xff);
+    }
+
+    void Imm32(int32_t v) {
+        for (int I = 0; I < 4; ++I) this->Byte((v >> (8 * I)) & 0xff);
+    }
+
+    void Imm64(uint64_t v) {
+        for (int I = 0; I < 8; ++I) this->Byte((v >> (8 * I)) & 0xff);
+    }
+
+    void Rex(bool w, int reg, int index, int base) {
+        uint8_t rex = 0x40 | (w << 3) | ((reg >> 3) << 2) |
+                      ((index >> 3) << 1) | (base >> 3);
+        if (rex != 0x40) this->Byte(rex);
+    }
+
+    void ModRR(int reg, int rm) {
+        this->Byte(0xc0 | ((reg & 7) << 3) | (rm & 7));
+    }
+
+    // [base + disp32], base must not be RSP or R12
+    void ModMem(int reg, int base, int32_t disp) {
+        assert((base & 7) != RSP);
+        this->Byte(0x80 | ((reg & 7) << 3) | (base & 7));
+        this->Imm32(disp);
+    }
+
+    // [base + index * 2], base must not be RBP or R13
+    void ModIndex(int reg, int base, int index) {
+        assert((base & 7) != RBP && index != RSP);
+        this->Byte(0x04 | ((reg & 7) << 3));
+        this->Byte(0x40 | ((index & 7) << 3) | (base & 7));
+    }
+
+    // movzx dst, word [kRegisters + 2 * r]
+    void LoadRegister(X64Reg dst, TamRegister r) {
+        this->Rex(false, dst, 0, kRegisters);
+        this->Byte(0x0f);
+        this->Byte(0xb7);
+        this->ModMem(dst, kRegisters, 2 * r);
+    }
+
+    // mov word [kRegisters + 2 * r], src
+    void StoreRegister(TamRegister r, X64Reg src) {
+        this->Byte(0x66);
+        this->Rex(false, src, 0, kRegisters);
+        this->Byte(0x89);
+        this->ModMem(src, kRegisters, 2 * r);
+    }
+
+    // movsx dst, word [kData + 2 * index]
+    void LoadWord(X64Reg dst, X64Reg index) {
+        this->Rex(false, dst, index, kData);
+        this->Byte(0x0f);
+        this->Byte(0xbf);
+        this->ModIndex(dst, kData, index);
+    }
+
+    // mov word [kData + 2 * index], src
+    void StoreWord(X64Reg index, X64Reg src) {
+        this->Byte(0x66);
+        this->Rex(false, src, index, kData);
+        this->Byte(0x89);
+        this->ModIndex(src, kData, index);
+    }
+
+    // mov word [kData + 2 * index], imm16
+    void StoreWordImm(X64Reg index, int16_t imm) {
+        this->Byte(0x66);
+        this->Rex(false, 0, index, kData);
+        this->Byte(0xc7);
+        this->ModIndex(0, kData, index);
+        this->Imm16(imm);
+    }
+
+    void MovImm(X64Reg dst, int32_t imm) {
+        this->Rex(false, 0, 0, dst);
+        this->Byte(0xb8 + (dst & 7));
+        this->Imm32(imm);
+    }
+
+    void MovImm64(X64Reg dst, uint64_t imm) {
+        this->Rex(true, 0, 0, dst);
+        this->Byte(0xb8 + (dst & 7));
+        this->Imm64(imm);
+    }
+
+    void Mov(X64Reg dst, X64Reg src) { this->Alu(0x89, dst, src); }
+
+    void Mov64(X64Reg dst, X64Reg src) {
+        this->Rex(true, src, 0, dst);
+        this->Byte(0x89);
+        this->ModRR(src, dst);
+    }
+
+    void Or64(X64Reg dst, X64Reg src) {
+        this->Rex(true, src, 0, dst);
+        this->Byte(kOr);
+        this->ModRR(src, dst);
+    }
+
+    // lea dst, [base + disp32]
+    void Lea(X64Reg dst, X64Reg base, int32_t disp) {
+        this->Rex(false, dst, 0, base);
+        this->Byte(0x8d);
+        this->ModMem(dst, base, disp);
+    }
+
+    void Alu(uint8_t opcode, X64Reg dst, X64Reg src) {
+        this->Rex(false, src, 0, dst);
+        this->Byte(opcode);
+        this->ModRR(src, dst);
+    }
+
+    void AluImm(X64AluImm ext, X64Reg dst, int32_t imm) {
+        this->Rex(false, 0, 0, dst);
+        this->Byte(0x81);
+        this->ModRR(ext, dst);
+        this->Imm32(imm);
+    }
+
+    // movzx dst, src16
+    void ZeroExtend16(X64Reg dst, X64Reg src) {
+        this->Rex(false, dst, 0, src);
+        this->Byte(0x0f);
+        this->Byte(0xb7);
+        this->ModRR(dst, src);
+    }
+
+    // setcc dst8; movzx dst, dst8 (dst must be one of RAX-RBX)
+    void SetCond(X64Cond cond, X64Reg dst) {
+        assert(dst <= RBX);
+        this->Byte(0x0f);
+        this->Byte(0x90 | cond);
+        this->ModRR(0, dst);
+        this->Byte(0x0f);
+        this->Byte(0xb6);
+        this->ModRR(dst, dst);
+    }
+
+    void CondMove(X64Cond cond, X64Reg dst, X64Reg src) {
+        this->Rex(false, dst, 0, src);
+        this->Byte(0x0f);
+        this->Byte(0x40 | cond);
+        this->ModRR(dst, src);
+    }
+
+    void Imul(X64Reg dst, X64Reg src) {
+        this->Rex(false, dst, 0, src);
+        this->Byte(0x0f);
+        this->Byte(0xaf);
+        this->ModRR(dst, src);
+    }
+
+    // cdq; idiv src
+    void SignedDivide(X64Reg src) {
+        this->Byte(0x99);
+        this->Rex(false, 0, 0, src);
+        this->Byte(0xf7);
+        this->ModRR(7, src);
+    }
+
+    void Neg(X64Reg dst) {
+        this->Rex(false, 0, 0, dst);
+        this->Byte(0xf7);
+        this->ModRR(3, dst);
+    }
+
+    void Push(X64Reg r) {
+        this->Rex(false, 0, 0, r);
+        this->Byte(0x50 + (r & 7));
+    }
+
+    void Pop(X64Reg r) {
+        this->Rex(false, 0, 0, r);
+        this->Byte(0x58 + (r & 7));
+    }
+
+    void Call(const void* target) {
+        this->MovImm64(RAX, reinterpret_cast<uint64_t>(target));
+        this->Byte(0xff);
+        this->Byte(0xd0);
+    }
+
+    void Ret() { this->Byte(0xc3); }
+
+    /// Emit a conditional jump with an unresolved target.
+    ///
+    /// @return position to pass to `Bind`
+    size_t JumpIf(X64Cond cond) {
+        this->Byte(0x0f);
+        this->Byte(0x80 | cond);
+        this->Imm32(0);
+        return this->Here() - 4;
+    }
+
+    /// Emit an unconditional jump with an unresolved target.
+    ///
+    /// @return position to pass to `Bind`
+    size_t Jump() {
+        this->Byte(0xe9);
+        this->Imm32(0);
+        return this->Here() - 4;
+    }
+
+    /// Resolve the target of a jump.
+    ///
+    void Bind(size_t jump, size_t target) {
+        int32_t rel = static_cast<int32_t>(target - (jump + 4));
+        memcpy(&this->code[jump], &rel, sizeof(rel));
+    }
+};
+
+/// Translates the instructions of one basic block.
+///
+class BlockTranslator {
+   public:
+    BlockTranslator(X64Emitter& emitter, void* call_primitive)
+        : as_(emitter), call_primitive_(call_primitive) {}
+
+    /// Check whether an instruction can be translated.
+    ///
+    static bool CanTranslate(const DecodedInstruction& decoded) {
+        const TamInstruction& instr = decoded.instr;
+        switch (instr.op) {
+            case LOAD:
+            case STORE:
+            case POP:
+            case RETURN:
+                return instr.n <= 4;
+            case CALL:
+                return decoded.handler != CALL ||
+                       (instr.r != ST && instr.r != LB);
+            case LOADA:
+            case LOADL:
+            case PUSH:
+            case JUMP:
+            case JUMPIF:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /// Check whether an instruction always ends a basic block.
+    ///
+    static bool EndsBlock(const DecodedInstruction& decoded) {
+        switch (decoded.instr.op) {
+            case CALL:
+                return decoded.handler == CALL;
+            case RETURN:
+            case JUMP:
+            case JUMPI:
+            case JUMPIF:
+            case CALLI:
+            case HALT:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /// Get an upper bound on the number of words above `ST` that a
+    /// translatable instruction writes.
+    static int WordsPushed(const DecodedInstruction& decoded) {
+        const TamInstruction& instr = decoded.instr;
+        switch (instr.op) {
+            case LOAD:
+            case POP:
+            case RETURN:
+                return instr.n;
+            case LOADA:
+            case LOADL:
+                return 1;
+            case CALL:
+                return 3;
+            case PUSH:
+                return std::max<int>(instr.d, 0);
+            default:
+                return 0;
+        }
+    }
+
+    /// Translate the instructions `code[start..end)`, which must all be
+    /// translatable.
+    void Translate(const DecodedInstruction* code, TamAddr start,
+                   TamAddr end) {
+        this->Prologue();
+        bool ended = false;
+        for (TamAddr addr = start; addr < end; ++addr) {
+            this->addr_ = addr;
+            this->index_ = addr - start;
+            ended = this->Instruction(code[addr]);
+        }
+        if (!ended) this->Exit(end, end - start);
+
+        this->Epilogue();
+    }
+
+   private:
+    /// Jump to the epilogue with `rax` set to `next | executed << 16`.
+    ///
+    void Exit(TamAddr next, uint32_t executed) {
+        this->as_.MovImm64(RAX, uint64_t(next) | (uint64_t(executed) << 16));
+        this->exits_.push_back(this->as_.Jump());
+    }
+
+    /// Jump to the epilogue with `rax` set to `target | executed << 16`,
+    /// where `target` is a 16-bit value already in a register.
+    void ExitTo(X64Reg target, uint32_t executed) {
+        this->as_.MovImm64(RCX, uint64_t(executed) << 16);
+        if (target != RAX) this->as_.Mov(RAX, target);
+        this->as_.Or64(RAX, RCX);
+        this->exits_.push_back(this->as_.Jump());
+    }
+
+    /// Leave the block without executing the current instruction if `cond`
+    /// holds, so that the interpreter can execute it instead.
+    void BailIf(X64Cond cond) {
+        this->bails_.emplace_back(this->as_.JumpIf(cond),
+                                  uint64_t(this->addr_) |
+                                      (uint64_t(this->index_) << 16));
+    }
+
+    void Prologue() {
+        this->exits_.clear();
+        this->bails_.clear();
+        this->as_.Push(RBP);
+        this->as_.Push(RBX);
+        this->as_.Push(R13);
+        this->as_.Push(R14);
+        this->as_.Push(R15);
+        this->as_.Mov64(kEmulator, RDI);
+        this->as_.Mov64(kData, RSI);
+        this->as_.Mov64(kRegisters, RDX);
+        this->as_.LoadRegister(kSt, ST);
+    }
+
+    void Epilogue() {
+        for (auto& bail : this->bails_) {
+            this->as_.Bind(bail.first, this->as_.Here());
+            this->as_.MovImm64(RAX, bail.second);
+            this->exits_.push_back(this->as_.Jump());
+        }
+
+        size_t epilogue = this->as_.Here();
+        for (size_t jump : this->exits_) this->as_.Bind(jump, epilogue);
+        this->as_.StoreRegister(ST, kSt);
+        this->as_.Pop(R15);
+        this->as_.Pop(R14);
+        this->as_.Pop(R13);
+        this->as_.Pop(RBX);
+        this->as_.Pop(RBP);
+        this->as_.Ret();
+    }
+
+    /// Load the value the interpreter would see for register `r`.
+    ///
+    void RegisterValue(X64Reg dst, uint8_t r) {
+        if (r == CP) {
+            this->as_.MovImm(dst, this->addr_ + 1);
+        } else if (r == ST) {
+            this->as_.Mov(dst, kSt);
+        } else {
+            this->as_.LoadRegister(dst, static_cast<TamRegister>(r));
+        }
+    }
+
+    /// Bail unless `value < HT`, i.e. unless a word can be pushed at `value`.
+    ///
+    void CheckPush(X64Reg value) {
+        this->as_.LoadRegister(RDX, HT);
+        this->as_.Alu(kCmp, value, RDX);
+        this->BailIf(kAboveEqual);
+    }
+
+    /// Bail if `addr` lies in the gap between `low` and `HT` (in `RDX`).
+    ///
+    void CheckData(X64Reg addr, X64Reg low) {
+        this->as_.Alu(kCmp, addr, low);
+        size_t ok = this->as_.JumpIf(kBelow);
+        this->as_.Alu(kCmp, addr, RDX);
+        this->BailIf(kBelowEqual);
+        this->as_.Bind(ok, this->as_.Here());
+    }
+
+    /// Bail unless at least `n` words are on the stack.
+    ///
+    void CheckPop(int n) {
+        if (n <= 0) return;
+        this->as_.AluImm(kCmpImm, kSt, n);
+        this->BailIf(kBelow);
+    }
+
+    /// Emit code for a single instruction.
+    ///
+    /// @return `true` if the instruction ended the block
+    bool Instruction(const DecodedInstruction& decoded) {
+        const TamInstruction& instr = decoded.instr;
+        switch (instr.op) {
+            case LOAD:
+                this->Load(instr);
+                return false;
+            case LOADA:
+                this->as_.Mov(RSI, kSt);
+                this->CheckPush(RSI);
+                this->RegisterValue(RAX, instr.r);
+                this->as_.AluImm(kAddImm, RAX, instr.d);
+                this->as_.StoreWord(kSt, RAX);
+                this->as_.AluImm(kAddImm, kSt, 1);
+                return false;
+            case LOADL:
+                this->as_.Mov(RSI, kSt);
+                this->CheckPush(RSI);
+                this->as_.StoreWordImm(kSt, instr.d);
+                this->as_.AluImm(kAddImm, kSt, 1);
+                return false;
+            case STORE:
+                this->Store(instr);
+                return false;
+            case CALL:
+                if (decoded.handler != CALL) {
+                    this->Primitive(instr.d);
+                    return false;
+                }
+                this->Call(instr);
+                return true;
+            case RETURN:
+                this->Return(instr);
+                return true;
+            case PUSH:
+                // the interpreter reports this error at `CT - 1`, so it is
+                // left to the interpreter
+                this->as_.LoadRegister(RDX, HT);
+                this->as_.Lea(RAX, kSt, instr.d);
+                this->as_.Alu(kCmp, RAX, RDX);
+                this->BailIf(kGreaterEqual);
+                this->as_.ZeroExtend16(kSt, RAX);
+                return false;
+            case POP:
+                this->Pop(instr);
+                return false;
+            case JUMP:
+                this->RegisterValue(RAX, instr.r);
+                this->as_.AluImm(kAddImm, RAX, instr.d);
+                this->as_.ZeroExtend16(RAX, RAX);
+                this->as_.LoadRegister(RDX, CT);
+                this->as_.Alu(kCmp, RAX, RDX);
+                this->BailIf(kAboveEqual);
+                this->ExitTo(RAX, this->index_ + 1);
+                return true;
+            case JUMPIF:
+                this->Jumpif(instr);
+                return true;
+            default:
+                assert(false && "instruction cannot be translated");
+                return true;
+        }
+    }
+
+    void Load(const TamInstruction& instr) {
+        if (instr.n == 0) return;
+
+        // check every word before pushing any of them
+        this->as_.LoadRegister(RDX, HT);
+        this->RegisterValue(RAX, instr.r);
+        this->as_.AluImm(kAddImm, RAX, instr.d);
+        for (int I = 0; I < instr.n; ++I) {
+            this->as_.Lea(RCX, RAX, I);
+            this->as_.ZeroExtend16(RCX, RCX);
+            this->as_.Lea(RSI, kSt, I);
+            this->CheckData(RCX, RSI);
+            this->as_.Alu(kCmp, RSI, RDX);
+            this->BailIf(kAboveEqual);
+        }
+
+        for (int I = 0; I < instr.n; ++I) {
+            this->as_.Lea(RCX, RAX, I);
+            this->as_.ZeroExtend16(RCX, RCX);
+            this->as_.LoadWord(RDI, RCX);
+            this->as_.Lea(RSI, kSt, I);
+            this->as_.StoreWord(RSI, RDI);
+        }
+        this->as_.AluImm(kAddImm, kSt, instr.n);
+    }
+
+    void Store(const TamInstruction& instr) {
+        this->CheckPop(instr.n);
+        this->as_.Lea(RSI, kSt, -instr.n);
+        this->as_.LoadRegister(RDX, HT);
+        if (instr.r == ST) {
+            this->as_.Mov(RAX, RSI);
+        } else {
+            this->RegisterValue(RAX, instr.r);
+        }
+        this->as_.AluImm(kAddImm, RAX, instr.d);
+        for (int I = 0; I < instr.n; ++I) {
+            this->as_.Lea(RCX, RAX, I);
+            this->as_.ZeroExtend16(RCX, RCX);
+            this->CheckData(RCX, RSI);
+        }
+
+        for (int I = 0; I < instr.n; ++I) {
+            this->as_.Lea(RCX, RSI, I);
+            this->as_.LoadWord(RDI, RCX);
+            this->as_.Lea(RCX, RAX, I);
+            this->as_.ZeroExtend16(RCX, RCX);
+            this->as_.StoreWord(RCX, RDI);
+        }
+        this->as_.Mov(kSt, RSI);
+    }
+
+    void Pop(const TamInstruction& instr) {
+        this->CheckPop(instr.n);
+        this->as_.Lea(RSI, kSt, -instr.n);
+        this->as_.Mov(RDI, RSI);
+        if (instr.d > 0) {
+            this->as_.AluImm(kCmpImm, RDI, instr.d);
+            this->BailIf(kBelow);
+            this->as_.AluImm(kSubImm, RDI, instr.d);
+        }
+        if (instr.n > 0) {
+            this->as_.Lea(RAX, RDI, instr.n - 1);
+            this->CheckPush(RAX);
+        }
+
+        for (int I = 0; I < instr.n; ++I) {
+            this->as_.Lea(RCX, RSI, I);
+            this->as_.LoadWord(R8, RCX);
+            this->as_.Lea(RCX, RDI, I);
+            this->as_.StoreWord(RCX, R8);
+        }
+        this->as_.Lea(kSt, RDI, instr.n);
+    }
+
+    void Call(const TamInstruction& instr) {
+        this->RegisterValue(RAX, instr.r);
+        this->as_.AluImm(kAddImm, RAX, instr.d);
+        this->as_.LoadRegister(RDX, CT);
+        this->as_.Alu(kCmp, RAX, RDX);
+        this->BailIf(kGreaterEqual);
+        this->as_.Lea(RCX, kSt, 2);
+        this->CheckPush(RCX);
+
+        this->RegisterValue(RCX, instr.n);
+        this->as_.StoreWord(kSt, RCX);
+        this->as_.LoadRegister(RCX, LB);
+        this->as_.Lea(RSI, kSt, 1);
+        this->as_.StoreWord(RSI, RCX);
+        this->as_.MovImm(RCX, this->addr_ + 1);
+        this->as_.Lea(RSI, kSt, 2);
+        this->as_.StoreWord(RSI, RCX);
+
+        this->as_.StoreRegister(LB, kSt);
+        this->as_.AluImm(kAddImm, kSt, 3);
+        this->as_.ZeroExtend16(RAX, RAX);
+        this->ExitTo(RAX, this->index_ + 1);
+    }
+
+    void Return(const TamInstruction& instr) {
+        // RSI: results, RAX: LB, RDI: return address, R8: new ST
+        this->CheckPop(instr.n);
+        this->as_.Lea(RSI, kSt, -instr.n);
+        this->as_.LoadRegister(RAX, LB);
+        this->as_.Lea(RCX, RAX, 2);
+        this->as_.ZeroExtend16(RCX, RCX);
+        this->as_.LoadWord(RDI, RCX);
+        this->as_.ZeroExtend16(RDI, RDI);
+        this->as_.LoadRegister(RDX, CT);
+        this->as_.Alu(kCmp, RDI, RDX);
+        this->BailIf(kAboveEqual);
+
+        this->as_.Mov(R8, RSI);
+        this->as_.Alu(kCmp, R8, RAX);
+        this->as_.CondMove(kAbove, R8, RAX);
+        if (instr.d > 0) {
+            this->as_.AluImm(kCmpImm, R8, instr.d);
+            this->BailIf(kBelow);
+            this->as_.AluImm(kSubImm, R8, instr.d);
+        }
+        if (instr.n > 0) {
+            this->as_.Lea(R9, R8, instr.n - 1);
+            this->CheckPush(R9);
+        }
+
+        // read the dynamic link before the results can overwrite it
+        this->as_.Lea(RCX, RAX, 1);
+        this->as_.ZeroExtend16(RCX, RCX);
+        this->as_.LoadWord(R10, RCX);
+        for (int I = 0; I < instr.n; ++I) {
+            this->as_.Lea(RCX, RSI, I);
+            this->as_.LoadWord(R9, RCX);
+            this->as_.Lea(RCX, R8, I);
+            this->as_.StoreWord(RCX, R9);
+        }
+        this->as_.StoreRegister(LB, R10);
+        this->as_.Lea(kSt, R8, instr.n);
+        this->ExitTo(RDI, this->index_ + 1);
+    }
+
+    void Jumpif(const TamInstruction& instr) {
+        this->CheckPop(1);
+        this->as_.Lea(RSI, kSt, -1);
+        this->as_.LoadWord(RAX, RSI);
+        this->as_.AluImm(kCmpImm, RAX, instr.n);
+        size_t not_taken = this->as_.JumpIf(kNotEqual);
+
+        if (instr.r == ST) {
+            this->as_.Mov(RAX, RSI);
+        } else {
+            this->RegisterValue(RAX, instr.r);
+        }
+        this->as_.AluImm(kAddImm, RAX, instr.d);
+        this->as_.ZeroExtend16(RAX, RAX);
+        this->as_.LoadRegister(RDX, CT);
+        this->as_.Alu(kCmp, RAX, RDX);
+        this->BailIf(kAboveEqual);
+        this->as_.Mov(kSt, RSI);
+        this->ExitTo(RAX, this->index_ + 1);
+
+        this->as_.Bind(not_taken, this->as_.Here());
+        this->as_.Mov(kSt, RSI);
+        this->Exit(this->addr_ + 1, this->index_ + 1);
+    }
+
+    void Primitive(int16_t d) {
+        switch (d) {
+            case 1:  // id
+                return;
+            case 2:  // not
+                this->Unary();
+                this->as_.Alu(kTest, RAX, RAX);
+                this->as_.SetCond(kEqual, RAX);
+                break;
+            case 5:  // succ
+                this->Unary();
+                this->as_.AluImm(kAddImm, RAX, 1);
+                break;
+            case 6:  // pred
+                this->Unary();
+                this->as_.AluImm(kSubImm, RAX, 1);
+                break;
+            case 7:  // neg
+                this->Unary();
+                this->as_.Neg(RAX);
+                break;
+            case 3:  // and
+                this->Binary();
+                this->as_.Alu(kTest, RAX, RAX);
+                this->as_.SetCond(kNotEqual, RAX);
+                this->as_.Alu(kTest, RDI, RDI);
+                this->as_.SetCond(kNotEqual, RDX);
+                this->as_.Alu(kAnd, RAX, RDX);
+                break;
+            case 4:  // or
+                this->Binary();
+                this->as_.Alu(kOr, RAX, RDI);
+                this->as_.SetCond(kNotEqual, RAX);
+                break;
+            case 8:  // add
+                this->Binary();
+                this->as_.Alu(kAdd, RAX, RDI);
+                break;
+            case 9:  // sub
+                this->Binary();
+                this->as_.Alu(kSub, RAX, RDI);
+                break;
+            case 10:  // mult
+                this->Binary();
+                this->as_.Imul(RAX, RDI);
+                break;
+            case 11:  // div
+            case 12:  // mod
+                this->Binary();
+                this->as_.Alu(kTest, RDI, RDI);
+                this->BailIf(kEqual);
+                this->as_.SignedDivide(RDI);
+                if (d == 12) this->as_.Mov(RAX, RDX);
+                break;
+            case 13:  // lt
+            case 14:  // le
+            case 15:  // ge
+            case 16:  // gt
+                this->Binary();
+                this->as_.Alu(kCmp, RAX, RDI);
+                this->as_.SetCond(d == 13   ? kLess
+                                  : d == 14 ? kLessEqual
+                                  : d == 15 ? kGreaterEqual
+                                            : kGreater,
+                                  RAX);
+                break;
+            default:
+                this->CallPrimitive(d);
+                return;
+        }
+
+        // the result is in RAX and its address in RCX; for binary operations
+        // the new stack top is in RSI
+        this->as_.StoreWord(RCX, RAX);
+        if (d >= 3 && d != 5 && d != 6 && d != 7) this->as_.Mov(kSt, RSI);
+    }
+
+    /// Load the operand of a unary primitive into RAX and its address into
+    /// RCX, bailing if it cannot be popped and its result pushed.
+    void Unary() {
+        this->CheckPop(1);
+        this->as_.Lea(RCX, kSt, -1);
+        this->CheckPush(RCX);
+        this->as_.LoadWord(RAX, RCX);
+    }
+
+    /// Load the operands of a binary primitive into RAX and RDI, the address
+    /// of the first into RCX and of the second into RSI, bailing if they
+    /// cannot be popped and the result pushed.
+    void Binary() {
+        this->CheckPop(2);
+        this->as_.Lea(RCX, kSt, -2);
+        this->CheckPush(RCX);
+        this->as_.LoadWord(RAX, RCX);
+        this->as_.Lea(RSI, kSt, -1);
+        this->as_.LoadWord(RDI, RSI);
+    }
+
+    /// Call back into the emulator to execute primitive `d`.
+    ///
+    void CallPrimitive(int16_t d) {
+        this->as_.StoreRegister(ST, kSt);
+        this->as_.MovImm(RAX, this->addr_ + 1);
+        this->as_.StoreRegister(CP, RAX);
+        this->as_.Mov64(RDI, kEmulator);
+        this->as_.MovImm(RSI, d);
+        this->as_.Call(this->call_primitive_);
+        this->as_.LoadRegister(kSt, ST);
+
+        this->as_.Alu(kTest, RAX, RAX);
+        size_t ok = this->as_.JumpIf(kEqual);
+        this->as_.MovImm64(RAX, uint64_t(this->addr_ + 1) |
+                                    (uint64_t(this->index_ + 1) << 16) |
+                                    JitCode::kExceptionFlag);
+        this->exits_.push_back(this->as_.Jump());
+        this->as_.Bind(ok, this->as_.Here());
+    }
+
+    X64Emitter& as_;
+    void* call_primitive_;
+
+    TamAddr addr_ = 0;     // address of the current instruction
+    uint32_t index_ = 0;   // index of the current instruction in the block
+    std::vector<std::pair<size_t, uint64_t>> bails_;
+    std::vector<size_t> exits_;
+};
+
+}  // namespace
+
+bool JitCode::Supported() { return true; }
+
+/// Blocks begin at the start of the program, at the target of every jump,
+/// call or `LOADA` relative to `CB`, after every instruction that ends a block
+/// and around every instruction that cannot be translated. Each block runs
+/// until the next block begins, so blocks never overlap.
+std::unique_ptr<JitCode> JitCode::Compile(
+    const std::vector<DecodedInstruction>& program) {
+    const size_t size = program.size();
+    std::vector<bool> leader(size + 1, false);
+    leader[0] = true;
+    leader[size] = true;
+    for (size_t I = 0; I < size; ++I) {
+        const DecodedInstruction& decoded = program[I];
+        const TamInstruction& instr = decoded.instr;
+        if (BlockTranslator::EndsBlock(decoded) ||
+            !BlockTranslator::CanTranslate(decoded)) {
+            leader[I + 1] = true;
+        }
+        if (!BlockTranslator::CanTranslate(decoded)) leader[I] = true;
+
+        bool static_target =
+            (instr.op == JUMP || instr.op == JUMPIF || instr.op == LOADA ||
+             (instr.op == CALL && decoded.handler == CALL)) &&
+            instr.r == CB;
+        if (static_target && instr.d >= 0 && size_t(instr.d) < size)
+            leader[instr.d] = true;
+    }
+
+    std::unique_ptr<JitCode> jit(new JitCode());
+    jit->offsets_.assign(size, -1);
+    jit->lengths_.assign(size, 0);
+    jit->pushes_.assign(size, 0);
+
+    X64Emitter emitter;
+    BlockTranslator translator(
+        emitter, reinterpret_cast<void*>(&JitCode::CallPrimitive));
+    for (size_t start = 0; start < size; ++start) {
+        if (!leader[start] || !BlockTranslator::CanTranslate(program[start]))
+            continue;
+
+        size_t end = start + 1;
+        while (!leader[end]) ++end;
+
+        jit->offsets_[start] = emitter.Here();
+        jit->lengths_[start] = end - start;
+        for (size_t I = start; I < end; ++I)
+            jit->pushes_[start] += BlockTranslator::WordsPushed(program[I]);
+        translator.Translate(program.data(), start, end);
+    }
+
+    // copy the code into memory that is never writable and executable at once
+    long page = sysconf(_SC_PAGESIZE);
+    jit->size_ = (emitter.code.size() + page - 1) / page * page;
+    if (jit->size_ == 0) jit->size_ = page;
+    void* memory = mmap(nullptr, jit->size_, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return nullptr;
+    jit->memory_ = memory;
+
+    memcpy(memory, emitter.code.data(), emitter.code.size());
+    if (mprotect(memory, jit->size_, PROT_READ | PROT_EXEC) != 0)
+        return nullptr;
+
+    return jit;
+}
+
+JitCode::~JitCode() {
+    if (this->memory_) munmap(this->memory_, this->size_);
+}
+
+#else  // !TAM_JIT_X86_64
+
+bool JitCode::Supported() { return false; }
+
+std::unique_ptr<JitCode> JitCode::Compile(
+    const std::vector<DecodedInstruction>& /*program*/) {
+    return nullptr;
+}
+
+JitCode::~JitCode() {}
+
+#endif  // TAM_JIT_X86_64
+
+int JitCode::CallPrimitive(TamEmulator* emulator, int d) {
+    try {
+        TamInstruction instr{CALL, PB, 0, static_cast<int16_t>(d)};
+        emulator->ExecuteCallPrimitive(instr);
+        return 0;
+    } catch (...) {
+        emulator->jit_pending_ = std::current_exception();
+        return 1;
+    }
+}
+
+bool TamEmulator::EnableJit() {
+    this->jit_enabled_ = JitCode::Supported();
+    return this->jit_enabled_;
+}
+
+/// The program is translated the first time any emulator running it calls this
+/// method. Each time `CP` is at the start of a
+/// block that fits in the remaining budget the block is run natively;
+/// otherwise a single instruction is interpreted. A block that stops early
+/// has found an instruction that will fail, so that instruction is always
+/// interpreted next in order to raise the error.
+RunResult TamEmulator::RunJit(uint64_t max_steps) {
+    const JitCode* jit = this->program_->GetJitCode();
+    if (!jit) return this->Interpret<false>(max_steps);
+
+    const TamAddr ct = this->registers_[CT];
+    uint64_t steps = 0;
+    try {
+        while (steps < max_steps) {
+            TamAddr cp = this->registers_[CP];
+            JitCode::Block block = cp < ct ? jit->BlockAt(cp) : nullptr;
+            if (block && jit->BlockLength(cp) <= max_steps - steps) {
+                // native code does not record how far up the stack it writes
+                this->stack_used_ = std::max<int>(
+                    this->stack_used_,
+                    std::min<int>(kMemSize, this->registers_[ST] +
+                                                jit->BlockPushes(cp)));
+                uint64_t result = block(this, this->data_store_.data(),
+                                        this->registers_.data());
+                uint32_t executed = (result >> 16) & 0xffffffff;
+                this->registers_[CP] = result & 0xffff;
+                steps += executed;
+
+                if (result & JitCode::kExceptionFlag) {
+                    std::exception_ptr pending = this->jit_pending_;
+                    this->jit_pending_ = nullptr;
+                    std::rethrow_exception(pending);
+                }
+                if (executed == jit->BlockLength(cp)) {
+#if TAM_FLIGHT_RECORDER
+                    // blocks end at transfers of control or before the start
+                    // of other blocks
+                    if (this->registers_[CP] != cp + executed)
+                        this->RecordTransfer(cp + executed - 1,
+                                             this->registers_[CP],
+                                             this->registers_[ST],
+                                             this->registers_[LB],
+                                             this->registers_[HT]);
+#endif
+                    continue;
+                }
+            }
+
+            RunResult result = this->Interpret<false>(1);
+            steps += result.steps;
+            if (result.reason != StopReason::kBudgetExhausted) {
+                result.steps = steps;
+                return result;
+            }
+        }
+    } catch (const InputBlocked&) {
+        // thrown by a primitive called from a block, which counted the `CALL`
+        // as executed and set `CP` past it
+        --this->registers_[CP];
+        return RunResult{StopReason::kInputBlocked, steps - 1, ""};
+    } catch (const std::exception& e) {
+        return RunResult{StopReason::kError, steps, e.what()};
+    }
+
+    return RunResult{StopReason::kBudgetExhausted, steps, ""};
+}
+
+}  // namespace tam
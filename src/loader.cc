@@ -0,0 +1,195 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file loader.cc
+/// This file defines the functions for reading TAM binaries, and the methods
+/// of `TamProgram` and `TamEmulator` that load them.
+//
+//===-----------------------------------------------------------------------===//
+
+#include "tam/loader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TAM_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define TAM_MMAP 0
+#endif
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+#include "tam/error.h"
+#include "tam/program.h"
+#include "tam/tam.h"
+
+namespace tam {
+
+namespace {
+
+/// The contents of a file, mapped into memory where the platform supports it
+/// and read into a buffer otherwise.
+class FileContents {
+   public:
+    /// @param filename name of the file to read
+    /// @throws std::runtime_error if the file could not be read
+    explicit FileContents(const std::string& filename);
+    ~FileContents();
+
+    FileContents(const FileContents&) = delete;
+    FileContents& operator=(const FileContents&) = delete;
+
+    const uint8_t* data() const { return this->data_; }
+    size_t size() const { return this->size_; }
+
+   private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    std::vector<uint8_t> buffer_;
+};
+
+FileContents::FileContents(const std::string& filename) {
+#if TAM_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+            size_t size = info.st_size;
+            void* memory =
+                size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)
+                     : nullptr;
+            if (memory != MAP_FAILED) {
+                close(fd);
+                this->data_ = static_cast<const uint8_t*>(memory);
+                this->size_ = size;
+                this->mapped_ = memory != nullptr;
+                return;
+            }
+        }
+        close(fd);
+    }
+#endif
+
+    // fall back to reading the whole file
+    std::ifstream in_stream(filename, std::ios::binary);
+    if (!in_stream) {
+        std::string message = "could not read program file '" + filename + "'";
+        throw IoError(message.c_str());
+    }
+    this->buffer_.assign(std::istreambuf_iterator<char>(in_stream),
+                         std::istreambuf_iterator<char>());
+    this->data_ = this->buffer_.data();
+    this->size_ = this->buffer_.size();
+}
+
+FileContents::~FileContents() {
+#if TAM_MMAP
+    if (this->mapped_)
+        munmap(const_cast<uint8_t*>(this->data_), this->size_);
+#endif
+}
+
+/// Check that a TAM binary holds a whole number of words that fit in code
+/// memory.
+///
+/// @param size number of bytes in the binary
+/// @return the number of words
+size_t CheckProgramSize(size_t size) {
+    if (size % 4 != 0)
+        throw IoError("program file contained incomplete instruction");
+    if (size / 4 > kMemSize) throw IoError("program file too large");
+    return size / 4;
+}
+
+}  // namespace
+
+void DecodeProgramBytes(const uint8_t* bytes, size_t count, TamCode* words) {
+    size_t I = 0;
+#if defined(__AVX2__)
+    const __m256i swap256 = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,  //
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    for (; I + 8 <= count; I += 8) {
+        __m256i v =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + 4 * I));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(words + I),
+                            _mm256_shuffle_epi8(v, swap256));
+    }
+#endif
+#if defined(__SSSE3__)
+    const __m128i swap128 = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8,
+                                         15, 14, 13, 12);
+    for (; I + 4 <= count; I += 4) {
+        __m128i v =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 4 * I));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(words + I),
+                         _mm_shuffle_epi8(v, swap128));
+    }
+#endif
+    // compilers turn this into a byte swap instruction
+    for (; I < count; ++I) {
+        const uint8_t* word = bytes + 4 * I;
+        words[I] = TamCode(word[0]) << 24 | TamCode(word[1]) << 16 |
+                   TamCode(word[2]) << 8 | TamCode(word[3]);
+    }
+}
+
+std::vector<TamCode> ReadProgramFromFile(const std::string& filename) {
+    FileContents contents(filename);
+    std::vector<TamCode> codes(CheckProgramSize(contents.size()));
+    DecodeProgramBytes(contents.data(), codes.size(), codes.data());
+    return codes;
+}
+
+std::shared_ptr<const TamProgram> TamProgram::FromImage(const uint8_t* bytes,
+                                                        size_t size) {
+    std::vector<TamCode> code(CheckProgramSize(size));
+    DecodeProgramBytes(bytes, code.size(), code.data());
+    return std::shared_ptr<const TamProgram>(new TamProgram(std::move(code)));
+}
+
+std::shared_ptr<const TamProgram> TamProgram::FromFile(
+    const std::string& filename) {
+    FileContents contents(filename);
+    return FromImage(contents.data(), contents.size());
+}
+
+void TamEmulator::LoadProgramImage(const uint8_t* bytes, size_t size) {
+    this->LoadProgram(TamProgram::FromImage(bytes, size));
+}
+
+void TamEmulator::LoadProgramFile(const std::string& filename) {
+    this->LoadProgram(TamProgram::FromFile(filename));
+}
+
+}  // namespace tam
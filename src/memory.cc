@@ -0,0 +1,61 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file memory.cc
+/// This file defines the functions that obtain lazily zeroed memory from the
+/// operating system.
+//
+//===-----------------------------------------------------------------------===//
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TAM_ANONYMOUS_PAGES 1
+#include <sys/mman.h>
+#else
+#define TAM_ANONYMOUS_PAGES 0
+#endif
+
+#include "tam/memory.h"
+
+namespace tam {
+
+void* AllocateZeroedPages(size_t bytes) {
+#if TAM_ANONYMOUS_PAGES
+    void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) throw std::bad_alloc();
+#else
+    void* memory = calloc(1, bytes);
+    if (!memory) throw std::bad_alloc();
+#endif
+    return memory;
+}
+
+void FreeZeroedPages(void* memory, size_t bytes) {
+#if TAM_ANONYMOUS_PAGES
+    munmap(memory, bytes);
+#else
+    free(memory);
+#endif
+}
+
+}  // namespace tam
@@ -24,11 +24,16 @@
 
 #include <assert.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
-#include <stack>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 #include "tam/error.h"
+#include "tam/io.h"
 #include "tam/tam.h"
 
 namespace tam {
@@ -204,105 +209,224 @@ void TamEmulator::PrimitiveGt() {
     this->PushData(arg1 > arg2 ? 1 : 0);
 }
 
-void TamEmulator::PrimitiveEq() {
-    TamData width = this->PopData();
-    std::stack<TamData> arg1, arg2;
+/// Compare two ranges of words, several at a time where the target supports
+/// it.
+///
+/// @param a first range
+/// @param b second range
+/// @param n number of words in each range
+/// @return `true` if every word of `a` equals the corresponding word of `b`
+static bool WordsEqual(const TamData* a, const TamData* b, int n) {
+    int I = 0;
+#if defined(__AVX2__)
+    for (; I + 16 <= n; I += 16) {
+        __m256i va =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + I));
+        __m256i vb =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + I));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi16(va, vb)) != -1)
+            return false;
+    }
+#endif
+#if defined(__SSE2__)
+    for (; I + 8 <= n; I += 8) {
+        __m128i va =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + I));
+        __m128i vb =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + I));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(va, vb)) != 0xffff) return false;
+    }
+#endif
+    for (; I < n; ++I)
+        if (a[I] != b[I]) return false;
+    return true;
+}
 
-    for (int i = 0; i < width; ++i) arg2.push(this->PopData());
-    for (int i = 0; i < width; ++i) arg1.push(this->PopData());
+/// Pops both operands in one step and compares them where they lie on the
+/// stack. A negative width is treated as zero, so the operands are equal.
+bool TamEmulator::PopEqualOperands() {
+    const int width = std::max<int>(this->PopData(), 0);
+    const TamAddr arg1 = this->PopBlock(2 * width);
+    return WordsEqual(&this->data_store_[arg1],
+                      &this->data_store_[arg1 + width], width);
+}
 
-    assert(arg1.size() == arg2.size());
-    this->PushData(arg1 == arg2 ? 1 : 0);
+void TamEmulator::PrimitiveEq() {
+    this->PushData(this->PopEqualOperands() ? 1 : 0);
 }
 
 void TamEmulator::PrimitiveNe() {
-    TamData width = this->PopData();
-    std::stack<TamData> arg1, arg2;
-
-    for (int i = 0; i < width; ++i) arg2.push(this->PopData());
-    for (int i = 0; i < width; ++i) arg1.push(this->PopData());
+    this->PushData(this->PopEqualOperands() ? 0 : 1);
+}
 
-    assert(arg1.size() == arg2.size());
-    this->PushData(arg1 != arg2 ? 1 : 0);
+static void CheckStream(const InputSource& stream) {
+    if (stream.Failed()) throw IoError("failed to get stream for IO");
 }
 
-static void CheckStream(FILE* stream) {
-    if (!stream || ferror(stream)) throw IoError("failed to get stream for IO");
+static void CheckStream(const OutputSink& stream) {
+    if (stream.Failed()) throw IoError("failed to get stream for IO");
 }
 
+namespace {
+
+/// Reads input on behalf of a single primitive.
+///
+/// If the source has no character ready, everything the primitive has read is
+/// returned to the source and `InputBlocked` is thrown, so the primitive must
+/// not change the state of the emulator until it has finished reading.
+class PrimitiveReader {
+   public:
+    explicit PrimitiveReader(InputSource& input) : input_(input) {}
+
+    int Get() {
+        int c = this->input_.Get();
+        if (c == InputSource::kWouldBlock) this->Block();
+        if (c != EOF) ++this->count_;
+        return c;
+    }
+
+    int Peek() {
+        int c = this->input_.Peek();
+        if (c == InputSource::kWouldBlock) this->Block();
+        return c;
+    }
+
+    /// Skip the rest of the current line, including its end.
+    ///
+    void SkipLine() {
+        int c;
+        while ((c = this->Get()) != '\n' && c != EOF);
+    }
+
+   private:
+    [[noreturn]] void Block() {
+        this->input_.Unget(this->count_);
+        throw InputBlocked();
+    }
+
+    InputSource& input_;
+    size_t count_ = 0;  ///< Number of characters read
+};
+
+}  // namespace
+
 void TamEmulator::PrimitiveEol() {
-    CheckStream(this->instream_);
+    CheckStream(*this->input_);
 
-    char c = fgetc(this->instream_);
+    int c = PrimitiveReader(*this->input_).Peek();
     this->PushData(c == '\n' ? 1 : 0);
-    ungetc(c, this->instream_);
 }
 
 void TamEmulator::PrimitiveEof() {
-    CheckStream(this->instream_);
+    CheckStream(*this->input_);
 
-    this->PushData(feof(this->instream_) ? 1 : 0);
+    this->PushData(this->input_->Eof() ? 1 : 0);
 }
 
 void TamEmulator::PrimitiveGet() {
-    CheckStream(this->instream_);
+    CheckStream(*this->input_);
 
+    char c = PrimitiveReader(*this->input_).Get();
     TamAddr addr = this->PopData();
-    char c = getc(this->instream_);
+    this->MarkWritten(addr);
     this->data_store_[addr] = c;
 }
 
 void TamEmulator::PrimitivePut() {
-    CheckStream(this->outstream_);
+    CheckStream(*this->output_);
 
     char c = this->PopData();
-    putc(c, this->outstream_);
+    this->output_->Put(c);
 }
 
 void TamEmulator::PrimitiveGeteol() {
-    CheckStream(this->instream_);
+    CheckStream(*this->input_);
 
-    char c;
-    while ((c = fgetc(this->instream_)) != '\n');
+    PrimitiveReader(*this->input_).SkipLine();
 }
 
 void TamEmulator::PrimitivePuteol() {
-    CheckStream(this->outstream_);
+    CheckStream(*this->output_);
+
+    this->output_->Put('\n');
+}
 
-    putc('\n', this->outstream_);
+/// Check whether a character counts as whitespace before an integer, as by
+/// `isspace` in the "C" locale.
+static bool IsSpace(int c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
 }
 
 void TamEmulator::PrimitiveGetint() {
-    CheckStream(this->instream_);
+    CheckStream(*this->input_);
 
-    int n;
-    fscanf(this->instream_, "%d", &n);
+    // read an optionally signed run of digits after any leading whitespace
+    PrimitiveReader input(*this->input_);
+    int c;
+    while (IsSpace(c = input.Peek())) input.Get();
+
+    bool negative = c == '-';
+    if (c == '-' || c == '+') {
+        input.Get();
+        c = input.Peek();
+    }
+    if (c < '0' || c > '9') {
+        throw IoError("expected an integer");
+    }
+
+    // magnitude saturates just past the largest that fits, so that long runs
+    // of digits cannot overflow
+    int magnitude = 0;
+    do {
+        input.Get();
+        magnitude = std::min(magnitude * 10 + (c - '0'), -INT16_MIN + 1);
+    } while ((c = input.Peek()) >= '0' && c <= '9');
+
+    int n = negative ? -magnitude : magnitude;
     if (n < INT16_MIN || n > INT16_MAX) {
         throw IoError("integer out of range");
     }
-    this->PrimitiveGeteol();  // flush line
+    input.SkipLine();  // flush line
 
     TamAddr addr = this->PopData();
+    this->MarkWritten(addr);
     this->data_store_[addr] = n;
 }
 
 void TamEmulator::PrimitivePutint() {
-    CheckStream(this->outstream_);
+    CheckStream(*this->output_);
 
     TamData n = this->PopData();
-    fprintf(this->outstream_, "%d", n);
+
+    // write digits backwards from the end of the buffer
+    char buffer[6];
+    char* first = buffer + sizeof buffer;
+    int magnitude = n < 0 ? -n : n;
+    do {
+        *--first = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude);
+    if (n < 0) *--first = '-';
+
+    this->output_->Write(first, buffer + sizeof buffer - first);
 }
 
 void TamEmulator::PrimitiveNew() {
     TamData n = this->PopData();
     TamAddr addr = this->Allocate(n);
     this->PushData(addr);
+    if (this->heap_listener_)
+        this->heap_listener_->OnAllocate(this->registers_[CP] - 1, addr, n,
+                                         this->listener_steps_);
 }
 
 void TamEmulator::PrimitiveDispose() {
     TamAddr addr = this->PopData();
     TamData size = this->PopData();
     this->Free(addr, size);
+    if (this->heap_listener_)
+        this->heap_listener_->OnDispose(this->registers_[CP] - 1, addr, size,
+                                        this->listener_steps_);
 }
 
 }  // namespace tam
@@ -0,0 +1,565 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file profiler.cc
+/// This file defines the methods of `SamplingProfiler`, `CallGraphProfiler`
+/// and `HeapProfiler`.
+///
+/// The sampling and heap profilers find the call stack by following the
+/// dynamic links of the frames from `LB`. Each frame holds the address its
+/// `CALL` returns to, which identifies both the caller and, through the `CALL`
+/// itself, the procedure called.
+//
+//===-----------------------------------------------------------------------===//
+
+#include "tam/profiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tam/program.h"
+#include "tam/tam.h"
+
+namespace tam {
+
+/// Frames followed before giving up on a stack, in case it is corrupt.
+constexpr size_t kMaxStackDepth = 4096;
+
+/// Get the name of the procedure starting at `entry` in profiles.
+///
+static std::string ProcedureName(TamAddr entry) {
+    if (entry == 0) return "main";
+    char name[16];
+    snprintf(name, sizeof(name), "proc_%04x", entry);
+    return name;
+}
+
+/// Find the start of every procedure in a program, in order of address. The
+/// main program starts at 0.
+///
+static std::vector<TamAddr> FindProcedures(const TamProgram& program) {
+    const std::vector<DecodedInstruction>& code = program.decoded();
+
+    std::vector<TamAddr> entries{0};
+    for (const DecodedInstruction& decoded : code) {
+        const TamInstruction& instr = decoded.instr;
+        // closures passed to `CALLI` are made by loading code addresses
+        if ((instr.op == CALL || instr.op == LOADA) && instr.r == CB &&
+            instr.d >= 0 && size_t(instr.d) < code.size())
+            entries.push_back(instr.d);
+    }
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+    return entries;
+}
+
+/// Get the procedure in `entries` that starts closest at or below `addr`.
+///
+static TamAddr ProcedureAt(const std::vector<TamAddr>& entries, TamAddr addr) {
+    return *(std::upper_bound(entries.begin(), entries.end(), addr) - 1);
+}
+
+/// Find the return address of each frame on the call stack of an emulator,
+/// innermost first, by following the dynamic links from `LB`.
+///
+/// A frame based at 0 cannot be told apart from the main program, whose `LB`
+/// is also 0, so it is counted as part of the main program.
+static void FindReturnAddresses(const TamEmulator& emulator, size_t code_size,
+                                std::vector<TamAddr>& addrs) {
+    const TamAddr st = emulator.RegisterValue(ST);
+
+    addrs.clear();
+    TamAddr lb = emulator.RegisterValue(LB);
+    while (lb != 0 && lb + 2 < st && addrs.size() < kMaxStackDepth) {
+        TamAddr return_addr = emulator.DataValue(lb + 2);
+        TamAddr dynamic_link = emulator.DataValue(lb + 1);
+        if (return_addr == 0 || return_addr > code_size) break;
+        addrs.push_back(return_addr);
+
+        // each frame lies above the frame of its caller
+        if (dynamic_link >= lb) break;
+        lb = dynamic_link;
+    }
+}
+
+SamplingProfiler::SamplingProfiler(std::shared_ptr<const TamProgram> program,
+                                   uint64_t period)
+    : program_(std::move(program)),
+      period_(std::max<uint64_t>(period, 1)),
+      until_sample_(this->period_),
+      entries_(FindProcedures(*this->program_)),
+      samples_(this->program_->size()),
+      owners_(this->program_->size()) {}
+
+RunResult SamplingProfiler::Run(TamEmulator& emulator, uint64_t max_steps) {
+    RunResult result{StopReason::kBudgetExhausted, 0, ""};
+    while (result.steps < max_steps) {
+        RunResult slice = emulator.Run(
+            std::min(this->until_sample_, max_steps - result.steps));
+        result.steps += slice.steps;
+        this->until_sample_ -= slice.steps;
+        if (slice.reason != StopReason::kBudgetExhausted) {
+            result.reason = slice.reason;
+            result.error = std::move(slice.error);
+            break;
+        }
+
+        if (this->until_sample_ == 0) {
+            this->Sample(emulator);
+            this->until_sample_ = this->period_;
+        }
+    }
+    return result;
+}
+
+void SamplingProfiler::Sample(const TamEmulator& emulator) {
+    this->FindCallStack(emulator, this->stack_);
+
+    TamAddr cp = emulator.RegisterValue(CP);
+    if (cp < this->samples_.size()) {
+        ++this->samples_[cp];
+        this->owners_[cp] = this->stack_.back();
+    }
+
+    // only copy the stack the first time it is seen
+    auto it = this->stacks_.find(this->stack_);
+    if (it != this->stacks_.end()) {
+        ++it->second;
+    } else {
+        this->stacks_.emplace(this->stack_, 1);
+    }
+    ++this->total_;
+}
+
+uint64_t SamplingProfiler::SamplesAt(TamAddr addr) const {
+    return addr < this->samples_.size() ? this->samples_[addr] : 0;
+}
+
+TamAddr SamplingProfiler::ProcedureAt(TamAddr addr) const {
+    return tam::ProcedureAt(this->entries_, addr);
+}
+
+void SamplingProfiler::FindCallStack(const TamEmulator& emulator,
+                                     std::vector<TamAddr>& stack) const {
+    const std::vector<DecodedInstruction>& code = this->program_->decoded();
+
+    // replace each return address with the procedure of its frame
+    FindReturnAddresses(emulator, code.size(), stack);
+    TamAddr addr = emulator.RegisterValue(CP);
+    for (TamAddr& frame : stack) {
+        const TamAddr return_addr = frame;
+        const TamInstruction& call = code[return_addr - 1].instr;
+        frame = call.op == CALL && call.r == CB ? call.d
+                                                : this->ProcedureAt(addr);
+        addr = return_addr - 1;
+    }
+    stack.push_back(0);
+    std::reverse(stack.begin(), stack.end());
+}
+
+void SamplingProfiler::WriteHotSpots(std::ostream& out, size_t limit) const {
+    char line[128];
+    snprintf(line, sizeof(line), "%llu samples, one every %llu instructions\n",
+             (unsigned long long)this->total_,
+             (unsigned long long)this->period_);
+    out << line;
+    if (!this->total_) return;
+    const double percent = 100.0 / this->total_;
+
+    // samples in each procedure itself, and in it or anything it called
+    std::map<TamAddr, std::pair<uint64_t, uint64_t>> procedures;
+    for (const auto& [stack, count] : this->stacks_) {
+        procedures[stack.back()].first += count;
+        std::vector<TamAddr> distinct = stack;
+        std::sort(distinct.begin(), distinct.end());
+        distinct.erase(std::unique(distinct.begin(), distinct.end()),
+                       distinct.end());
+        for (TamAddr entry : distinct) procedures[entry].second += count;
+    }
+
+    std::vector<std::pair<TamAddr, std::pair<uint64_t, uint64_t>>> by_self(
+        procedures.begin(), procedures.end());
+    std::stable_sort(by_self.begin(), by_self.end(),
+                     [](const auto& a, const auto& b) {
+                         return a.second > b.second;
+                     });
+
+    out << "\nprocedure         self             total\n";
+    for (const auto& [entry, counts] : by_self) {
+        snprintf(line, sizeof(line), "  %-10s %10llu %6.2f%% %10llu %6.2f%%\n",
+                 ProcedureName(entry).c_str(),
+                 (unsigned long long)counts.first, counts.first * percent,
+                 (unsigned long long)counts.second, counts.second * percent);
+        out << line;
+    }
+
+    std::vector<TamAddr> addrs;
+    for (size_t I = 0; I < this->samples_.size(); ++I)
+        if (this->samples_[I]) addrs.push_back(I);
+    std::stable_sort(addrs.begin(), addrs.end(), [this](TamAddr a, TamAddr b) {
+        return this->samples_[a] > this->samples_[b];
+    });
+    if (addrs.size() > limit) addrs.resize(limit);
+
+    out << "\naddress  procedure     samples\n";
+    for (TamAddr addr : addrs) {
+        snprintf(line, sizeof(line), "  %04x   %-10s %10llu %6.2f%%  %s\n",
+                 addr, ProcedureName(this->owners_[addr]).c_str(),
+                 (unsigned long long)this->samples_[addr],
+                 this->samples_[addr] * percent,
+                 GetMnemonic(this->program_->decoded()[addr].instr).c_str());
+        out << line;
+    }
+}
+
+void SamplingProfiler::WriteFoldedStacks(std::ostream& out) const {
+    for (const auto& [stack, count] : this->stacks_) {
+        for (size_t I = 0; I < stack.size(); ++I)
+            out << (I ? ";" : "") << ProcedureName(stack[I]);
+        out << ' ' << count << '\n';
+    }
+}
+
+CallGraphProfiler::CallGraphProfiler(TamEmulator& emulator,
+                                     CallGraphOptions options)
+    : emulator_(emulator),
+      options_(options),
+      start_steps_(emulator.ListenerSteps()) {
+    if (this->options_.wall_time) this->start_time_ = Clock::now();
+    this->last_steps_ = this->start_steps_;
+    this->last_time_ = this->start_time_;
+    this->emulator_.SetCallListener(this);
+    this->Push(0, this->start_steps_, this->start_time_);
+}
+
+CallGraphProfiler::~CallGraphProfiler() {
+    this->emulator_.SetCallListener(nullptr);
+}
+
+void CallGraphProfiler::OnCall(TamAddr site, TamAddr target, uint64_t steps) {
+    (void)site;
+    Clock::time_point now =
+        this->options_.wall_time ? Clock::now() : Clock::time_point();
+    this->Charge(steps, now);
+    this->Push(target, steps, now);
+}
+
+void CallGraphProfiler::OnReturn(TamAddr site, uint64_t steps) {
+    (void)site;
+    Clock::time_point now =
+        this->options_.wall_time ? Clock::now() : Clock::time_point();
+    this->Charge(steps, now);
+    // the main program cannot return, so this only happens if the program
+    // was already running when profiling started
+    if (this->frames_.size() > 1) this->Pop(steps, now);
+}
+
+void CallGraphProfiler::Finish() {
+    const uint64_t steps = this->emulator_.ListenerSteps();
+    Clock::time_point now =
+        this->options_.wall_time ? Clock::now() : Clock::time_point();
+    this->Charge(steps, now);
+    while (!this->frames_.empty()) this->Pop(steps, now);
+}
+
+void CallGraphProfiler::Charge(uint64_t steps, Clock::time_point now) {
+    if (this->frames_.empty()) return;
+    ProcedureProfile& procedure = *this->frames_.back().procedure;
+    procedure.exclusive_steps += steps - this->last_steps_;
+    procedure.exclusive_seconds +=
+        std::chrono::duration<double>(now - this->last_time_).count();
+    this->last_steps_ = steps;
+    this->last_time_ = now;
+}
+
+void CallGraphProfiler::Push(TamAddr entry, uint64_t steps,
+                             Clock::time_point now) {
+    ProcedureProfile* procedure = &this->procedures_[entry];
+    int* active = &this->active_[entry];
+    ++procedure->calls;
+    ++*active;
+
+    // once `events_` is full, `event` is its size and so refers to nothing
+    size_t event = this->events_.size();
+    if (event < this->options_.max_trace_events)
+        this->events_.push_back(Event{entry, this->Timestamp(steps, now), -1});
+    this->frames_.push_back(
+        Frame{entry, procedure, active, steps, now, event});
+}
+
+void CallGraphProfiler::Pop(uint64_t steps, Clock::time_point now) {
+    Frame frame = this->frames_.back();
+    this->frames_.pop_back();
+
+    // only the outermost of recursive calls counts towards inclusive totals
+    if (--*frame.active == 0) {
+        ProcedureProfile& procedure = *frame.procedure;
+        procedure.inclusive_steps += steps - frame.start_steps;
+        procedure.inclusive_seconds +=
+            std::chrono::duration<double>(now - frame.start_time).count();
+    }
+
+    if (frame.event < this->events_.size()) {
+        Event& event = this->events_[frame.event];
+        event.duration = this->Timestamp(steps, now) - event.start;
+    }
+}
+
+double CallGraphProfiler::Timestamp(uint64_t steps,
+                                    Clock::time_point now) const {
+    if (!this->options_.wall_time) return steps - this->start_steps_;
+    return std::chrono::duration<double, std::micro>(now - this->start_time_)
+        .count();
+}
+
+void CallGraphProfiler::WriteReport(std::ostream& out) const {
+    std::vector<std::pair<TamAddr, ProcedureProfile>> procedures(
+        this->procedures_.begin(), this->procedures_.end());
+    std::stable_sort(procedures.begin(), procedures.end(),
+                     [](const auto& a, const auto& b) {
+                         return a.second.exclusive_steps >
+                                b.second.exclusive_steps;
+                     });
+
+    uint64_t total = 0;
+    for (const auto& [entry, procedure] : procedures)
+        total += procedure.exclusive_steps;
+    const double percent = total ? 100.0 / total : 0;
+
+    char line[160];
+    out << "procedure        calls          inclusive          exclusive";
+    if (this->options_.wall_time) out << "    incl ms    excl ms";
+    out << '\n';
+    for (const auto& [entry, procedure] : procedures) {
+        snprintf(line, sizeof(line),
+                 "  %-10s %10llu %11llu %6.2f%% %11llu %6.2f%%",
+                 ProcedureName(entry).c_str(),
+                 (unsigned long long)procedure.calls,
+                 (unsigned long long)procedure.inclusive_steps,
+                 procedure.inclusive_steps * percent,
+                 (unsigned long long)procedure.exclusive_steps,
+                 procedure.exclusive_steps * percent);
+        out << line;
+        if (this->options_.wall_time) {
+            snprintf(line, sizeof(line), " %10.3f %10.3f",
+                     procedure.inclusive_seconds * 1000,
+                     procedure.exclusive_seconds * 1000);
+            out << line;
+        }
+        out << '\n';
+    }
+}
+
+void CallGraphProfiler::WriteChromeTrace(std::ostream& out) const {
+    char line[128];
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (const Event& event : this->events_) {
+        // calls still in progress have no end to show
+        if (event.duration < 0) continue;
+        snprintf(line, sizeof(line),
+                 "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,"
+                 "\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+                 first ? "" : ",", ProcedureName(event.entry).c_str(),
+                 event.start, event.duration);
+        out << line;
+        first = false;
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+HeapProfiler::HeapProfiler(TamEmulator& emulator)
+    : emulator_(emulator),
+      entries_(FindProcedures(*emulator.GetProgram())),
+      code_size_(emulator.GetProgram()->size()),
+      start_steps_(emulator.ListenerSteps()) {
+    this->emulator_.SetHeapListener(this);
+}
+
+HeapProfiler::~HeapProfiler() { this->emulator_.SetHeapListener(nullptr); }
+
+void HeapProfiler::OnAllocate(TamAddr site, TamAddr addr, int size,
+                              uint64_t steps) {
+    HeapSiteProfile& profile = this->SiteOf(site);
+    ++profile.allocations;
+    profile.allocated_words += size;
+    ++this->allocations_;
+    this->allocated_words_ += size;
+    ++this->sizes_[size];
+
+    // empty blocks all share address 0 and take up no space
+    if (size == 0) return;
+    this->live_[addr] = Block{&profile, size, steps};
+    ++profile.live_blocks;
+    profile.live_words += size;
+    this->live_words_ += size;
+    if (this->live_words_ > this->peak_words_) {
+        this->peak_words_ = this->live_words_;
+        this->peak_blocks_ = this->live_.size();
+        this->peak_steps_ = steps - this->start_steps_;
+    }
+}
+
+void HeapProfiler::OnDispose(TamAddr site, TamAddr addr, int size,
+                             uint64_t steps) {
+    (void)size;
+    ++this->SiteOf(site).disposals;
+    ++this->disposals_;
+
+    // blocks allocated before profiling started are not known
+    auto it = this->live_.find(addr);
+    if (it == this->live_.end()) return;
+    const Block& block = it->second;
+    HeapSiteProfile& profile = *block.site;
+    const uint64_t lifetime = steps - block.allocated_at;
+    ++profile.freed;
+    profile.total_lifetime += lifetime;
+    profile.max_lifetime = std::max(profile.max_lifetime, lifetime);
+    --profile.live_blocks;
+    profile.live_words -= block.size;
+    this->live_words_ -= block.size;
+    this->live_.erase(it);
+}
+
+HeapSiteProfile& HeapProfiler::SiteOf(TamAddr site) {
+    // each frame was made by the `CALL` before its return address
+    FindReturnAddresses(this->emulator_, this->code_size_, this->site_);
+    for (TamAddr& addr : this->site_) --addr;
+    std::reverse(this->site_.begin(), this->site_.end());
+    this->site_.push_back(site);
+
+    // only copy the site the first time it is seen
+    auto it = this->sites_.find(this->site_);
+    if (it == this->sites_.end())
+        it = this->sites_.emplace(this->site_, HeapSiteProfile()).first;
+    return it->second;
+}
+
+std::string HeapProfiler::SiteName(const std::vector<TamAddr>& site) const {
+    std::string name;
+    char call[32];
+    for (TamAddr addr : site) {
+        snprintf(call, sizeof(call), "%s%s:%04x", name.empty() ? "" : " > ",
+                 ProcedureName(tam::ProcedureAt(this->entries_, addr)).c_str(),
+                 addr);
+        name += call;
+    }
+    return name;
+}
+
+void HeapProfiler::WriteReport(std::ostream& out) const {
+    typedef std::pair<const std::vector<TamAddr>*, const HeapSiteProfile*>
+        Site;
+    auto sorted_sites = [this](auto key) {
+        std::vector<Site> sites;
+        for (const auto& [site, profile] : this->sites_)
+            if (key(profile)) sites.emplace_back(&site, &profile);
+        std::stable_sort(sites.begin(), sites.end(),
+                         [&key](const Site& a, const Site& b) {
+                             return key(*a.second) > key(*b.second);
+                         });
+        return sites;
+    };
+
+    char line[160];
+    snprintf(line, sizeof(line),
+             "%llu instructions\n"
+             "allocated    %10llu blocks %10llu words\n"
+             "disposed of  %10llu blocks\n",
+             (unsigned long long)(this->emulator_.ListenerSteps() -
+                                  this->start_steps_),
+             (unsigned long long)this->allocations_,
+             (unsigned long long)this->allocated_words_,
+             (unsigned long long)this->disposals_);
+    out << line;
+    snprintf(line, sizeof(line),
+             "peak         %10llu blocks %10llu words after %llu "
+             "instructions\n"
+             "still live   %10llu blocks %10llu words\n",
+             (unsigned long long)this->peak_blocks_,
+             (unsigned long long)this->peak_words_,
+             (unsigned long long)this->peak_steps_,
+             (unsigned long long)this->live_.size(),
+             (unsigned long long)this->live_words_);
+    out << line;
+
+    std::vector<Site> sites = sorted_sites(
+        [](const HeapSiteProfile& profile) { return profile.live_words; });
+    if (!sites.empty()) {
+        out << "\nstill live     blocks      words  site\n";
+        for (const auto& [site, profile] : sites) {
+            snprintf(line, sizeof(line), "           %10llu %10llu  ",
+                     (unsigned long long)profile->live_blocks,
+                     (unsigned long long)profile->live_words);
+            out << line << this->SiteName(*site) << '\n';
+        }
+    }
+
+    sites = sorted_sites([](const HeapSiteProfile& profile) {
+        return profile.allocations ? profile.allocated_words + 1 : 0;
+    });
+    if (!sites.empty()) {
+        out << "\nallocated      blocks      words      freed  mean life"
+               "   max life  site\n";
+        for (const auto& [site, profile] : sites) {
+            snprintf(line, sizeof(line),
+                     "           %10llu %10llu %10llu %10.1f %10llu  ",
+                     (unsigned long long)profile->allocations,
+                     (unsigned long long)profile->allocated_words,
+                     (unsigned long long)profile->freed,
+                     profile->freed ? double(profile->total_lifetime) /
+                                          profile->freed
+                                    : 0.0,
+                     (unsigned long long)profile->max_lifetime);
+            out << line << this->SiteName(*site) << '\n';
+        }
+    }
+
+    sites = sorted_sites(
+        [](const HeapSiteProfile& profile) { return profile.disposals; });
+    if (!sites.empty()) {
+        out << "\ndisposed of    blocks  site\n";
+        for (const auto& [site, profile] : sites) {
+            snprintf(line, sizeof(line), "           %10llu  ",
+                     (unsigned long long)profile->disposals);
+            out << line << this->SiteName(*site) << '\n';
+        }
+    }
+
+    if (!this->sizes_.empty()) {
+        out << "\nblock size     blocks\n";
+        for (const auto& [size, count] : this->sizes_) {
+            snprintf(line, sizeof(line), "%10d %10llu %6.2f%%\n", size,
+                     (unsigned long long)count,
+                     100.0 * count / this->allocations_);
+            out << line;
+        }
+    }
+}
+
+}  // namespace tam
@@ -0,0 +1,87 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file program.cc
+/// This file defines the methods of `TamProgram` that decode programs. The
+/// methods that read TAM binaries are defined in loader.cc, and
+/// `FuseInstructions` in fusion.cc.
+//
+//===-----------------------------------------------------------------------===//
+
+#include "tam/program.h"
+
+#include <stddef.h>
+
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "tam/error.h"
+#include "tam/jit.h"
+#include "tam/tam.h"
+
+namespace tam {
+
+TamProgram::TamProgram(std::vector<TamCode> code) : code_(std::move(code)) {
+    if (this->code_.size() > kMemSize) throw IoError("program file too large");
+    this->Decode();
+}
+
+TamProgram::~TamProgram() = default;
+
+std::shared_ptr<const TamProgram> TamProgram::FromCode(const TamCode* code,
+                                                       size_t size) {
+    if (size > kMemSize) throw IoError("program file too large");
+    return std::shared_ptr<const TamProgram>(
+        new TamProgram(std::vector<TamCode>(code, code + size)));
+}
+
+std::shared_ptr<const TamProgram> TamProgram::FromCode(
+    const std::vector<TamCode>& code) {
+    return std::shared_ptr<const TamProgram>(new TamProgram(code));
+}
+
+const std::shared_ptr<const TamProgram>& TamProgram::Empty() {
+    static const std::shared_ptr<const TamProgram> empty =
+        FromCode(nullptr, 0);
+    return empty;
+}
+
+void TamProgram::Decode() {
+    this->decoded_.resize(this->code_.size());
+    for (size_t I = 0; I < this->code_.size(); ++I) {
+        TamInstruction instr = DecodeInstruction(this->code_[I]);
+        uint8_t handler = instr.op;
+        if (instr.op == CALL && instr.r == PB && instr.d > 0 && instr.d < 29)
+            handler = kPrimitiveHandlerBase + instr.d;
+
+        this->decoded_[I] = DecodedInstruction{instr, handler};
+    }
+
+    this->FuseInstructions();
+}
+
+const JitCode* TamProgram::GetJitCode() const {
+    std::call_once(this->jit_once_, [this] {
+        this->jit_ = JitCode::Compile(this->decoded_);
+    });
+    return this->jit_.get();
+}
+
+}  // namespace tam
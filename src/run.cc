@@ -0,0 +1,689 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file run.cc
+/// This file defines the `Run` method of `TamEmulator`, which executes many
+/// instructions in a single call, and the interpreter behind it.
+///
+/// Each opcode, each primitive and each superinstruction has its own handler.
+/// When built with `TAM_THREADED_DISPATCH` on a compiler supporting
+/// labels-as-values, every handler jumps directly to the next through a table
+/// of label addresses. Otherwise the handlers are the cases of a `switch`
+/// inside a loop.
+//
+//===-----------------------------------------------------------------------===//
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <string>
+
+#include "tam/error.h"
+#include "tam/program.h"
+#include "tam/tam.h"
+
+namespace tam {
+
+#if TAM_THREADED_DISPATCH && (defined(__GNUC__) || defined(__clang__))
+#define TAM_COMPUTED_GOTO 1
+#else
+#define TAM_COMPUTED_GOTO 0
+#endif
+
+// Handler indices for the primitives, see `kPrimitiveHandlerBase`.
+enum PrimitiveHandler {
+    kId = kPrimitiveHandlerBase + 1,
+    kNot,
+    kAnd,
+    kOr,
+    kSucc,
+    kPred,
+    kNeg,
+    kAdd,
+    kSub,
+    kMult,
+    kDiv,
+    kMod,
+    kLt,
+    kLe,
+    kGe,
+    kGt,
+    kEq,
+    kNe,
+    kEol,
+    kEof,
+    kGet,
+    kPut,
+    kGeteol,
+    kPuteol,
+    kGetint,
+    kPutint,
+    kNew,
+    kDispose,
+};
+
+/// How far past `ST` the interpreter raises `stack_used_` at a time, so that it
+/// rarely needs to be raised.
+constexpr int kStackChunk = 256;
+
+// Records a transfer of control from `from` to `cp` in the flight recorder.
+#if TAM_FLIGHT_RECORDER
+#define RECORD_TRANSFER(from) this->RecordTransfer(from, cp, st, lb, ht)
+#else
+#define RECORD_TRANSFER(from) ((void)0)
+#endif
+
+RunResult TamEmulator::Run(uint64_t max_steps) {
+    if (this->stats_enabled_ || this->call_listener_ ||
+        this->heap_listener_) {
+        RunResult result = this->Interpret<true>(max_steps);
+        // the registers after the last instruction executed
+        this->stats_.peak_st =
+            std::max(this->stats_.peak_st, this->registers_[ST]);
+        this->stats_.lowest_ht =
+            std::min(this->stats_.lowest_ht, this->registers_[HT]);
+        return result;
+    }
+    if (this->jit_enabled_) return this->RunJit(max_steps);
+    return this->Interpret<false>(max_steps);
+}
+
+void TamEmulator::CountInstruction(TamInstruction instr, TamAddr st,
+                                   TamAddr ht) {
+    ExecutionStats& stats = this->stats_;
+    ++stats.instructions;
+    ++stats.opcodes[instr.op];
+    if (instr.op == CALL && instr.r == PB && instr.d > 0 && instr.d < 29)
+        ++stats.primitives[instr.d];
+    stats.peak_st = std::max(stats.peak_st, st);
+    stats.lowest_ht = std::min(stats.lowest_ht, ht);
+}
+
+/// Executes the decoded instructions of the program until the program halts, an
+/// error occurs, or `max_steps` instructions have been executed.
+///
+/// The `CP`, `ST`, `LB` and `HT` registers are held in locals for the duration
+/// of the loop. They are written back to `registers_` before calling any
+/// member function that expects to see them, and re-read afterwards. The
+/// behaviour of each handler mirrors the corresponding `Execute*` or
+/// `Primitive*` method.
+///
+/// When instrumented, superinstructions are executed as the separate
+/// instructions they replaced so that each of those is counted, and calls and
+/// returns are reported to any call listener.
+template <bool kInstrumented>
+RunResult TamEmulator::Interpret(uint64_t max_steps) {
+    const DecodedInstruction* code = this->program_->decoded().data();
+    const TamAddr ct = this->registers_[CT];
+
+    TamAddr cp = this->registers_[CP], st = this->registers_[ST],
+            lb = this->registers_[LB], ht = this->registers_[HT];
+    // words are only written at or above `limit` after `grow` has recorded
+    // how far up the stack has reached
+    TamAddr limit = std::min<int>(ht, this->stack_used_);
+    bool synced = false;  // `true` while `registers_` is authoritative
+    uint64_t steps = 0;
+
+    TamAddr addr;
+    TamInstruction instr;
+    uint8_t handler;
+
+    auto sync = [&] {
+        this->registers_[CP] = cp;
+        this->registers_[ST] = st;
+        this->registers_[LB] = lb;
+        synced = true;
+    };
+    auto reload = [&] {
+        cp = this->registers_[CP];
+        st = this->registers_[ST];
+        lb = this->registers_[LB];
+        ht = this->registers_[HT];
+        limit = std::min<int>(ht, this->stack_used_);
+        synced = false;
+    };
+
+    auto reg = [&](uint8_t r) -> TamAddr {
+        switch (r) {
+            case CP:
+                return cp;
+            case ST:
+                return st;
+            case LB:
+                return lb;
+            case HT:
+                return ht;
+            default:
+                return this->registers_[r];
+        }
+    };
+    auto grow = [&] {
+        if (st >= ht)
+            throw RuntimeError(ExceptionKind::kStackOverflow, cp - 1);
+        this->stack_used_ = std::min<int>(ht, st + kStackChunk);
+        limit = this->stack_used_;
+    };
+    auto push = [&](TamData value) {
+        if (st >= limit) grow();
+        this->data_store_[st++] = value;
+    };
+    auto pop = [&]() -> TamData {
+        if (st == 0) throw RuntimeError(ExceptionKind::kStackUnderflow, cp - 1);
+        return this->data_store_[--st];
+    };
+    auto check_data = [&](TamAddr addr) {
+        if (addr >= st && addr <= ht)
+            throw RuntimeError(ExceptionKind::kDataAccessViolation, cp - 1);
+    };
+    auto check_code = [&](int addr) {
+        if (addr >= ct)
+            throw RuntimeError(ExceptionKind::kCodeAccessViolation, cp - 1);
+    };
+
+    // Executes `LOAD(1); LOAD(1); CALL compare; JUMPIF(n)` starting at `addr`
+    // without touching the stack pointer, if none of the four instructions
+    // could fail. Returns `false` without doing anything otherwise.
+    auto load_load_compare_jumpif = [&](auto compare) -> bool {
+        const TamInstruction& load1 = code[addr].instr;
+        const TamInstruction& load2 = code[addr + 1].instr;
+        const TamInstruction& jumpif = code[addr + 3].instr;
+
+        TamAddr addr1 = reg(load1.r) + load1.d;
+        TamAddr addr2 = reg(load2.r) + load2.d;
+        if (st + 1 >= limit || max_steps - steps < 3 ||
+            (addr1 >= st && addr1 <= ht) || (addr2 >= st + 1 && addr2 <= ht))
+            return false;
+
+        // leave the words above `st` as the unfused sequence would
+        TamData arg1 = this->data_store_[addr1];
+        this->data_store_[st] = arg1;
+        TamData arg2 = this->data_store_[addr2];
+        this->data_store_[st + 1] = arg2;
+        TamData result = compare(arg1, arg2) ? 1 : 0;
+        this->data_store_[st] = result;
+
+        cp = addr + 4;
+        steps += 3;
+        if (result == jumpif.n) {
+            TamAddr target = reg(jumpif.r) + jumpif.d;
+            check_code(target);
+            cp = target;
+            RECORD_TRANSFER(addr + 3);
+        }
+        return true;
+    };
+
+#define FETCH()                                                          \
+    do {                                                                 \
+        if (steps >= max_steps) goto budget_exhausted;                   \
+        addr = cp++;                                                     \
+        if (addr >= ct)                                                  \
+            throw RuntimeError(ExceptionKind::kCodeAccessViolation, addr); \
+        instr = code[addr].instr;                                        \
+        handler = code[addr].handler;                                    \
+        ++steps;                                                         \
+        if (kInstrumented) {                                             \
+            if (handler >= kLoadlAdd) handler = instr.op;                \
+            ++this->listener_steps_;                                     \
+            if (this->stats_enabled_)                                    \
+                this->CountInstruction(instr, st, ht);                   \
+        }                                                                \
+    } while (0)
+
+#define CALL_PRIMITIVE(method) \
+    do {                       \
+        sync();                \
+        this->method();        \
+        reload();              \
+    } while (0)
+
+#if TAM_COMPUTED_GOTO
+    static const void* const kDispatchTable[] = {
+        &&op_load,     &&op_loada,    &&op_loadi,   &&op_loadl,
+        &&op_store,    &&op_storei,   &&op_call,    &&op_calli,
+        &&op_return,   &&op_unknown,  &&op_push,    &&op_pop,
+        &&op_jump,     &&op_jumpi,    &&op_jumpif,  &&op_halt,
+        &&op_unknown,  &&prim_id,     &&prim_not,   &&prim_and,
+        &&prim_or,     &&prim_succ,   &&prim_pred,  &&prim_neg,
+        &&prim_add,    &&prim_sub,    &&prim_mult,  &&prim_div,
+        &&prim_mod,    &&prim_lt,     &&prim_le,    &&prim_ge,
+        &&prim_gt,     &&prim_eq,     &&prim_ne,    &&prim_eol,
+        &&prim_eof,    &&prim_get,    &&prim_put,   &&prim_geteol,
+        &&prim_puteol, &&prim_getint, &&prim_putint, &&prim_new,
+        &&prim_dispose, &&fused_loadl_add, &&fused_loada_loadi,
+        &&fused_load_load_lt, &&fused_load_load_le, &&fused_load_load_ge,
+        &&fused_load_load_gt,
+    };
+    static_assert(sizeof(kDispatchTable) / sizeof(kDispatchTable[0]) ==
+                  kLoadLoadGt + 1);
+
+#define HANDLER(label, value) label:
+#define DEFAULT_HANDLER(label) label:
+#define DISPATCH()                       \
+    do {                                 \
+        FETCH();                         \
+        goto* kDispatchTable[handler];   \
+    } while (0)
+#else
+// only the handlers that superinstructions fall back to are jumped to by label
+#if defined(__GNUC__)
+#define HANDLER(label, value) \
+    case value:               \
+    label:                    \
+    __attribute__((unused));
+#else
+#define HANDLER(label, value) \
+    case value:               \
+    label:
+#endif
+#define DEFAULT_HANDLER(label) default:
+#define DISPATCH() continue
+#endif
+
+    try {
+#if TAM_COMPUTED_GOTO
+        DISPATCH();
+#else
+        for (;;) {
+            FETCH();
+            switch (handler) {
+#endif
+
+        HANDLER(op_load, LOAD) {
+            TamAddr base_addr = reg(instr.r) + instr.d;
+            for (int I = 0; I < instr.n; ++I) {
+                check_data(base_addr + I);
+                push(this->data_store_[TamAddr(base_addr + I)]);
+            }
+        }
+        DISPATCH();
+
+        HANDLER(op_loada, LOADA) { push(reg(instr.r) + instr.d); }
+        DISPATCH();
+
+        HANDLER(op_loadi, LOADI) {
+            TamAddr base_addr = pop();
+            for (int I = 0; I < instr.n; ++I) {
+                check_data(base_addr + I);
+                push(this->data_store_[TamAddr(base_addr + I)]);
+            }
+        }
+        DISPATCH();
+
+        HANDLER(op_loadl, LOADL) { push(instr.d); }
+        DISPATCH();
+
+        HANDLER(op_store, STORE) {
+            if (st < instr.n)
+                throw RuntimeError(ExceptionKind::kStackUnderflow, cp - 1);
+            st -= instr.n;
+
+            // the popped words remain in place above `st`
+            TamAddr base_addr = reg(instr.r) + instr.d;
+            for (int I = 0; I < instr.n; ++I) {
+                check_data(base_addr + I);
+                this->data_store_[TamAddr(base_addr + I)] =
+                    this->data_store_[st + I];
+            }
+        }
+        DISPATCH();
+
+        HANDLER(op_storei, STOREI) {
+            TamAddr base_addr = pop();
+            if (st < instr.n)
+                throw RuntimeError(ExceptionKind::kStackUnderflow, cp - 1);
+            st -= instr.n;
+
+            for (int I = 0; I < instr.n; ++I) {
+                check_data(base_addr + I);
+                this->data_store_[TamAddr(base_addr + I)] =
+                    this->data_store_[st + I];
+            }
+        }
+        DISPATCH();
+
+        HANDLER(op_call, CALL) {
+            check_code(reg(instr.r) + instr.d);
+            TamAddr static_link = reg(instr.n);
+            push(static_link);
+            push(lb);
+            push(cp);
+            lb = st - 3;
+            cp = reg(instr.r) + instr.d;
+            RECORD_TRANSFER(addr);
+            if (kInstrumented && this->call_listener_)
+                this->call_listener_->OnCall(addr, cp,
+                                             this->listener_steps_);
+        }
+        DISPATCH();
+
+        HANDLER(op_calli, CALLI) {
+            TamAddr call_addr = pop();
+            TamAddr static_link = pop();
+            check_code(call_addr);
+            push(static_link);
+            push(lb);
+            push(cp);
+            lb = st - 3;
+            cp = call_addr;
+            RECORD_TRANSFER(addr);
+            if (kInstrumented && this->call_listener_)
+                this->call_listener_->OnCall(addr, cp,
+                                             this->listener_steps_);
+        }
+        DISPATCH();
+
+        HANDLER(op_return, RETURN) {
+            if (st < instr.n)
+                throw RuntimeError(ExceptionKind::kStackUnderflow, cp - 1);
+            st -= instr.n;
+            TamAddr result_addr = st;
+
+            TamAddr dynamic_link = this->data_store_[TamAddr(lb + 1)];
+            TamAddr return_addr = this->data_store_[TamAddr(lb + 2)];
+            check_code(return_addr);
+
+            // pop stack frame and arguments
+            if (st > lb) st = lb;
+            for (int I = 0; I < instr.d; ++I) pop();
+
+            // push result, copying downwards so overlap is harmless
+            assert(st <= result_addr);
+            for (int I = 0; I < instr.n; ++I)
+                push(this->data_store_[result_addr + I]);
+
+            lb = dynamic_link;
+            cp = return_addr;
+            RECORD_TRANSFER(addr);
+            if (kInstrumented && this->call_listener_)
+                this->call_listener_->OnReturn(addr,
+                                               this->listener_steps_);
+        }
+        DISPATCH();
+
+        HANDLER(op_push, PUSH) {
+            if (st + instr.d >= ht)
+                throw RuntimeError(ExceptionKind::kStackOverflow, ct - 1);
+            st += instr.d;
+        }
+        DISPATCH();
+
+        HANDLER(op_pop, POP) {
+            if (st < instr.n)
+                throw RuntimeError(ExceptionKind::kStackUnderflow, cp - 1);
+            st -= instr.n;
+            TamAddr result_addr = st;
+
+            for (int I = 0; I < instr.d; ++I) pop();
+
+            assert(st <= result_addr);
+            for (int I = 0; I < instr.n; ++I)
+                push(this->data_store_[result_addr + I]);
+        }
+        DISPATCH();
+
+        HANDLER(op_jump, JUMP) {
+            TamAddr target = reg(instr.r) + instr.d;
+            check_code(target);
+            cp = target;
+            RECORD_TRANSFER(addr);
+        }
+        DISPATCH();
+
+        HANDLER(op_jumpi, JUMPI) {
+            TamAddr target = pop();
+            check_code(target);
+            cp = target;
+            RECORD_TRANSFER(addr);
+        }
+        DISPATCH();
+
+        HANDLER(op_jumpif, JUMPIF) {
+            if (pop() == instr.n) {
+                TamAddr target = reg(instr.r) + instr.d;
+                check_code(target);
+                cp = target;
+                RECORD_TRANSFER(addr);
+            }
+        }
+        DISPATCH();
+
+        HANDLER(op_halt, HALT) {
+            sync();
+            return RunResult{StopReason::kHalted, steps, ""};
+        }
+
+        HANDLER(prim_id, kId) {}
+        DISPATCH();
+
+        HANDLER(prim_not, kNot) { push(pop() ? 0 : 1); }
+        DISPATCH();
+
+        HANDLER(prim_and, kAnd) {
+            TamData op2 = pop(), op1 = pop();
+            push(op1 != 0 && op2 != 0 ? 1 : 0);
+        }
+        DISPATCH();
+
+        HANDLER(prim_or, kOr) {
+            TamData op2 = pop(), op1 = pop();
+            push(op1 != 0 || op2 != 0 ? 1 : 0);
+        }
+        DISPATCH();
+
+        HANDLER(prim_succ, kSucc) { push(pop() + 1); }
+        DISPATCH();
+
+        HANDLER(prim_pred, kPred) { push(pop() - 1); }
+        DISPATCH();
+
+        HANDLER(prim_neg, kNeg) { push(-pop()); }
+        DISPATCH();
+
+        HANDLER(prim_add, kAdd) {
+            TamData arg2 = pop(), arg1 = pop();
+            push(arg1 + arg2);
+        }
+        DISPATCH();
+
+        HANDLER(prim_sub, kSub) {
+            TamData arg2 = pop(), arg1 = pop();
+            push(arg1 - arg2);
+        }
+        DISPATCH();
+
+        HANDLER(prim_mult, kMult) {
+            TamData arg2 = pop(), arg1 = pop();
+            push(arg1 * arg2);
+        }
+        DISPATCH();
+
+        HANDLER(prim_div, kDiv) {
+            TamData arg2 = pop(), arg1 = pop();
+            if (arg2 == 0)
+                throw RuntimeError(ExceptionKind::kDivideByZero, cp - 1);
+            push(arg1 / arg2);
+        }
+        DISPATCH();
+
+        HANDLER(prim_mod, kMod) {
+            TamData arg2 = pop(), arg1 = pop();
+            if (arg2 == 0)
+                throw RuntimeError(ExceptionKind::kDivideByZero, cp - 1);
+            push(arg1 % arg2);
+        }
+        DISPATCH();
+
+        HANDLER(prim_lt, kLt) {
+            TamData arg2 = pop(), arg1 = pop();
+            push(arg1 < arg2 ? 1 : 0);
+        }
+        DISPATCH();
+
+        HANDLER(prim_le, kLe) {
+            TamData arg2 = pop(), arg1 = pop();
+            push(arg1 <= arg2 ? 1 : 0);
+        }
+        DISPATCH();
+
+        HANDLER(prim_ge, kGe) {
+            TamData arg2 = pop(), arg1 = pop();
+            push(arg1 >= arg2 ? 1 : 0);
+        }
+        DISPATCH();
+
+        HANDLER(prim_gt, kGt) {
+            TamData arg2 = pop(), arg1 = pop();
+            push(arg1 > arg2 ? 1 : 0);
+        }
+        DISPATCH();
+
+        HANDLER(prim_eq, kEq) { CALL_PRIMITIVE(PrimitiveEq); }
+        DISPATCH();
+
+        HANDLER(prim_ne, kNe) { CALL_PRIMITIVE(PrimitiveNe); }
+        DISPATCH();
+
+        HANDLER(prim_eol, kEol) { CALL_PRIMITIVE(PrimitiveEol); }
+        DISPATCH();
+
+        HANDLER(prim_eof, kEof) { CALL_PRIMITIVE(PrimitiveEof); }
+        DISPATCH();
+
+        HANDLER(prim_get, kGet) { CALL_PRIMITIVE(PrimitiveGet); }
+        DISPATCH();
+
+        HANDLER(prim_put, kPut) { CALL_PRIMITIVE(PrimitivePut); }
+        DISPATCH();
+
+        HANDLER(prim_geteol, kGeteol) { CALL_PRIMITIVE(PrimitiveGeteol); }
+        DISPATCH();
+
+        HANDLER(prim_puteol, kPuteol) { CALL_PRIMITIVE(PrimitivePuteol); }
+        DISPATCH();
+
+        HANDLER(prim_getint, kGetint) { CALL_PRIMITIVE(PrimitiveGetint); }
+        DISPATCH();
+
+        HANDLER(prim_putint, kPutint) { CALL_PRIMITIVE(PrimitivePutint); }
+        DISPATCH();
+
+        HANDLER(prim_new, kNew) { CALL_PRIMITIVE(PrimitiveNew); }
+        DISPATCH();
+
+        HANDLER(prim_dispose, kDispose) { CALL_PRIMITIVE(PrimitiveDispose); }
+        DISPATCH();
+
+        // Superinstructions fall back to executing only their first
+        // instruction whenever the fused sequence might fail part-way, or
+        // would exceed the step budget.
+
+        HANDLER(fused_loadl_add, kLoadlAdd) {
+            if (st == 0 || st >= limit || steps >= max_steps) goto op_loadl;
+
+            this->data_store_[st] = instr.d;
+            this->data_store_[st - 1] += instr.d;
+            ++cp;
+            ++steps;
+        }
+        DISPATCH();
+
+        HANDLER(fused_loada_loadi, kLoadaLoadi) {
+            if (st >= limit || steps >= max_steps) goto op_loada;
+
+            TamAddr base_addr = reg(instr.r) + instr.d;
+            this->data_store_[st] = base_addr;
+            instr = code[addr + 1].instr;
+            ++cp;
+            ++steps;
+
+            for (int I = 0; I < instr.n; ++I) {
+                check_data(base_addr + I);
+                push(this->data_store_[TamAddr(base_addr + I)]);
+            }
+        }
+        DISPATCH();
+
+        HANDLER(fused_load_load_lt, kLoadLoadLt) {
+            if (!load_load_compare_jumpif(std::less<TamData>())) goto op_load;
+        }
+        DISPATCH();
+
+        HANDLER(fused_load_load_le, kLoadLoadLe) {
+            if (!load_load_compare_jumpif(std::less_equal<TamData>()))
+                goto op_load;
+        }
+        DISPATCH();
+
+        HANDLER(fused_load_load_ge, kLoadLoadGe) {
+            if (!load_load_compare_jumpif(std::greater_equal<TamData>()))
+                goto op_load;
+        }
+        DISPATCH();
+
+        HANDLER(fused_load_load_gt, kLoadLoadGt) {
+            if (!load_load_compare_jumpif(std::greater<TamData>()))
+                goto op_load;
+        }
+        DISPATCH();
+
+        DEFAULT_HANDLER(op_unknown) {
+            throw RuntimeError(ExceptionKind::kUnknownOpcode, cp - 1);
+        }
+
+#if !TAM_COMPUTED_GOTO
+            }
+        }
+#endif
+
+    budget_exhausted:
+        sync();
+        return RunResult{StopReason::kBudgetExhausted, steps, ""};
+    } catch (const InputBlocked&) {
+        // input primitives change nothing before blocking, so the `CALL` can
+        // simply be executed again
+        this->registers_[CP] = addr;
+        if (kInstrumented) {
+            --this->listener_steps_;
+            if (this->stats_enabled_) {
+                --this->stats_.instructions;
+                --this->stats_.opcodes[CALL];
+                --this->stats_.primitives[instr.d];
+            }
+        }
+        return RunResult{StopReason::kInputBlocked, steps - 1, ""};
+    } catch (const std::exception& e) {
+        if (!synced) sync();
+        return RunResult{StopReason::kError, steps, e.what()};
+    }
+}
+
+#undef FETCH
+#undef CALL_PRIMITIVE
+#undef HANDLER
+#undef DEFAULT_HANDLER
+#undef DISPATCH
+#undef RECORD_TRANSFER
+
+template RunResult TamEmulator::Interpret<false>(uint64_t max_steps);
+template RunResult TamEmulator::Interpret<true>(uint64_t max_steps);
+
+}  // namespace tam
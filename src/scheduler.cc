@@ -0,0 +1,254 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file scheduler.cc
+/// This file defines the methods of `Scheduler`.
+///
+/// A worker keeps running the same task for slice after slice while nothing
+/// else is waiting in its queue, so that a worker with a single task never
+/// touches the queues. Workers with nothing to do sleep on `work_ready_`, and
+/// are only woken when a task is queued while some of them are asleep.
+//
+//===-----------------------------------------------------------------------===//
+
+#include "tam/scheduler.h"
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "tam/io.h"
+#include "tam/program.h"
+#include "tam/tam.h"
+
+namespace tam {
+
+struct Scheduler::Task {
+    Task(std::unique_ptr<ChannelInput> channel,
+         std::unique_ptr<OutputSink> output, Callback callback)
+        : input(channel.get()),
+          emulator(std::move(channel), std::move(output)),
+          done(std::move(callback)) {}
+
+    ChannelInput* input;  ///< Owned by `emulator`, only used by workers
+    TamEmulator emulator;
+    Callback done;
+    TaskId id = 0;
+    uint64_t steps = 0;  ///< Instructions executed so far
+
+    // guarded by `Scheduler::mutex_`
+    std::string pending;   ///< Input supplied but not yet passed to `input`
+    bool closing = false;  ///< Whether `CloseInput` has been called
+    bool parked = false;   ///< Whether the task is waiting for input
+};
+
+Scheduler::Scheduler(const SchedulerOptions& options)
+    : options_(options), queues_(std::max(options.threads, 1)) {
+    for (size_t I = 0; I < this->queues_.size(); ++I)
+        this->workers_.emplace_back(&Scheduler::Work, this, I);
+}
+
+Scheduler::~Scheduler() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->stopping_ = true;
+    }
+    this->work_ready_.notify_all();
+    for (std::thread& worker : this->workers_) worker.join();
+}
+
+Scheduler::TaskId Scheduler::Submit(std::shared_ptr<const TamProgram> program,
+                                    std::unique_ptr<OutputSink> output,
+                                    Callback done) {
+    auto task = std::make_unique<Task>(std::make_unique<ChannelInput>(),
+                                       std::move(output), std::move(done));
+    task->emulator.LoadProgram(std::move(program));
+    if (this->options_.jit) task->emulator.EnableJit();
+
+    Task* runnable = task.get();
+    TaskId id;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        id = this->next_id_++;
+        task->id = id;
+        this->tasks_.emplace(id, std::move(task));
+        ++this->runnable_;
+    }
+    this->Enqueue(runnable, id % this->queues_.size());
+    return id;
+}
+
+bool Scheduler::Feed(TaskId id, const char* data, size_t size) {
+    Task* wake = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        auto it = this->tasks_.find(id);
+        if (it == this->tasks_.end()) return false;
+
+        Task* task = it->second.get();
+        task->pending.append(data, size);
+        if (task->parked) {
+            task->parked = false;
+            ++this->runnable_;
+            wake = task;
+        }
+    }
+    if (wake) this->Enqueue(wake, id % this->queues_.size());
+    return true;
+}
+
+bool Scheduler::CloseInput(TaskId id) {
+    Task* wake = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        auto it = this->tasks_.find(id);
+        if (it == this->tasks_.end()) return false;
+
+        Task* task = it->second.get();
+        task->closing = true;
+        if (task->parked) {
+            task->parked = false;
+            ++this->runnable_;
+            wake = task;
+        }
+    }
+    if (wake) this->Enqueue(wake, id % this->queues_.size());
+    return true;
+}
+
+void Scheduler::WaitIdle() {
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    this->idle_.wait(lock, [this] { return this->runnable_ == 0; });
+}
+
+size_t Scheduler::TaskCount() {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    return this->tasks_.size();
+}
+
+// A sleeping worker increments `sleeping_` before checking `queued_`, and this
+// increments `queued_` before checking `sleeping_`, so at least one of them
+// sees the other and the task cannot be missed.
+void Scheduler::Enqueue(Task* task, size_t queue) {
+    {
+        std::lock_guard<std::mutex> lock(this->queues_[queue].mutex);
+        this->queues_[queue].tasks.push_back(task);
+    }
+    ++this->queued_;
+
+    if (this->sleeping_ > 0) {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->work_ready_.notify_one();
+    }
+}
+
+Scheduler::Task* Scheduler::Dequeue(size_t self) {
+    const size_t count = this->queues_.size();
+    while (!this->stopping_) {
+        // the worker's own queue first, then steal the newest task of another
+        for (size_t I = 0; I < count; ++I) {
+            Queue& queue = this->queues_[(self + I) % count];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+
+            Task* task;
+            if (I == 0) {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+            } else {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+            }
+            --this->queued_;
+            return task;
+        }
+
+        std::unique_lock<std::mutex> lock(this->mutex_);
+        ++this->sleeping_;
+        this->work_ready_.wait(
+            lock, [this] { return this->queued_ > 0 || this->stopping_; });
+        --this->sleeping_;
+    }
+    return nullptr;
+}
+
+bool Scheduler::RunSlice(Task* task) {
+    RunResult result = task->emulator.Run(this->options_.quantum);
+    task->steps += result.steps;
+
+    switch (result.reason) {
+        case StopReason::kBudgetExhausted:
+            return true;
+
+        case StopReason::kInputBlocked: {
+            std::lock_guard<std::mutex> lock(this->mutex_);
+            if (task->pending.empty() && !task->closing) {
+                task->parked = true;
+                if (--this->runnable_ == 0) this->idle_.notify_all();
+                return false;
+            }
+
+            task->input->Feed(task->pending.data(), task->pending.size());
+            task->pending.clear();
+            if (task->closing) task->input->Close();
+            return true;
+        }
+
+        default:
+            break;
+    }
+
+    result.steps = task->steps;
+    if (task->done) task->done(task->id, task->emulator, result);
+
+    std::unique_ptr<Task> finished;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        auto it = this->tasks_.find(task->id);
+        finished = std::move(it->second);
+        this->tasks_.erase(it);
+        if (--this->runnable_ == 0) this->idle_.notify_all();
+    }
+    return false;
+}
+
+void Scheduler::Work(size_t self) {
+    Queue& own = this->queues_[self];
+    Task* task = nullptr;
+    while (!this->stopping_) {
+        if (!task && !(task = this->Dequeue(self))) return;
+        if (!this->RunSlice(task)) {
+            task = nullptr;
+            continue;
+        }
+
+        // give the other tasks in this worker's queue a turn first
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            own.tasks.push_back(task);
+            task = own.tasks.front();
+            own.tasks.pop_front();
+        }
+    }
+}
+
+}  // namespace tam
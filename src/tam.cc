@@ -18,7 +18,7 @@
 //
 /// @file tam.cc
 /// This file defines all methods of `TamEmulator` except for `Allocate`,
-/// `Free`, and the methods for executing primitive operations.
+/// `Free`, `Run`, and the methods for executing primitive operations.
 //
 //===-----------------------------------------------------------------------===//
 
@@ -31,44 +31,116 @@
 #include <algorithm>
 #include <iomanip>
 #include <sstream>
-#include <stack>
+#include <utility>
 #include <vector>
 
 #include "tam/error.h"
+#include "tam/heap.h"
+#include "tam/io.h"
+#include "tam/jit.h"
+#include "tam/program.h"
 
 namespace tam {
 
-TamEmulator::TamEmulator(FILE* instream, FILE* outstream) {
-    if (!(instream && outstream)) {
+// If either file is NULL then neither is wrapped, so that the other constructor
+// throws without closing anything.
+TamEmulator::TamEmulator(FILE* instream, FILE* outstream)
+    : TamEmulator(
+          instream && outstream
+              ? std::make_unique<StdioInput>(instream, instream != stdin)
+              : nullptr,
+          instream && outstream
+              ? std::make_unique<StdioOutput>(outstream, outstream != stdout)
+              : nullptr) {}
+
+TamEmulator::TamEmulator(std::unique_ptr<InputSource> input,
+                         std::unique_ptr<OutputSink> output) {
+    if (!(input && output)) {
         throw IoError("NULL passed for input or output");
     }
-    this->instream_ = instream;
-    this->outstream_ = outstream;
+    this->input_ = std::move(input);
+    this->output_ = std::move(output);
 
-    this->code_store_.fill(0);
-    this->data_store_.fill(0);
+    // data memory starts out zeroed
+    this->program_ = TamProgram::Empty();
     this->registers_.fill(0);
 
     this->registers_[HB] = kMaxAddr;
     this->registers_[HT] = kMaxAddr;
+
+    this->heap_allocator_ = std::make_unique<BestFitAllocator>();
 }
 
-void TamEmulator::LoadProgram(const std::vector<TamCode>& program) {
-    if (program.size() > kMemSize) throw IoError("program file too large");
+TamEmulator::~TamEmulator() { this->output_->Flush(); }
+
+void TamEmulator::Reset() {
+    // nothing can have been written between the highest word the stack has
+    // reached and the lowest word the heap has reached
+    const int stack_end = std::min(this->stack_used_, kMemSize);
+    const int heap_begin = std::max(
+        std::min(this->heap_low_, this->registers_[HT]) + 1, stack_end);
+    std::fill_n(this->data_store_.begin(), stack_end, 0);
+    std::fill(this->data_store_.begin() + heap_begin, this->data_store_.end(),
+              0);
+    this->stack_used_ = 0;
+    this->heap_low_ = kMaxAddr;
+
+    const TamAddr ct = this->registers_[CT], pb = this->registers_[PB],
+                  pt = this->registers_[PT];
+    this->registers_.fill(0);
+    this->registers_[CT] = ct;
+    this->registers_[PB] = pb;
+    this->registers_[PT] = pt;
+    this->registers_[HB] = kMaxAddr;
+    this->registers_[HT] = kMaxAddr;
+
+    this->allocated_blocks_.clear();
+    this->heap_allocator_->Clear();
+    this->flight_count_ = 0;
+}
 
-    this->code_store_.fill(0);
-    std::copy(program.begin(), program.end(), this->code_store_.begin());
-    this->registers_[CT] = program.size();
-    this->registers_[PB] = program.size();
+void TamEmulator::Reset(std::unique_ptr<InputSource> input,
+                        std::unique_ptr<OutputSink> output) {
+    if (!(input && output)) {
+        throw IoError("NULL passed for input or output");
+    }
+    this->output_->Flush();
+    this->input_ = std::move(input);
+    this->output_ = std::move(output);
+
+    this->Reset();
+}
+
+void TamEmulator::LoadProgram(std::shared_ptr<const TamProgram> program) {
+    const TamAddr size = program->size();
+    this->program_ = std::move(program);
+    this->registers_[CT] = size;
+    this->registers_[PB] = size;
     this->registers_[PT] = this->registers_[PB] + 29;
 }
 
+void TamEmulator::LoadProgram(const std::vector<TamCode>& program) {
+    this->LoadProgram(TamProgram::FromCode(program));
+}
+
+void TamEmulator::LoadProgram(const TamCode* program, size_t size) {
+    this->LoadProgram(TamProgram::FromCode(program, size));
+}
+
+const std::vector<Fusion>& TamEmulator::GetFusions() const {
+    return this->program_->fusions();
+}
+
 TamInstruction TamEmulator::FetchDecode() {
     TamAddr addr = this->registers_[CP]++;
     if (addr >= this->registers_[CT])
         throw RuntimeError(ExceptionKind::kCodeAccessViolation, addr);
 
-    TamCode code = this->code_store_[addr];
+    assert(addr < this->program_->size());
+    return this->program_->decoded()[addr].instr;
+}
+
+TamInstruction DecodeInstruction(TamCode code) {
     uint8_t op = (code & 0xf0000000) >> 28;
     assert(op <= 0xf);
     uint8_t r = (code & 0x0f000000) >> 24;
@@ -86,8 +158,10 @@ void TamEmulator::PushData(TamData value) {
                            this->registers_[CP] - 1);
 
     this->data_store_[addr] = value;
+    this->NoteWrites(addr, addr + 1);
     this->registers_[ST]++;
     assert(this->data_store_[addr] == value);
+    this->stack_used_ = std::max<int>(this->stack_used_, addr + 1);
 }
 
 TamData TamEmulator::PopData() {
@@ -100,7 +174,118 @@ TamData TamEmulator::PopData() {
     return this->data_store_[this->registers_[ST]];
 }
 
+TamAddr TamEmulator::PopBlock(int n) {
+    if (this->registers_[ST] < n)
+        throw RuntimeError(ExceptionKind::kStackUnderflow,
+                           this->registers_[CP] - 1);
+
+    this->registers_[ST] -= n;
+    return this->registers_[ST];
+}
+
+void TamEmulator::PushBlock(TamAddr src, int n) {
+    if (this->registers_[ST] + n > this->registers_[HT])
+        throw RuntimeError(ExceptionKind::kStackOverflow,
+                           this->registers_[CP] - 1);
+
+    assert(src >= this->registers_[ST]);
+    this->MoveData(this->registers_[ST], src, n);
+    this->registers_[ST] += n;
+    this->stack_used_ = std::max<int>(this->stack_used_, this->registers_[ST]);
+}
+
+/// Loading word `I` checks its address against `ST + I`, so only the first
+/// word can lie between the stack and the heap: the remaining words either
+/// follow it or wrap round to the bottom of memory.
+void TamEmulator::LoadBlock(TamAddr src, int n) {
+    if (n == 0) return;
+
+    const TamAddr st = this->registers_[ST];
+    if (src >= st && src <= this->registers_[HT])
+        throw RuntimeError(ExceptionKind::kDataAccessViolation,
+                           this->registers_[CP] - 1);
+    if (st + n > this->registers_[HT])
+        throw RuntimeError(ExceptionKind::kStackOverflow,
+                           this->registers_[CP] - 1);
+
+    this->MoveData(st, src, n);
+    this->registers_[ST] += n;
+    this->stack_used_ = std::max<int>(this->stack_used_, this->registers_[ST]);
+}
+
+void TamEmulator::MarkWritten(TamAddr addr) {
+    this->NoteWrites(addr, addr + 1);
+    if (addr < this->stack_used_ || addr > this->heap_low_) return;
+
+    // extend whichever of the regions cleared by `Reset` is nearer
+    if (addr - this->stack_used_ <= this->heap_low_ - addr) {
+        this->stack_used_ = addr + 1;
+    } else {
+        this->heap_low_ = addr - 1;
+    }
+}
+
+void TamEmulator::CheckDataAccess(TamAddr addr, int n) const {
+    const int st = this->registers_[ST], ht = this->registers_[HT];
+
+    // the block may wrap round to the bottom of memory
+    const int end = addr + n;
+    bool violation = n > 0 && addr <= ht && std::min(end, kMemSize) > st;
+    if (end > kMemSize) violation |= st < end - kMemSize;
+
+    if (violation)
+        throw RuntimeError(ExceptionKind::kDataAccessViolation,
+                           this->registers_[CP] - 1);
+}
+
+/// Blocks that neither wrap round memory nor overlap with a lower source are
+/// copied at once. Otherwise words are copied one at a time in ascending
+/// order, so a destination just above its source repeats the first words.
+void TamEmulator::MoveData(TamAddr dest, TamAddr src, int n) {
+    if (dest == src || n == 0) return;
+
+    // a block that wraps round could have written anywhere
+    if (dest + n <= kMemSize) {
+        this->NoteWrites(dest, dest + n);
+    } else {
+        this->NoteWrites(0, kMemSize);
+    }
+
+    if (dest + n <= kMemSize && src + n <= kMemSize &&
+        (dest < src || dest >= src + n)) {
+        std::copy_n(this->data_store_.begin() + src, n,
+                    this->data_store_.begin() + dest);
+        return;
+    }
+
+    for (int I = 0; I < n; ++I)
+        this->data_store_[TamAddr(dest + I)] =
+            this->data_store_[TamAddr(src + I)];
+}
+
+void TamEmulator::EnableStats(bool enabled) {
+    if (enabled) this->stats_ = ExecutionStats();
+    this->stats_enabled_ = enabled;
+}
+
+void TamEmulator::SetCallListener(CallListener* listener) {
+    this->call_listener_ = listener;
+}
+
+void TamEmulator::SetHeapListener(HeapListener* listener) {
+    this->heap_listener_ = listener;
+}
+
 bool TamEmulator::Execute(TamInstruction instr) {
+    [[maybe_unused]] const TamAddr addr = this->registers_[CP] - 1;
+    this->written_begin_ = kMemSize;
+    this->written_end_ = 0;
+    if (this->stats_enabled_)
+        this->CountInstruction(instr, this->registers_[ST],
+                               this->registers_[HT]);
+    if (this->call_listener_ || this->heap_listener_)
+        ++this->listener_steps_;
+
     switch (instr.op) {
         case LOAD:
             this->ExecuteLoad(instr);
@@ -154,28 +339,104 @@ bool TamEmulator::Execute(TamInstruction instr) {
             throw RuntimeError(ExceptionKind::kUnknownOpcode,
                                this->registers_[CP] - 1);
     }
+
+#if TAM_FLIGHT_RECORDER
+    // any instruction but the next was reached by a transfer of control
+    if (this->registers_[CP] != TamAddr(addr + 1))
+        this->RecordTransfer(addr, this->registers_[CP], this->registers_[ST],
+                             this->registers_[LB], this->registers_[HT]);
+#endif
     return true;
 }
 
 const std::string TamEmulator::GetSnapshot() const {
+    return FormatSnapshot(this->data_store_.data(), this->registers_[ST],
+                          this->allocated_blocks_);
+}
+
+/// Instructions are recovered newest first: those since the newest transfer,
+/// then those between it and the transfer before, and so on.
+std::string TamEmulator::GetPostMortem(size_t max_instructions) const {
+    const std::vector<TamCode>& code = this->program_->code();
+
+    // each line is an address, and the transfer that reached it if any
+    std::vector<std::pair<TamAddr, const FlightRecord*>> lines;
+    const size_t records = std::min<uint64_t>(this->flight_count_,
+                                              kFlightRecords);
+#if TAM_FLIGHT_RECORDER
+    // execution starts from 0 after a reset, so it was sequential before the
+    // oldest transfer unless older ones have been overwritten
+    const bool from_reset = this->flight_count_ <= kFlightRecords;
+#else
+    const bool from_reset = false;
+#endif
+    int end = int(this->registers_[CP]) - 1;
+    bool truncated = false;
+    for (size_t I = 0; I <= records && lines.size() < max_instructions;
+         ++I) {
+        const FlightRecord* record =
+            I < records
+                ? &this->flight_records_[(this->flight_count_ - 1 - I) &
+                                         (kFlightRecords - 1)]
+                : nullptr;
+        // without a record of how `end` was reached, list it alone
+        int start = record ? record->to : from_reset ? 0 : end;
+        if (start > end || end < 0) break;
+
+        for (int addr = end; addr >= start && lines.size() < max_instructions;
+             --addr)
+            lines.emplace_back(addr, addr == start ? record : nullptr);
+        if (!record) {
+            truncated = !from_reset && lines.size() < max_instructions;
+            break;
+        }
+        end = record->from;
+    }
+
+    std::stringstream ss;
+    ss << "Last instructions executed" << std::endl
+       << "        ST   LB   HT" << std::endl;
+    if (truncated)
+        ss << "(earlier instructions were not recorded)" << std::endl;
+    char line[96];
+    for (auto it = lines.rbegin(); it != lines.rend(); ++it) {
+        const auto& [addr, record] = *it;
+        std::string mnemonic =
+            addr < code.size() ? GetMnemonic(DecodeInstruction(code[addr]))
+                               : "?";
+        if (record) {
+            snprintf(line, sizeof(line), "%04x:   %04x %04x %04x  %s\n", addr,
+                     record->st, record->lb, record->ht, mnemonic.c_str());
+        } else {
+            snprintf(line, sizeof(line), "%04x:                   %s\n", addr,
+                     mnemonic.c_str());
+        }
+        ss << line;
+    }
+    ss << std::endl << this->GetSnapshot();
+    return ss.str();
+}
+
+std::string FormatSnapshot(const TamData* data, TamAddr st,
+                           const std::map<TamAddr, int>& blocks) {
     std::stringstream ss;
 
     ss << std::hex << std::setfill('0');
 
     ss << "Stack";
-    for (int I = 0; I < this->registers_[ST]; ++I) {
+    for (int I = 0; I < st; ++I) {
         if (I % 8 == 0) ss << std::endl;
-        ss << std::setw(4) << this->data_store_[I] << " ";
+        ss << std::setw(4) << data[I] << " ";
     }
     ss << std::endl;
 
-    for (auto Block : this->allocated_blocks_) {
+    for (auto Block : blocks) {
         ss << "Heap " << std::setw(4) << Block.first;
         for (int I = 0; I < Block.second; ++I) {
             if (I % 8 == 0) {
                 ss << std::endl;
             }
-            ss << std::setw(4) << this->data_store_[Block.first + I] << " ";
+            ss << std::setw(4) << data[Block.first + I] << " ";
         }
     }
 
@@ -184,16 +445,7 @@ const std::string TamEmulator::GetSnapshot() const {
 
 void TamEmulator::ExecuteLoad(TamInstruction instr) {
     TamAddr base_addr = this->registers_[instr.r] + instr.d;
-
-    for (int I = 0; I < instr.n; ++I) {
-        TamAddr addr = base_addr + I;
-        if (addr >= this->registers_[ST] && addr <= this->registers_[HT])
-            throw RuntimeError(ExceptionKind::kDataAccessViolation,
-                               this->registers_[CP] - 1);
-
-        TamData value = this->data_store_[addr];
-        this->PushData(value);
-    }
+    this->LoadBlock(base_addr, instr.n);
 }
 
 void TamEmulator::ExecuteLoada(TamInstruction instr) {
@@ -203,16 +455,7 @@ void TamEmulator::ExecuteLoada(TamInstruction instr) {
 
 void TamEmulator::ExecuteLoadi(TamInstruction instr) {
     TamAddr base_addr = this->PopData();
-
-    for (int I = 0; I < instr.n; ++I) {
-        TamAddr addr = base_addr + I;
-        if (addr >= this->registers_[ST] && addr <= this->registers_[HT])
-            throw RuntimeError(ExceptionKind::kDataAccessViolation,
-                               this->registers_[CP] - 1);
-
-        TamData value = this->data_store_[addr];
-        this->PushData(value);
-    }
+    this->LoadBlock(base_addr, instr.n);
 }
 
 void TamEmulator::ExecuteLoadl(TamInstruction instr) {
@@ -220,40 +463,17 @@ void TamEmulator::ExecuteLoadl(TamInstruction instr) {
 }
 
 void TamEmulator::ExecuteStore(TamInstruction instr) {
-    std::stack<TamData> Data;
-    for (int I = 0; I < instr.n; ++I) Data.push(this->PopData());
-
+    TamAddr src_addr = this->PopBlock(instr.n);
     TamAddr base_addr = this->registers_[instr.r] + instr.d;
-    for (int I = 0; I < instr.n; ++I) {
-        TamAddr addr = base_addr + I;
-        if (addr >= this->registers_[ST] && addr <= this->registers_[HT])
-            throw RuntimeError(ExceptionKind::kDataAccessViolation,
-                               this->registers_[CP] - 1);
-
-        this->data_store_[addr] = Data.top();
-        Data.pop();
-    }
-
-    assert(Data.empty());
+    this->CheckDataAccess(base_addr, instr.n);
+    this->MoveData(base_addr, src_addr, instr.n);
 }
 
 void TamEmulator::ExecuteStorei(TamInstruction instr) {
     TamAddr base_addr = this->PopData();
-
-    std::stack<TamData> Data;
-    for (int I = 0; I < instr.n; ++I) Data.push(this->PopData());
-
-    for (int I = 0; I < instr.n; ++I) {
-        TamAddr addr = base_addr + I;
-        if (addr >= this->registers_[ST] && addr <= this->registers_[HT])
-            throw RuntimeError(ExceptionKind::kDataAccessViolation,
-                               this->registers_[CP] - 1);
-
-        this->data_store_[addr] = Data.top();
-        Data.pop();
-    }
-
-    assert(Data.empty());
+    TamAddr src_addr = this->PopBlock(instr.n);
+    this->CheckDataAccess(base_addr, instr.n);
+    this->MoveData(base_addr, src_addr, instr.n);
 }
 
 void TamEmulator::ExecuteCall(TamInstruction instr) {
@@ -274,6 +494,9 @@ void TamEmulator::ExecuteCall(TamInstruction instr) {
 
     this->registers_[LB] = this->registers_[ST] - 3;
     this->registers_[CP] = this->registers_[instr.r] + instr.d;
+    if (this->call_listener_)
+        this->call_listener_->OnCall(return_addr - 1, this->registers_[CP],
+                                     this->listener_steps_);
 }
 
 void TamEmulator::ExecuteCalli(TamInstruction instr) {
@@ -296,40 +519,34 @@ void TamEmulator::ExecuteCalli(TamInstruction instr) {
 
     this->registers_[LB] = this->registers_[ST] - 3;
     this->registers_[CP] = call_address;
+    if (this->call_listener_)
+        this->call_listener_->OnCall(return_addr - 1, call_address,
+                                     this->listener_steps_);
 }
 
 void TamEmulator::ExecuteReturn(TamInstruction instr) {
-    std::stack<TamData> return_val;
-    for (int I = 0; I < instr.n; ++I) return_val.push(this->PopData());
-
-    assert(return_val.size() == instr.n);
+    const TamAddr site = this->registers_[CP] - 1;
+    TamAddr result_addr = this->PopBlock(instr.n);
 
-    TamAddr dynamic_link = this->data_store_[this->registers_[LB] + 1];
-    TamAddr return_addr = this->data_store_[this->registers_[LB] + 2];
+    const TamAddr lb = this->registers_[LB];
+    TamAddr dynamic_link = this->data_store_[TamAddr(lb + 1)];
+    TamAddr return_addr = this->data_store_[TamAddr(lb + 2)];
     if (return_addr >= this->registers_[CT])
         throw RuntimeError(ExceptionKind::kCodeAccessViolation,
                            this->registers_[CP] - 1);
 
-    // pop stack frame
-    while (this->registers_[ST] > this->registers_[LB]) this->PopData();
-    assert(this->registers_[ST] == this->registers_[LB]);
-
-    // pop arguments
-    for (int I = 0; I < instr.d; ++I) this->PopData();
-    assert(this->registers_[ST] == this->registers_[LB] - instr.d);
-
-    // push result
-    for (int I = 0; I < instr.n; ++I) {
-        assert(!return_val.empty());
-        this->PushData(return_val.top());
-        return_val.pop();
-    }
-    assert(return_val.empty());
+    // pop stack frame and arguments, then push result
+    if (this->registers_[ST] > this->registers_[LB])
+        this->registers_[ST] = this->registers_[LB];
+    this->PopBlock(instr.d);
+    this->PushBlock(result_addr, instr.n);
 
     this->registers_[LB] = dynamic_link;
     assert(this->registers_[LB] == dynamic_link);
     this->registers_[CP] = return_addr;
     assert(this->registers_[CP] == return_addr);
+    if (this->call_listener_)
+        this->call_listener_->OnReturn(site, this->listener_steps_);
 }
 
 void TamEmulator::ExecutePush(TamInstruction instr) {
@@ -341,17 +558,9 @@ void TamEmulator::ExecutePush(TamInstruction instr) {
 }
 
 void TamEmulator::ExecutePop(TamInstruction instr) {
-    std::stack<TamData> data;
-    for (int i = 0; i < instr.n; ++i) data.push(this->PopData());
-
-    for (int i = 0; i < instr.d; ++i) this->PopData();
-
-    while (!data.empty()) {
-        this->PushData(data.top());
-        data.pop();
-    }
-
-    assert(data.empty());
+    TamAddr result_addr = this->PopBlock(instr.n);
+    this->PopBlock(instr.d);
+    this->PushBlock(result_addr, instr.n);
 }
 
 void TamEmulator::ExecuteJump(TamInstruction instr) {
@@ -0,0 +1,276 @@
+//===-----------------------------------------------------------------------===//
+//
+// This file is part of tam-cpp, copyright (c) Ian Knight 2025.
+//
+// tam-cpp is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// tam-cpp is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with tam-cpp. If not, see <https://www.gnu.org/licenses/>.
+//
+//===-----------------------------------------------------------------------===//
+//
+/// @file trace.cc
+/// This file defines the methods of `TraceWriter` and `TraceReader`.
+///
+/// The writer keeps a copy of the registers, words and heap blocks as they
+/// were last recorded and compares the emulator against it after each
+/// instruction. After the first instruction, it only compares the words that
+/// the emulator reports the instruction wrote, so each tick costs time in
+/// proportion to the words written rather than to the memory in use. The
+/// reader applies the same changes to its own copy.
+//
+//===-----------------------------------------------------------------------===//
+
+#include "tam/trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "tam/error.h"
+#include "tam/io.h"
+#include "tam/program.h"
+#include "tam/tam.h"
+
+namespace tam {
+
+/// Size of the buffers through which traces are written and read.
+constexpr size_t kTraceBufferSize = 1 << 20;
+
+TraceWriter::TraceWriter(FILE* file, const TamEmulator& emulator, int level)
+    : emulator_(emulator),
+      level_(std::clamp(level, 1, 3)),
+      out_(file, true, kTraceBufferSize) {
+    const std::vector<TamCode>& code = emulator.GetProgram()->code();
+
+    this->tick_.assign(kTraceMagic, kTraceMagic + sizeof(kTraceMagic));
+    this->tick_.push_back(kTraceVersion);
+    this->tick_.push_back(this->level_);
+    this->Put16(code.size() & 0xffff);
+    this->Put16(code.size() >> 16);
+    for (TamCode word : code) {
+        this->Put16(word & 0xffff);
+        this->Put16(word >> 16);
+    }
+    for (int I = 0; I < 16; ++I) {
+        this->registers_[I] = emulator.RegisterValue(TamRegister(I));
+        this->Put16(this->registers_[I]);
+    }
+    this->out_.Write(reinterpret_cast<const char*>(this->tick_.data()),
+                     this->tick_.size());
+}
+
+void TraceWriter::Record(TamInstruction instr) {
+    this->tick_.clear();
+    this->tick_.push_back(instr.op & 0xf);
+
+    uint16_t mask = 0;
+    for (int I = 0; I < 16; ++I)
+        if (this->emulator_.RegisterValue(TamRegister(I)) !=
+            this->registers_[I])
+            mask |= 1 << I;
+    if (mask) {
+        this->tick_[0] |= kTraceRegisters;
+        this->Put16(mask);
+        for (int I = 0; I < 16; ++I) {
+            if (!(mask & (1 << I))) continue;
+            this->registers_[I] = this->emulator_.RegisterValue(TamRegister(I));
+            this->Put16(this->registers_[I]);
+        }
+    }
+
+    if (this->level_ >= 3) {
+        // the number of runs is filled in once they have been found
+        const size_t count_at = this->tick_.size();
+        this->Put16(0);
+        uint16_t runs;
+        if (this->check_words_) {
+            // memory need not have been zero when tracing began
+            runs = this->PutWrites(0, this->registers_[ST]) +
+                   this->PutWrites(this->registers_[HT] + 1, kMemSize);
+            this->check_words_ = false;
+        } else {
+            const auto [begin, end] = this->emulator_.GetLastWrites();
+            runs = this->PutWrites(begin, end);
+        }
+        if (runs) {
+            this->tick_[0] |= kTraceWrites;
+            this->tick_[count_at] = runs & 0xff;
+            this->tick_[count_at + 1] = runs >> 8;
+        } else {
+            this->tick_.resize(count_at);
+        }
+
+        // only `new` and `dispose` change the blocks once tracing has begun
+        const std::map<TamAddr, int>& blocks =
+            this->emulator_.GetAllocatedBlocks();
+        const bool check = this->check_blocks_ ||
+                           (instr.op == CALL && instr.r == PB &&
+                            (instr.d == 27 || instr.d == 28));
+        this->check_blocks_ = false;
+        if (check && blocks != this->blocks_) {
+            this->blocks_ = blocks;
+            this->tick_[0] |= kTraceBlocks;
+            this->Put16(blocks.size());
+            for (const auto& [addr, size] : blocks) {
+                this->Put16(addr);
+                this->Put16(size);
+            }
+        }
+    }
+
+    this->out_.Write(reinterpret_cast<const char*>(this->tick_.data()),
+                     this->tick_.size());
+}
+
+bool TraceWriter::Flush() {
+    this->out_.Flush();
+    return !this->out_.Failed();
+}
+
+void TraceWriter::Put16(uint16_t value) {
+    this->tick_.push_back(value & 0xff);
+    this->tick_.push_back(value >> 8);
+}
+
+uint16_t TraceWriter::PutWrites(int begin, int end) {
+    uint16_t runs = 0;
+    int I = begin;
+    while (I < end) {
+        if (this->emulator_.DataValue(I) == this->shadow_[I]) {
+            ++I;
+            continue;
+        }
+
+        const int start = I;
+        const int limit = std::min(end, start + 0xffff);
+        while (I < limit && this->emulator_.DataValue(I) != this->shadow_[I])
+            ++I;
+        this->Put16(start);
+        this->Put16(I - start);
+        for (int J = start; J < I; ++J) {
+            this->shadow_[J] = this->emulator_.DataValue(J);
+            this->Put16(this->shadow_[J]);
+        }
+        ++runs;
+    }
+    return runs;
+}
+
+TraceReader::TraceReader(FILE* file)
+    : file_(file), buffer_(kTraceBufferSize) {
+    char magic[sizeof(kTraceMagic)];
+    uint8_t version_level[2];
+    if (!this->Read(magic, sizeof(magic)) ||
+        memcmp(magic, kTraceMagic, sizeof(magic)) != 0 ||
+        !this->Read(version_level, 2)) {
+        fclose(this->file_);
+        throw IoError("not a TAM trace");
+    }
+    if (version_level[0] != kTraceVersion) {
+        fclose(this->file_);
+        throw IoError("unsupported TAM trace version");
+    }
+    this->level_ = version_level[1];
+
+    try {
+        uint32_t size = this->Read16();
+        size |= uint32_t(this->Read16()) << 16;
+        if (size > kMemSize) throw IoError("corrupt TAM trace");
+        this->code_.resize(size);
+        for (TamCode& word : this->code_) {
+            word = this->Read16();
+            word |= TamCode(this->Read16()) << 16;
+        }
+        for (TamAddr& value : this->registers_) value = this->Read16();
+    } catch (...) {
+        fclose(this->file_);
+        throw;
+    }
+}
+
+TraceReader::~TraceReader() { fclose(this->file_); }
+
+bool TraceReader::Next() {
+    uint8_t tag;
+    if (!this->Read(&tag, 1)) return false;
+    this->addr_ = this->registers_[CP];
+    this->opcode_ = tag & 0xf;
+
+    if (tag & kTraceRegisters) {
+        uint16_t mask = this->Read16();
+        for (int I = 0; I < 16; ++I)
+            if (mask & (1 << I)) this->registers_[I] = this->Read16();
+    }
+
+    if (tag & kTraceWrites) {
+        uint16_t runs = this->Read16();
+        for (int I = 0; I < runs; ++I) {
+            TamAddr addr = this->Read16();
+            uint16_t length = this->Read16();
+            for (int J = 0; J < length; ++J)
+                this->data_[TamAddr(addr + J)] = this->Read16();
+        }
+    }
+
+    if (tag & kTraceBlocks) {
+        uint16_t count = this->Read16();
+        this->blocks_.clear();
+        for (int I = 0; I < count; ++I) {
+            TamAddr addr = this->Read16();
+            this->blocks_[addr] = this->Read16();
+        }
+    }
+    return true;
+}
+
+TamInstruction TraceReader::Instruction() const {
+    if (this->addr_ < this->code_.size())
+        return DecodeInstruction(this->code_[this->addr_]);
+    return TamInstruction{this->opcode_, 0, 0, 0};
+}
+
+std::string TraceReader::GetSnapshot() const {
+    return FormatSnapshot(this->data_.data(), this->registers_[ST],
+                          this->blocks_);
+}
+
+bool TraceReader::Read(void* dest, size_t size) {
+    uint8_t* out = static_cast<uint8_t*>(dest);
+    while (size) {
+        if (this->pos_ == this->end_) {
+            this->pos_ = 0;
+            this->end_ = fread(this->buffer_.data(), 1, this->buffer_.size(),
+                               this->file_);
+            if (!this->end_) return false;
+        }
+
+        size_t count = std::min(size, this->end_ - this->pos_);
+        memcpy(out, this->buffer_.data() + this->pos_, count);
+        this->pos_ += count;
+        out += count;
+        size -= count;
+    }
+    return true;
+}
+
+uint16_t TraceReader::Read16() {
+    uint8_t bytes[2];
+    if (!this->Read(bytes, 2)) throw IoError("TAM trace is truncated");
+    return bytes[0] | bytes[1] << 8;
+}
+
+}  // namespace tam
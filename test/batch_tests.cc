@@ -0,0 +1,122 @@
+#include <stdio.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "tam/batch.h"
+#include "tam/tam.h"
+
+#include <gtest/gtest.h>
+
+class BatchTest : public testing::Test {
+   protected:
+    /// Write a TAM binary containing the given code words.
+    ///
+    /// @return the name of the file
+    std::string WriteProgram(const std::string& name,
+                             const std::vector<tam::TamCode>& code) {
+        std::string bytes;
+        for (tam::TamCode word : code)
+            for (int shift = 24; shift >= 0; shift -= 8)
+                bytes.push_back(static_cast<char>(word >> shift));
+        return this->WriteFile(name, bytes);
+    }
+
+    /// Write a file in the temporary directory.
+    ///
+    /// @return the name of the file
+    std::string WriteFile(const std::string& name, const std::string& data) {
+        std::string filename = testing::TempDir() + name;
+        FILE* file = fopen(filename.c_str(), "wb");
+        EXPECT_TRUE(file);
+        fwrite(data.data(), 1, data.size(), file);
+        fclose(file);
+        return filename;
+    }
+
+    /// @return the contents of a file in the temporary directory
+    std::string ReadFile(const std::string& filename) {
+        std::string data;
+        FILE* file = fopen(filename.c_str(), "rb");
+        EXPECT_TRUE(file);
+        if (!file) return data;
+        for (int c; (c = getc(file)) != EOF;) data.push_back(c);
+        fclose(file);
+        return data;
+    }
+};
+
+TEST_F(BatchTest, ReadBatchFile) {
+    std::istringstream in(
+        "# comment\n"
+        "a.tam in.txt out.txt\n"
+        "\n"
+        "  b.tam\n"
+        "c.tam - out.txt\n");
+    std::vector<BatchJob> jobs = ReadBatchFile(in, "jobs.txt");
+    ASSERT_EQ(3, jobs.size());
+    EXPECT_EQ("a.tam", jobs[0].program);
+    EXPECT_EQ("in.txt", jobs[0].input);
+    EXPECT_EQ("out.txt", jobs[0].output);
+    EXPECT_EQ("b.tam", jobs[1].program);
+    EXPECT_EQ("", jobs[1].input);
+    EXPECT_EQ("", jobs[1].output);
+    EXPECT_EQ("", jobs[2].input);
+    EXPECT_EQ("out.txt", jobs[2].output);
+
+    std::istringstream bad("a.tam in.txt out.txt extra.txt\n");
+    EXPECT_THROW(ReadBatchFile(bad, "jobs.txt"), std::runtime_error);
+}
+
+TEST_F(BatchTest, RunBatch) {
+    // PUSH 1, LOADA 0[SB], CALL getint, LOAD(1) 0[SB],
+    // CALL succ, CALL putint, CALL puteol, HALT
+    std::string succ =
+        this->WriteProgram("batch_succ.tam", {0xa0000001, 0x14000000,
+                                              0x62000019, 0x04010000,
+                                              0x62000005, 0x6200001a,
+                                              0x62000018, 0xf0000000});
+    // LOADL 1, LOADL 0, CALL div, HALT
+    std::string div = this->WriteProgram(
+        "batch_div.tam", {0x30000001, 0x30000000, 0x6200000b, 0xf0000000});
+
+    std::vector<BatchJob> jobs;
+    std::vector<std::string> outputs;
+    for (int I = 0; I < 20; ++I) {
+        std::string n = std::to_string(I);
+        outputs.push_back(testing::TempDir() + "batch_out" + n + ".txt");
+        jobs.push_back(BatchJob{
+            succ, this->WriteFile("batch_in" + n + ".txt", n + "\n"),
+            outputs.back()});
+    }
+    jobs.push_back(BatchJob{div, "", ""});
+    jobs.push_back(BatchJob{testing::TempDir() + "batch_missing.tam", "", ""});
+    jobs.push_back(
+        BatchJob{succ, testing::TempDir() + "batch_missing.txt", ""});
+    jobs.push_back(BatchJob{testing::TempDir(), "", ""});
+
+    std::vector<BatchResult> results = RunBatch(jobs, 4);
+    ASSERT_EQ(jobs.size(), results.size());
+    for (int I = 0; I < 20; ++I) {
+        EXPECT_EQ(0, results[I].status) << results[I].error;
+        EXPECT_EQ(std::to_string(I + 1) + "\n", this->ReadFile(outputs[I]));
+    }
+    EXPECT_EQ(3, results[20].status);
+    EXPECT_NE(std::string::npos, results[20].error.find("divide"))
+        << results[20].error;
+    EXPECT_EQ(1, results[21].status);
+    EXPECT_EQ("error: io error: file '" + jobs[21].program + "' not found",
+              results[21].error);
+    EXPECT_EQ(1, results[22].status);
+    EXPECT_EQ(1, results[23].status);
+    EXPECT_NE(std::string::npos, results[23].error.find("not found"))
+        << results[23].error;
+
+    std::ostringstream summary;
+    PrintBatchSummary(summary, jobs, results, 0.5);
+    EXPECT_NE(std::string::npos,
+              summary.str().find("24 jobs, 4 failed, 500.000 ms"))
+        << summary.str();
+}
@@ -53,3 +53,94 @@ TEST(CliTests, ParseTraceStepOk) {
     ASSERT_TRUE(args->step);
     ASSERT_EQ("test.tam", args->filename);
 }
+
+TEST(CliTests, ParseStats) {
+    const char* argv1[] = {"--stats", "test.tam"};
+    auto args = ParseCli(2, argv1);
+    ASSERT_TRUE(args);
+    ASSERT_TRUE(args->stats);
+    ASSERT_EQ("test.tam", args->filename);
+
+    const char* argv2[] = {"--stats", "-t", "2", "test.tam"};
+    args = ParseCli(4, argv2);
+    ASSERT_TRUE(args);
+    ASSERT_TRUE(args->stats);
+    ASSERT_EQ(2, args->trace);
+
+    const char* argv3[] = {"--stats"};
+    ASSERT_FALSE(ParseCli(1, argv3));
+}
+
+TEST(CliTests, ParseProfile) {
+    const char* argv1[] = {"--profile", "out.txt", "test.tam"};
+    auto args = ParseCli(3, argv1);
+    ASSERT_TRUE(args);
+    ASSERT_EQ("out.txt", args->profile);
+    ASSERT_EQ("test.tam", args->filename);
+
+    const char* argv2[] = {"--stats", "--profile", "out.txt", "test.tam"};
+    args = ParseCli(4, argv2);
+    ASSERT_TRUE(args);
+    ASSERT_TRUE(args->stats);
+    ASSERT_EQ("out.txt", args->profile);
+
+    const char* argv3[] = {"--profile", "out.txt"};
+    ASSERT_FALSE(ParseCli(2, argv3));
+
+    const char* argv4[] = {"--callgraph", "calls.txt", "-t", "test.tam"};
+    args = ParseCli(4, argv4);
+    ASSERT_TRUE(args);
+    ASSERT_EQ("calls.txt", args->call_graph);
+    ASSERT_EQ(1, args->trace);
+
+    const char* argv6[] = {"--heap-profile", "heap.txt", "test.tam"};
+    args = ParseCli(3, argv6);
+    ASSERT_TRUE(args);
+    ASSERT_EQ("heap.txt", args->heap_profile);
+    ASSERT_EQ("test.tam", args->filename);
+
+    const char* argv5[] = {"--trace-file", "trace.bin", "-t", "2",
+                           "test.tam"};
+    args = ParseCli(5, argv5);
+    ASSERT_TRUE(args);
+    ASSERT_EQ("trace.bin", args->trace_file);
+    ASSERT_EQ(2, args->trace);
+    ASSERT_EQ("test.tam", args->filename);
+}
+
+TEST(CliTests, ParseBatchOk) {
+    const char* argv[] = {"--batch", "jobs.txt"};
+    std::optional<CliArgs> args = ParseCli(2, argv);
+    ASSERT_TRUE(args);
+    ASSERT_FALSE(args->help || args->trace || args->step || args->filename);
+    ASSERT_EQ("jobs.txt", args->batch);
+    ASSERT_EQ(0, args->jobs);
+}
+
+TEST(CliTests, ParseBatchWithJobs) {
+    const char* argv1[] = {"--batch", "jobs.txt", "-j", "4"};
+    std::optional<CliArgs> args = ParseCli(4, argv1);
+    ASSERT_TRUE(args);
+    ASSERT_EQ("jobs.txt", args->batch);
+    ASSERT_EQ(4, args->jobs);
+
+    const char* argv2[] = {"--jobs", "2", "--batch", "jobs.txt"};
+    args = ParseCli(4, argv2);
+    ASSERT_TRUE(args);
+    ASSERT_EQ("jobs.txt", args->batch);
+    ASSERT_EQ(2, args->jobs);
+}
+
+TEST(CliTests, ParseBatchFail) {
+    const char* argv1[] = {"--batch"};
+    ASSERT_FALSE(ParseCli(1, argv1));
+
+    const char* argv2[] = {"--batch", "jobs.txt", "-j"};
+    ASSERT_FALSE(ParseCli(3, argv2));
+
+    const char* argv3[] = {"--batch", "jobs.txt", "-j", "0"};
+    ASSERT_FALSE(ParseCli(4, argv3));
+
+    const char* argv4[] = {"--batch", "jobs.txt", "test.tam"};
+    ASSERT_FALSE(ParseCli(3, argv4));
+}
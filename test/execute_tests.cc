@@ -181,3 +181,58 @@ TEST_F(EmulatorTest, TestJumpifCmpFailOk) {
     EXPECT_EQ(3, this->registers_[tam::ST]);
     EXPECT_EQ(0, this->registers_[tam::CP]);
 }
+
+TEST_F(EmulatorTest, TestLoadOverlappingStackTop) {
+    std::vector<tam::TamData> data = {1, 2, 3};
+    this->setData(data);
+
+    // each word is read after the word below it has been pushed
+    tam::TamInstruction instr = {0, tam::SB, 3, 2};
+    ASSERT_NO_THROW({ this->Execute(instr); });
+
+    EXPECT_EQ(6, this->registers_[tam::ST]);
+    EXPECT_EQ(3, this->data_store_[3]);
+    EXPECT_EQ(3, this->data_store_[4]);
+    EXPECT_EQ(3, this->data_store_[5]);
+}
+
+TEST_F(EmulatorTest, TestStoreAccessViolationWritesNothing) {
+    std::vector<tam::TamData> data = {1, 2, 3, 10, 20};
+    this->setData(data);
+
+    // STORE(2) 2[SB]: the second word would land at the new top of stack
+    tam::TamInstruction instr = {4, tam::SB, 2, 2};
+    EXPECT_THROW({ this->Execute(instr); }, std::runtime_error);
+    EXPECT_EQ(3, this->data_store_[2]);
+}
+
+TEST_F(EmulatorTest, TestReturnMultipleWords) {
+    // arg, static link, dynamic link, return address, local, result x3
+    std::vector<tam::TamData> data = {9, 0, 0, 1, 7, 4, 5, 6};
+    this->setData(data);
+    this->registers_[tam::LB] = 1;
+    CodeVec code{0, 0};
+    this->setCode(code);
+
+    tam::TamInstruction instr = {8, 0, 3, 1};
+    ASSERT_NO_THROW({ this->Execute(instr); });
+
+    EXPECT_EQ(3, this->registers_[tam::ST]);
+    EXPECT_EQ(0, this->registers_[tam::LB]);
+    EXPECT_EQ(1, this->registers_[tam::CP]);
+    EXPECT_EQ(4, this->data_store_[0]);
+    EXPECT_EQ(5, this->data_store_[1]);
+    EXPECT_EQ(6, this->data_store_[2]);
+}
+
+TEST_F(EmulatorTest, TestReturnFrameWrapsAround) {
+    // the frame links of LB = ffff are read from the bottom of memory
+    std::vector<tam::TamData> data = {0, -1, 7};
+    this->setData(data);
+    this->registers_[tam::LB] = 0xffff;
+    CodeVec code{0, 0};
+    this->setCode(code);
+
+    tam::TamInstruction instr = {8, 0, 0, 0};
+    EXPECT_THROW({ this->Execute(instr); }, std::runtime_error);
+}
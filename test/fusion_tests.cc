@@ -0,0 +1,102 @@
+#include <vector>
+
+#include "tam/tam.h"
+#include "tam/test/integration_test.h"
+
+#include <gtest/gtest.h>
+
+// `testing::Test` also has a `Run` method, so calls must be qualified.
+class FusionTest : public EmulatorTest {};
+
+TEST_F(FusionTest, ReportsFusions) {
+    // LOADL 1, CALL add, LOADA 0[SB], LOADI(1),
+    // LOAD(1) 0[SB], LOAD(1) 1[SB], CALL lt, JUMPIF(0) 0[CB], HALT
+    CodeVec code{0x30000001, 0x62000008, 0x14000000, 0x20010000, 0x04010000,
+                 0x04010001, 0x6200000d, 0xe0000000, 0xf0000000};
+    this->LoadProgram(code);
+
+    const std::vector<tam::Fusion>& fusions = this->GetFusions();
+    ASSERT_EQ(3, fusions.size());
+    EXPECT_EQ(0, fusions[0].addr);
+    EXPECT_EQ(tam::kLoadlAdd, fusions[0].op);
+    EXPECT_EQ(2, fusions[1].addr);
+    EXPECT_EQ(tam::kLoadaLoadi, fusions[1].op);
+    EXPECT_EQ(4, fusions[2].addr);
+    EXPECT_EQ(tam::kLoadLoadLt, fusions[2].op);
+    EXPECT_EQ("LOAD;LOAD;lt;JUMPIF",
+              tam::superinstruction_names[fusions[2].op - tam::kLoadlAdd]);
+
+    // fetching still yields the original instructions
+    EXPECT_EQ(tam::LOADL, this->FetchDecode().op);
+}
+
+TEST_F(FusionTest, FusedLoopMatchesExecute) {
+    // while i < 10 do i := i + 2
+    // 0: PUSH 2, LOADL 10, STORE(1) 1[SB]
+    // 3: LOAD(1) 0[SB], LOAD(1) 1[SB], CALL lt, JUMPIF(0) 13[CB]
+    // 7: LOADA 0[SB], LOADI(1), LOADL 2, CALL add, STORE(1) 0[SB]
+    // 12: JUMP 3[CB], HALT
+    CodeVec code{0xa0000002, 0x30000000 | 10, 0x44010001, 0x04010000,
+                 0x04010001, 0x6200000d, 0xe000000d, 0x14000000,
+                 0x20010000, 0x30000002, 0x62000008, 0x44010000,
+                 0xc0000003, 0xf0000000};
+    this->LoadProgram(code);
+    ASSERT_EQ(3, this->GetFusions().size());
+
+    tam::RunResult result = this->TamEmulator::Run(1000);
+    ASSERT_EQ(tam::StopReason::kHalted, result.reason) << result.error;
+    DataVec run_data(this->data_store_.begin(), this->data_store_.begin() + 4);
+    tam::TamAddr run_st = this->registers_[tam::ST];
+
+    this->data_store_.fill(0);
+    this->registers_[tam::CP] = 0;
+    this->registers_[tam::ST] = 0;
+    uint64_t steps = 0;
+    do {
+        ++steps;
+    } while (this->Execute(this->FetchDecode()));
+    DataVec execute_data(this->data_store_.begin(),
+                         this->data_store_.begin() + 4);
+
+    EXPECT_EQ(10, run_data[0]);
+    EXPECT_EQ(execute_data, run_data);
+    EXPECT_EQ(this->registers_[tam::ST], run_st);
+    EXPECT_EQ(steps, result.steps);
+}
+
+TEST_F(FusionTest, JumpIntoFusedSequence) {
+    // JUMP 2[CB], LOADL 1, CALL add, HALT
+    CodeVec code{0xc0000002, 0x30000001, 0x62000008, 0xf0000000};
+    DataVec data{3, 4};
+    this->LoadProgram(code);
+    this->setData(data);
+
+    tam::RunResult result = this->TamEmulator::Run(100);
+    ASSERT_EQ(tam::StopReason::kHalted, result.reason);
+    EXPECT_EQ(1, this->registers_[tam::ST]);
+    EXPECT_EQ(7, this->data_store_[0]);
+}
+
+TEST_F(FusionTest, FusedErrorAtOriginalAddress) {
+    // LOADL 1, CALL add
+    CodeVec code{0x30000001, 0x62000008};
+    this->LoadProgram(code);
+    ASSERT_EQ(1, this->GetFusions().size());
+
+    tam::RunResult result = this->TamEmulator::Run(100);
+    EXPECT_EQ(tam::StopReason::kError, result.reason);
+    EXPECT_EQ("error: stack underflow: error at loc 0001", result.error);
+}
+
+TEST_F(FusionTest, FusedSequenceRespectsBudget) {
+    // LOADL 1, CALL add, HALT
+    CodeVec code{0x30000001, 0x62000008, 0xf0000000};
+    DataVec data{3};
+    this->LoadProgram(code);
+    this->setData(data);
+
+    tam::RunResult result = this->TamEmulator::Run(1);
+    EXPECT_EQ(tam::StopReason::kBudgetExhausted, result.reason);
+    EXPECT_EQ(1, this->registers_[tam::CP]);
+    EXPECT_EQ(2, this->registers_[tam::ST]);
+}
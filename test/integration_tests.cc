@@ -3,6 +3,7 @@
 #include <cstdio>
 #include <vector>
 
+#include "tam/program.h"
 #include "tam/tam.h"
 #include "tam/test/integration_test.h"
 
@@ -15,21 +16,47 @@ TEST_F(EmulatorTest, TestLoadProgram) {
 
     ASSERT_NO_THROW({ this->LoadProgram(code); });
 
-    EXPECT_EQ(0x12345678, this->code_store_[0]);
-    EXPECT_EQ(0x9abcdef0, this->code_store_[1]);
-    EXPECT_EQ(0xfedcba98, this->code_store_[2]);
+    EXPECT_EQ(0x12345678, this->program_->code()[0]);
+    EXPECT_EQ(0x9abcdef0, this->program_->code()[1]);
+    EXPECT_EQ(0xfedcba98, this->program_->code()[2]);
     EXPECT_EQ(3, this->registers_[tam::CT]);
     EXPECT_EQ(3, this->registers_[tam::PB]);
     EXPECT_EQ(32, this->registers_[tam::PT]);
 }
 
+TEST_F(EmulatorTest, TestLoadProgramDecodes) {
+    // LOADL 88, CALL put, HALT
+    CodeVec code{0x3e000058, 0x62000016, 0xf0000000};
+
+    ASSERT_NO_THROW({ this->LoadProgram(code); });
+
+    ASSERT_EQ(3, this->program_->decoded().size());
+    EXPECT_EQ(tam::LOADL, this->program_->decoded()[0].instr.op);
+    EXPECT_EQ(88, this->program_->decoded()[0].instr.d);
+    EXPECT_EQ(tam::CALL, this->program_->decoded()[1].instr.op);
+    EXPECT_EQ(tam::PB, this->program_->decoded()[1].instr.r);
+    EXPECT_EQ(22, this->program_->decoded()[1].instr.d);
+    EXPECT_EQ(tam::kPrimitiveHandlerBase + 22,
+              this->program_->decoded()[1].handler);
+    EXPECT_EQ(tam::HALT, this->program_->decoded()[2].instr.op);
+}
+
+TEST_F(EmulatorTest, TestFetchPastCodeTop) {
+    CodeVec code{0xf0000000};
+    this->setCode(code);
+    this->registers_[tam::CP] = 1;
+
+    EXPECT_THROW({ this->FetchDecode(); }, std::runtime_error);
+}
+
 TEST_F(EmulatorTest, TestSimpleCycle) {
-    this->code_store_[0] = 0x08020000;
+    // LOAD(2) 0[SB]
+    CodeVec code{0x08020000};
+    this->setCode(code);
     this->data_store_[0] = 0x1234;
     this->data_store_[1] = 0x5678;
     this->data_store_[2] = 0x9abc;
 
-    this->registers_[tam::CT] = 1;
     this->registers_[tam::CP] = 0;
     this->registers_[tam::ST] = 3;
 
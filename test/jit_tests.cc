@@ -0,0 +1,167 @@
+#include <array>
+#include <vector>
+
+#include "tam/jit.h"
+#include "tam/program.h"
+#include "tam/tam.h"
+#include "tam/test/integration_test.h"
+
+#include <gtest/gtest.h>
+
+// `testing::Test` also has a `Run` method, so calls must be qualified.
+class JitTest : public EmulatorTest {
+   protected:
+    void SetUp() override {
+        if (!tam::JitCode::Supported()) GTEST_SKIP() << "JIT not supported";
+    }
+
+    /// State of the emulator after a call to `Run`.
+    ///
+    struct Outcome {
+        tam::RunResult result;
+        std::array<tam::TamAddr, 16> registers;
+        std::vector<tam::TamData> data;  ///< Bottom of the stack
+    };
+
+    /// Run a program from a fresh state, at most `budget` steps at a time,
+    /// until it stops for a reason other than the budget.
+    ///
+    /// @return the state after each call to `Run`
+    std::vector<Outcome> RunProgram(CodeVec& code, uint64_t budget, bool jit) {
+        this->registers_.fill(0);
+        this->registers_[tam::HB] = tam::kMaxAddr;
+        this->registers_[tam::HT] = tam::kMaxAddr;
+        this->data_store_.fill(0);
+        this->stack_used_ = 0;
+        this->setCode(code);
+        if (jit) {
+            EXPECT_TRUE(this->EnableJit());
+        } else {
+            this->jit_enabled_ = false;
+        }
+
+        std::vector<Outcome> outcomes;
+        do {
+            tam::RunResult result = this->TamEmulator::Run(budget);
+            outcomes.push_back(Outcome{
+                result, this->registers_,
+                std::vector<tam::TamData>(this->data_store_.begin(),
+                                          this->data_store_.begin() + 256)});
+        } while (outcomes.back().result.reason ==
+                     tam::StopReason::kBudgetExhausted &&
+                 outcomes.size() < 100000);
+        return outcomes;
+    }
+
+    /// Check that running a program natively has exactly the same effect as
+    /// interpreting it, for the given budget.
+    void ExpectSameAsInterpreter(CodeVec& code, uint64_t budget) {
+        std::vector<Outcome> expected = this->RunProgram(code, budget, false);
+        std::vector<Outcome> actual = this->RunProgram(code, budget, true);
+
+        ASSERT_EQ(expected.size(), actual.size()) << "budget " << budget;
+        for (size_t I = 0; I < expected.size(); ++I) {
+            EXPECT_EQ(expected[I].result.reason, actual[I].result.reason);
+            EXPECT_EQ(expected[I].result.steps, actual[I].result.steps);
+            EXPECT_EQ(expected[I].result.error, actual[I].result.error);
+            EXPECT_EQ(expected[I].registers, actual[I].registers)
+                << "budget " << budget << ", call " << I;
+            EXPECT_EQ(expected[I].data, actual[I].data)
+                << "budget " << budget << ", call " << I;
+        }
+    }
+};
+
+TEST_F(JitTest, LoopMatchesInterpreter) {
+    // PUSH 2, LOADL 10, STORE(1) 0[SB],
+    // loop: LOAD(1) 0[SB], JUMPIF(0) end[CB], LOAD(1) 1[SB], LOAD(1) 0[SB],
+    // CALL add, STORE(1) 1[SB], LOAD(1) 0[SB], CALL pred, STORE(1) 0[SB],
+    // JUMP loop[CB],
+    // end: LOAD(1) 1[SB], LOADL 55, LOADL 1, CALL eq, HALT
+    CodeVec code{0xa0000002, 0x3000000a, 0x44010000, 0x04010000, 0xe000000d,
+                 0x04010001, 0x04010000, 0x62000008, 0x44010001, 0x04010000,
+                 0x62000006, 0x44010000, 0xc0000003, 0x04010001, 0x30000037,
+                 0x30000001, 0x62000011, 0xf0000000};
+
+    std::vector<Outcome> outcomes = this->RunProgram(code, 1000, true);
+    ASSERT_EQ(1, outcomes.size());
+    EXPECT_EQ(tam::StopReason::kHalted, outcomes[0].result.reason);
+    EXPECT_EQ(3, outcomes[0].registers[tam::ST]);
+    EXPECT_EQ(1, outcomes[0].data[2]);
+
+    // the loop condition is a block of its own
+    const tam::JitCode* jit = this->program_->GetJitCode();
+    ASSERT_TRUE(jit);
+    EXPECT_NE(nullptr, jit->BlockAt(3));
+    EXPECT_EQ(2, jit->BlockLength(3));
+
+    for (uint64_t budget = 1; budget <= 20; ++budget)
+        this->ExpectSameAsInterpreter(code, budget);
+    this->ExpectSameAsInterpreter(code, 1000);
+}
+
+TEST_F(JitTest, RecursionMatchesInterpreter) {
+    // LOADL 8, CALL(SB) fib[CB], HALT, HALT,
+    // fib: LOAD(1) -1[LB], LOADL 2, CALL lt, JUMPIF(0) rec[CB],
+    // LOAD(1) -1[LB], RETURN(1) 1,
+    // rec: LOAD(1) -1[LB], CALL pred, CALL(SB) fib[CB],
+    // LOAD(1) -1[LB], LOADL 2, CALL sub, CALL(SB) fib[CB], CALL add,
+    // RETURN(1) 1
+    CodeVec code{0x30000008, 0x60040004, 0xf0000000, 0xf0000000, 0x0801ffff,
+                 0x30000002, 0x6200000d, 0xe000000a, 0x0801ffff, 0x80010001,
+                 0x0801ffff, 0x62000006, 0x60040004, 0x0801ffff, 0x30000002,
+                 0x62000009, 0x60040004, 0x62000008, 0x80010001};
+
+    std::vector<Outcome> outcomes = this->RunProgram(code, 1000000, true);
+    ASSERT_EQ(1, outcomes.size());
+    EXPECT_EQ(tam::StopReason::kHalted, outcomes[0].result.reason);
+    EXPECT_EQ(1, outcomes[0].registers[tam::ST]);
+    EXPECT_EQ(21, outcomes[0].data[0]);
+
+    for (uint64_t budget = 1; budget <= 20; ++budget)
+        this->ExpectSameAsInterpreter(code, budget);
+    this->ExpectSameAsInterpreter(code, 1000000);
+}
+
+TEST_F(JitTest, TracksStackWritten) {
+    // the program from RecursionMatchesInterpreter
+    CodeVec code{0x30000008, 0x60040004, 0xf0000000, 0xf0000000, 0x0801ffff,
+                 0x30000002, 0x6200000d, 0xe000000a, 0x0801ffff, 0x80010001,
+                 0x0801ffff, 0x62000006, 0x60040004, 0x0801ffff, 0x30000002,
+                 0x62000009, 0x60040004, 0x62000008, 0x80010001};
+    this->RunProgram(code, 1000000, true);
+
+    // `Reset` need only clear the words the stack reached
+    EXPECT_LT(this->stack_used_, 256);
+    for (int I = this->stack_used_; I < tam::kMemSize; ++I)
+        ASSERT_EQ(0, this->data_store_[I]) << "address " << I;
+}
+
+TEST_F(JitTest, ErrorsMatchInterpreter) {
+    std::vector<CodeVec> programs{
+        // LOADL 3, CALL succ, LOADL 0, CALL div, HALT
+        {0x30000003, 0x62000005, 0x30000000, 0x6200000b, 0xf0000000},
+        // LOADL 1, STORE(2) 0[SB], HALT
+        {0x30000001, 0x44020000, 0xf0000000},
+        // PUSH 1, LOAD(1) 5[SB], HALT
+        {0xa0000001, 0x04010005, 0xf0000000},
+        // LOADL 1, JUMP 100[CB]
+        {0x30000001, 0xc0000064},
+        // LOADL 1, LOADL 1, CALL eq, HALT
+        {0x30000001, 0x30000001, 0x62000011, 0xf0000000},
+        // LOADL 1, POP(1) 2, HALT
+        {0x30000001, 0xb0010002, 0xf0000000},
+        // CALL(CB) 3[CB], RETURN(0) 0, HALT,
+        // LOADL -1, STORE(1) 1[LB], RETURN(0) 0
+        {0x60000003, 0x80000000, 0xf0000000, 0x3000ffff, 0x48010001,
+         0x80000000},
+    };
+
+    for (CodeVec& code : programs) {
+        std::vector<Outcome> outcomes = this->RunProgram(code, 100, true);
+        ASSERT_EQ(1, outcomes.size());
+        EXPECT_EQ(tam::StopReason::kError, outcomes[0].result.reason);
+
+        this->ExpectSameAsInterpreter(code, 100);
+    }
+}
@@ -0,0 +1,103 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "tam/loader.h"
+#include "tam/program.h"
+#include "tam/tam.h"
+#include "tam/test/integration_test.h"
+
+#include <gtest/gtest.h>
+
+class LoaderTest : public EmulatorTest {
+   protected:
+    /// Encode code words as they are stored in a TAM binary.
+    ///
+    std::vector<uint8_t> Encode(const CodeVec& code) {
+        std::vector<uint8_t> bytes;
+        for (tam::TamCode word : code)
+            for (int shift = 24; shift >= 0; shift -= 8)
+                bytes.push_back(word >> shift);
+        return bytes;
+    }
+};
+
+TEST_F(LoaderTest, DecodeProgramBytes) {
+    // every length up to several vectors, so that each tail is exercised
+    CodeVec code;
+    for (int I = 0; I < 40; ++I) code.push_back(0x01020304u * (I + 1) + I);
+    std::vector<uint8_t> bytes = this->Encode(code);
+
+    for (size_t count = 0; count <= code.size(); ++count) {
+        CodeVec words(count + 1, 0xdeadbeef);
+        tam::DecodeProgramBytes(bytes.data(), count, words.data());
+        EXPECT_EQ(CodeVec(code.begin(), code.begin() + count),
+                  CodeVec(words.begin(), words.begin() + count));
+        EXPECT_EQ(0xdeadbeef, words[count]) << "wrote past " << count;
+    }
+}
+
+TEST_F(LoaderTest, LoadProgramImage) {
+    // LOADL 88, CALL put, HALT
+    CodeVec code{0x3e000058, 0x62000016, 0xf0000000};
+    std::vector<uint8_t> bytes = this->Encode(code);
+
+    ASSERT_NO_THROW(this->LoadProgramImage(bytes.data(), bytes.size()));
+    EXPECT_EQ(3, this->registers_[tam::CT]);
+    EXPECT_EQ(3, this->registers_[tam::PB]);
+    EXPECT_EQ(32, this->registers_[tam::PT]);
+    for (int I = 0; I < 3; ++I) EXPECT_EQ(code[I], this->program_->code()[I]);
+
+    EXPECT_THROW(this->LoadProgramImage(bytes.data(), bytes.size() - 1),
+                 std::runtime_error);
+}
+
+TEST_F(LoaderTest, LoadProgramFromBuffer) {
+    CodeVec code{0x30000001, 0x30000002, 0x62000008, 0xf0000000};
+    ASSERT_NO_THROW(this->LoadProgram(code.data(), code.size()));
+    EXPECT_EQ(4, this->registers_[tam::CT]);
+    EXPECT_EQ(4, this->TamEmulator::Run(100).steps);
+    EXPECT_EQ(3, this->data_store_[0]);
+}
+
+TEST_F(LoaderTest, LoadProgramFile) {
+    CodeVec code{0x30000001, 0x30000002, 0x62000008, 0xf0000000};
+    std::vector<uint8_t> bytes = this->Encode(code);
+
+    std::string filename = testing::TempDir() + "loader_test.tam";
+    FILE* file = fopen(filename.c_str(), "wb");
+    ASSERT_TRUE(file);
+    fwrite(bytes.data(), 1, bytes.size(), file);
+    fclose(file);
+
+    EXPECT_EQ(code, tam::ReadProgramFromFile(filename));
+    ASSERT_NO_THROW(this->LoadProgramFile(filename));
+    EXPECT_EQ(4, this->registers_[tam::CT]);
+    for (int I = 0; I < 4; ++I) EXPECT_EQ(code[I], this->program_->code()[I]);
+
+    // an incomplete final word is rejected
+    file = fopen(filename.c_str(), "ab");
+    fputc(0, file);
+    fclose(file);
+    EXPECT_THROW(this->LoadProgramFile(filename), std::runtime_error);
+
+    // so is a program too large to fit in memory
+    std::vector<uint8_t> large(4 * (tam::kMemSize + 1));
+    file = fopen(filename.c_str(), "wb");
+    fwrite(large.data(), 1, large.size(), file);
+    fclose(file);
+    EXPECT_THROW(tam::ReadProgramFromFile(filename), std::runtime_error);
+    EXPECT_THROW(this->LoadProgramFile(filename), std::runtime_error);
+    remove(filename.c_str());
+
+    try {
+        this->LoadProgramFile(filename);
+        ADD_FAILURE() << "missing file was loaded";
+    } catch (const std::runtime_error& e) {
+        EXPECT_NE(std::string::npos, std::string(e.what()).find(filename))
+            << e.what();
+    }
+}
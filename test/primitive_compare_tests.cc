@@ -76,3 +76,26 @@ RC_GTEST_FIXTURE_PROP(PrimitiveCompareTests, TestEqFalse,
 
     RC_ASSERT_FALSE(this->data_store_[0]);
 }
+
+TEST_F(PrimitiveCompareTests, TestEqWideRecords) {
+    // differ only in the last word, beyond any full vector of words
+    for (int width : {1, 7, 8, 9, 16, 17, 40}) {
+        this->registers_[tam::ST] = 0;
+        for (int I = 0; I < width; ++I) this->PushData(I);
+        for (int I = 0; I < width; ++I)
+            this->PushData(I == width - 1 ? -1 : I);
+        this->PushData(width);
+
+        ASSERT_NO_THROW(this->PrimitiveEq());
+        EXPECT_EQ(1, this->registers_[tam::ST]);
+        EXPECT_EQ(0, this->data_store_[0]) << "width " << width;
+    }
+}
+
+TEST_F(PrimitiveCompareTests, TestNeUnderflow) {
+    this->PushData(1);
+    this->PushData(2);
+    this->PushData(2);
+
+    EXPECT_THROW(this->PrimitiveNe(), std::runtime_error);
+}
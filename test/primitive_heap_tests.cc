@@ -1,5 +1,7 @@
 #include <map>
+#include <vector>
 
+#include "tam/heap.h"
 #include "tam/tam.h"
 #include "tam/test/integration_test.h"
 
@@ -17,19 +19,17 @@ TEST_F(HeapTest, HeapAllocateExpandHeap) {
 TEST_F(HeapTest, HeapAllocateReuseBlock) {
     this->registers_[tam::HT] = 65530;
     this->allocated_blocks_[65531] = 2;
-    this->free_blocks_[65533] = 3;
+    this->heap_allocator_->Release(65533, 3);
 
     ASSERT_NO_THROW({ this->Allocate(2); });
     EXPECT_TRUE(this->allocated_blocks_.count(65533))
         << "Block not allocated successfully";
     EXPECT_EQ(2, this->allocated_blocks_[65533])
         << "Allocated block has wrong size";
-    EXPECT_FALSE(this->free_blocks_.count(65533))
+    EXPECT_EQ(0, this->heap_allocator_->FreeBlockSize(65533))
         << "Free block not marked as used";
-    EXPECT_TRUE(this->free_blocks_.count(65535))
-        << "Leftover heap not marked as free";
-    EXPECT_EQ(1, this->free_blocks_[65535])
-        << "Unallocated block has wrong size";
+    EXPECT_EQ(1, this->heap_allocator_->FreeBlockSize(65535))
+        << "Leftover heap not marked as free, or has wrong size";
 }
 
 TEST_F(HeapTest, FreeEndOfHeap) {
@@ -49,8 +49,7 @@ TEST_F(HeapTest, FreeMiddleOfHeap) {
     ASSERT_NO_THROW({ this->Free(65533, 3); });
     EXPECT_EQ(65530, this->registers_[tam::HT]) << "HT unexpectedly changed";
     EXPECT_FALSE(this->allocated_blocks_.count(65533));
-    EXPECT_TRUE(this->free_blocks_.count(65533));
-    EXPECT_EQ(3, this->free_blocks_[65533]);
+    EXPECT_EQ(3, this->heap_allocator_->FreeBlockSize(65533));
 }
 
 TEST_F(HeapTest, HeapAllocateZero) {
@@ -59,4 +58,72 @@ TEST_F(HeapTest, HeapAllocateZero) {
     this->allocated_blocks_[65533] = 3;
     ASSERT_EQ(0, this->Allocate(0));
     ASSERT_NO_THROW(this->Free(0, 0));
-}
\ No newline at end of file
+}
+
+TEST_F(HeapTest, HeapAllocateBestFit) {
+    this->registers_[tam::HT] = 65520;
+    this->heap_allocator_->Release(65521, 5);
+    this->heap_allocator_->Release(65527, 2);
+    this->heap_allocator_->Release(65530, 3);
+
+    EXPECT_EQ(65530, this->Allocate(3));
+    EXPECT_EQ(65527, this->Allocate(2));
+    EXPECT_EQ(65521, this->Allocate(2));
+    EXPECT_EQ(3, this->heap_allocator_->FreeBlockSize(65523));
+    EXPECT_EQ(65520, this->registers_[tam::HT]);
+}
+
+TEST_F(HeapTest, FreeCoalescesNeighbours) {
+    tam::TamAddr a = this->Allocate(2), b = this->Allocate(3),
+                 c = this->Allocate(4), d = this->Allocate(1);
+    (void)d;
+
+    ASSERT_NO_THROW(this->Free(a, 2));
+    ASSERT_NO_THROW(this->Free(c, 4));
+    ASSERT_NO_THROW(this->Free(b, 3));
+    EXPECT_EQ(9, this->heap_allocator_->FreeBlockSize(c));
+    EXPECT_EQ(0, this->heap_allocator_->FreeBlockSize(b));
+    EXPECT_EQ(0, this->heap_allocator_->FreeBlockSize(a));
+
+    tam::HeapStats stats = this->GetHeapStats();
+    EXPECT_EQ(10, stats.heap_words);
+    EXPECT_EQ(1, stats.allocated_blocks);
+    EXPECT_EQ(1, stats.allocated_words);
+    EXPECT_EQ(1, stats.free_blocks);
+    EXPECT_EQ(9, stats.free_words);
+    EXPECT_EQ(9, stats.largest_free_block);
+}
+
+TEST_F(HeapTest, FreeShrinksHeapOverTrailingFreeBlocks) {
+    tam::TamAddr a = this->Allocate(2), b = this->Allocate(3),
+                 c = this->Allocate(4);
+
+    ASSERT_NO_THROW(this->Free(b, 3));
+    ASSERT_NO_THROW(this->Free(a, 2));
+    EXPECT_EQ(c - 1, this->registers_[tam::HT]);
+
+    // the free run is now on top of the heap
+    ASSERT_NO_THROW(this->Free(c, 4));
+    EXPECT_EQ(65535, this->registers_[tam::HT]);
+
+    tam::HeapStats stats = this->GetHeapStats();
+    EXPECT_EQ(0, stats.heap_words);
+    EXPECT_EQ(0, stats.free_blocks);
+    EXPECT_EQ(0, stats.free_words);
+}
+
+TEST_F(HeapTest, FreedBlocksSatisfyLargerAllocation) {
+    this->registers_[tam::ST] = 65535 - 600;
+
+    std::vector<tam::TamAddr> blocks;
+    for (int I = 0; I < 100; ++I) blocks.push_back(this->Allocate(5));
+
+    // keep the lowest block so that the heap cannot shrink
+    for (int I = 0; I < 99; ++I) ASSERT_NO_THROW(this->Free(blocks[I], 5));
+    EXPECT_EQ(1, this->GetHeapStats().free_blocks);
+
+    tam::TamAddr addr = 0;
+    ASSERT_NO_THROW({ addr = this->Allocate(400); });
+    EXPECT_EQ(blocks[98], addr);
+    EXPECT_EQ(500, this->GetHeapStats().heap_words);
+}
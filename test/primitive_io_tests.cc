@@ -1,5 +1,12 @@
 #include <stdio.h>
 
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "tam/io.h"
+#include "tam/tam.h"
 #include "tam/test/integration_test.h"
 
 #include <gtest/gtest.h>
@@ -126,3 +133,136 @@ TEST_F(IoTest, PutintTest) {
     fscanf(outstream, "%d", &output);
     ASSERT_EQ(456, output);
 }
+
+TEST_F(IoTest, MemoryInputTest) {
+    std::string input = "\nab";
+    this->setInput(std::make_unique<tam::MemoryInput>(input));
+
+    ASSERT_NO_THROW({ this->PrimitiveEol(); });
+    EXPECT_EQ(1, this->data_store_[0]);
+    ASSERT_NO_THROW({ this->PrimitiveGeteol(); });
+
+    DataVec data = {0, 0};
+    for (char expected : {'a', 'b'}) {
+        this->setData(data);
+        ASSERT_NO_THROW({ this->PrimitiveGet(); });
+        EXPECT_EQ(expected, this->data_store_[0]);
+
+        // reading the last character does not set end of file on its own
+        ASSERT_NO_THROW({ this->PrimitiveEof(); });
+        EXPECT_EQ(0, this->data_store_[1]);
+    }
+
+    this->setData(data);
+    ASSERT_NO_THROW({ this->PrimitiveEol(); });
+    EXPECT_EQ(0, this->data_store_[2]);
+    ASSERT_NO_THROW({ this->PrimitiveEof(); });
+    EXPECT_EQ(1, this->data_store_[3]);
+}
+
+TEST_F(IoTest, MemoryGetintTest) {
+    std::string input = "  -4321 rest of line\n7\n";
+    this->setInput(std::make_unique<tam::MemoryInput>(input));
+
+    DataVec data = {0, 0};
+    this->setData(data);
+
+    ASSERT_NO_THROW({ this->PrimitiveGetint(); });
+    EXPECT_EQ(-4321, this->data_store_[0]);
+
+    this->data_store_[0] = 0;
+    ASSERT_NO_THROW({ this->PrimitiveGetint(); });
+    EXPECT_EQ(7, this->data_store_[0]);
+}
+
+TEST_F(IoTest, GetintLimitsTest) {
+    std::string input = "32767\n-32768\n+00012\n";
+    this->setInput(std::make_unique<tam::MemoryInput>(input));
+
+    for (tam::TamData expected : {32767, -32768, 12}) {
+        DataVec data = {0};
+        this->setData(data);
+
+        ASSERT_NO_THROW({ this->PrimitiveGetint(); });
+        EXPECT_EQ(expected, this->data_store_[0]);
+    }
+}
+
+TEST_F(IoTest, GetintErrorTest) {
+    for (std::string input : {"40000\n", "-32769\n", "99999999999999999999\n",
+                              "x\n", "-\n", ""}) {
+        this->setInput(std::make_unique<tam::MemoryInput>(input));
+        DataVec data = {0};
+        this->setData(data);
+
+        EXPECT_THROW({ this->PrimitiveGetint(); }, std::runtime_error) << input;
+    }
+}
+
+TEST_F(IoTest, ChannelGetintBlocksTest) {
+    auto channel = std::make_unique<tam::ChannelInput>();
+    tam::ChannelInput& input = *channel;
+    this->setInput(std::move(channel));
+
+    DataVec data = {0};
+    this->setData(data);
+
+    // the number may continue, so nothing is consumed until it ends
+    input.Feed(" 12", 3);
+    EXPECT_THROW({ this->PrimitiveGetint(); }, tam::InputBlocked);
+    EXPECT_EQ(1, this->registers_[tam::ST]);
+    EXPECT_EQ(' ', input.Peek());
+
+    input.Feed("3 rest", 6);
+    EXPECT_THROW({ this->PrimitiveGetint(); }, tam::InputBlocked);
+    input.Feed("\nx", 2);
+    ASSERT_NO_THROW({ this->PrimitiveGetint(); });
+    EXPECT_EQ(123, this->data_store_[0]);
+    EXPECT_EQ(0, this->registers_[tam::ST]);
+    EXPECT_EQ('x', input.Peek());
+
+    // end of input is only reported once the channel is closed
+    input.Get();
+    EXPECT_EQ(tam::InputSource::kWouldBlock, input.Get());
+    EXPECT_FALSE(input.Eof());
+    input.Close();
+    EXPECT_EQ(EOF, input.Get());
+    EXPECT_TRUE(input.Eof());
+}
+
+TEST_F(IoTest, BufferOutputTest) {
+    auto output = std::make_unique<tam::BufferOutput>();
+    tam::BufferOutput& buffer = *output;
+    this->setOutput(std::move(output));
+
+    DataVec data = {-32768, 'x'};
+    this->setData(data);
+
+    ASSERT_NO_THROW({
+        this->PrimitivePut();
+        this->PrimitivePuteol();
+        this->PrimitivePutint();
+    });
+    EXPECT_EQ("x\n-32768", buffer.str());
+}
+
+TEST_F(IoTest, BufferedFileOutputTest) {
+    FILE* file = tmpfile();
+    {
+        tam::BufferedFileOutput output(file, false, 4);
+        output.Write("abc", 3);
+        output.Put('d');
+        output.Write("efghij", 6);
+        output.Put('k');
+
+        // only the full buffer and the oversized write have reached the file
+        fflush(file);
+        EXPECT_EQ(10, ftell(file));
+    }
+
+    rewind(file);
+    char contents[16] = {0};
+    ASSERT_EQ(11, fread(contents, 1, sizeof contents, file));
+    EXPECT_STREQ("abcdefghijk", contents);
+    fclose(file);
+}
@@ -0,0 +1,209 @@
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "tam/io.h"
+#include "tam/profiler.h"
+#include "tam/program.h"
+#include "tam/tam.h"
+
+#include <gtest/gtest.h>
+
+class ProfilerTest : public testing::Test {
+   protected:
+    // LOADL 8, CALL(SB) fib[CB], HALT, HALT,
+    // fib: LOAD(1) -1[LB], LOADL 2, CALL lt, JUMPIF(0) rec[CB],
+    // LOAD(1) -1[LB], RETURN(1) 1,
+    // rec: LOAD(1) -1[LB], CALL pred, CALL(SB) fib[CB],
+    // LOAD(1) -1[LB], LOADL 2, CALL sub, CALL(SB) fib[CB], CALL add,
+    // RETURN(1) 1
+    std::shared_ptr<const tam::TamProgram> program_ =
+        tam::TamProgram::FromCode(std::vector<tam::TamCode>{
+            0x30000008, 0x60040004, 0xf0000000, 0xf0000000, 0x0801ffff,
+            0x30000002, 0x6200000d, 0xe000000a, 0x0801ffff, 0x80010001,
+            0x0801ffff, 0x62000006, 0x60040004, 0x0801ffff, 0x30000002,
+            0x62000009, 0x60040004, 0x62000008, 0x80010001});
+
+    std::unique_ptr<tam::TamEmulator> NewEmulator() {
+        auto emulator = std::make_unique<tam::TamEmulator>(
+            std::make_unique<tam::MemoryInput>(""),
+            std::make_unique<tam::BufferOutput>());
+        emulator->LoadProgram(this->program_);
+        return emulator;
+    }
+};
+
+TEST_F(ProfilerTest, InfersProceduresFromCalls) {
+    tam::SamplingProfiler profiler(this->program_);
+    EXPECT_EQ(0, profiler.ProcedureAt(0));
+    EXPECT_EQ(0, profiler.ProcedureAt(3));
+    EXPECT_EQ(4, profiler.ProcedureAt(4));
+    EXPECT_EQ(4, profiler.ProcedureAt(18));
+}
+
+TEST_F(ProfilerTest, SamplesEveryPeriod) {
+    std::unique_ptr<tam::TamEmulator> emulator = this->NewEmulator();
+    tam::SamplingProfiler profiler(this->program_, 1);
+    tam::RunResult result = profiler.Run(*emulator, 1000000);
+    ASSERT_EQ(tam::StopReason::kHalted, result.reason);
+
+    // every instruction but the `HALT` is followed by a sample
+    EXPECT_EQ(result.steps - 1, profiler.SampleCount());
+    EXPECT_EQ(1, profiler.SamplesAt(1));
+    EXPECT_EQ(0, profiler.SamplesAt(0));
+    EXPECT_EQ(profiler.SamplesAt(5), profiler.SamplesAt(6));
+
+    std::ostringstream folded;
+    profiler.WriteFoldedStacks(folded);
+    EXPECT_NE(std::string::npos, folded.str().find("main 2\n"));
+    EXPECT_NE(std::string::npos, folded.str().find("main;proc_0004 "));
+    EXPECT_NE(std::string::npos,
+              folded.str().find("main;proc_0004;proc_0004;proc_0004 "));
+
+    std::ostringstream hot_spots;
+    profiler.WriteHotSpots(hot_spots);
+    EXPECT_NE(std::string::npos, hot_spots.str().find("proc_0004"));
+    EXPECT_NE(std::string::npos, hot_spots.str().find("LOAD(1) -1[LB]"));
+}
+
+TEST_F(ProfilerTest, SamplesAcrossCallsToRun) {
+    std::unique_ptr<tam::TamEmulator> emulator = this->NewEmulator();
+    tam::SamplingProfiler whole(this->program_, 7);
+    tam::RunResult expected = whole.Run(*emulator, 1000000);
+
+    emulator = this->NewEmulator();
+    tam::SamplingProfiler split(this->program_, 7);
+    uint64_t steps = 0;
+    tam::RunResult result;
+    do {
+        result = split.Run(*emulator, 5);
+        steps += result.steps;
+    } while (result.reason == tam::StopReason::kBudgetExhausted);
+
+    EXPECT_EQ(expected.steps, steps);
+    EXPECT_EQ(whole.SampleCount(), split.SampleCount());
+    for (tam::TamAddr addr = 0; addr < 19; ++addr)
+        EXPECT_EQ(whole.SamplesAt(addr), split.SamplesAt(addr));
+}
+
+TEST_F(ProfilerTest, CallGraphCountsCalls) {
+    std::unique_ptr<tam::TamEmulator> emulator = this->NewEmulator();
+    tam::CallGraphProfiler profiler(*emulator,
+                                    tam::CallGraphOptions{false, 10});
+    tam::RunResult result = emulator->Run(1000000);
+    ASSERT_EQ(tam::StopReason::kHalted, result.reason);
+    profiler.Finish();
+
+    // `LOADL 8`, `CALL(SB) fib[CB]` and `HALT` are in the main program
+    const std::map<tam::TamAddr, tam::ProcedureProfile>& procedures =
+        profiler.Procedures();
+    ASSERT_EQ(2, procedures.size());
+    EXPECT_EQ(1, procedures.at(0).calls);
+    EXPECT_EQ(result.steps, procedures.at(0).inclusive_steps);
+    EXPECT_EQ(3, procedures.at(0).exclusive_steps);
+    EXPECT_EQ(67, procedures.at(4).calls);
+    EXPECT_EQ(result.steps - 3, procedures.at(4).inclusive_steps);
+    EXPECT_EQ(result.steps - 3, procedures.at(4).exclusive_steps);
+
+    std::ostringstream trace;
+    profiler.WriteChromeTrace(trace);
+    size_t events = 0;
+    for (size_t pos = 0;
+         (pos = trace.str().find("\"ph\":\"X\"", pos)) != std::string::npos;
+         ++pos)
+        ++events;
+    EXPECT_EQ(10, events);
+    EXPECT_NE(std::string::npos,
+              trace.str().find("{\"name\":\"main\",\"ph\":\"X\",\"ts\":0.000"));
+}
+
+TEST_F(ProfilerTest, CallGraphSameWhenStepping) {
+    std::unique_ptr<tam::TamEmulator> emulator = this->NewEmulator();
+    tam::CallGraphProfiler run(*emulator);
+    tam::RunResult result;
+    do {
+        result = emulator->Run(3);
+    } while (result.reason == tam::StopReason::kBudgetExhausted);
+    run.Finish();
+
+    std::unique_ptr<tam::TamEmulator> stepped = this->NewEmulator();
+    tam::CallGraphProfiler step(*stepped);
+    while (stepped->Execute(stepped->FetchDecode())) {
+    }
+    step.Finish();
+
+    for (const auto& [entry, procedure] : run.Procedures()) {
+        const tam::ProcedureProfile& other = step.Procedures().at(entry);
+        EXPECT_EQ(procedure.calls, other.calls);
+        EXPECT_EQ(procedure.inclusive_steps, other.inclusive_steps);
+        EXPECT_EQ(procedure.exclusive_steps, other.exclusive_steps);
+    }
+}
+
+TEST_F(ProfilerTest, HeapProfilerFollowsBlocks) {
+    // PUSH 1, CALL(SB) alloc[CB], CALL(SB) alloc[CB], LOADL 2,
+    // LOAD(1) 1[SB], CALL dispose, HALT,
+    // alloc: LOADL 2, CALL new, RETURN(1) 0
+    this->program_ = tam::TamProgram::FromCode(std::vector<tam::TamCode>{
+        0xa0000001, 0x60040007, 0x60040007, 0x30000002, 0x04010001,
+        0x6200001c, 0xf0000000, 0x30000002, 0x6200001b, 0x80010000});
+
+    std::unique_ptr<tam::TamEmulator> emulator = this->NewEmulator();
+    tam::HeapProfiler profiler(*emulator);
+    ASSERT_EQ(tam::StopReason::kHalted, emulator->Run(100).reason);
+
+    // each call of `alloc` is a separate site
+    const std::map<std::vector<tam::TamAddr>, tam::HeapSiteProfile>& sites =
+        profiler.Sites();
+    ASSERT_EQ(3, sites.size());
+    const tam::HeapSiteProfile& first = sites.at({1, 8});
+    EXPECT_EQ(1, first.allocations);
+    EXPECT_EQ(2, first.allocated_words);
+    EXPECT_EQ(1, first.freed);
+    EXPECT_EQ(8, first.total_lifetime);
+    EXPECT_EQ(0, first.live_blocks);
+    const tam::HeapSiteProfile& second = sites.at({2, 8});
+    EXPECT_EQ(0, second.freed);
+    EXPECT_EQ(1, second.live_blocks);
+    EXPECT_EQ(2, second.live_words);
+    EXPECT_EQ(1, sites.at({5}).disposals);
+
+    EXPECT_EQ(1, profiler.LiveBlocks());
+    EXPECT_EQ(2, profiler.LiveWords());
+    EXPECT_EQ(4, profiler.PeakLiveWords());
+    EXPECT_EQ(2, profiler.SizeHistogram().at(2));
+
+    std::ostringstream report;
+    profiler.WriteReport(report);
+    EXPECT_NE(std::string::npos,
+              report.str().find("         1          2  "
+                                "main:0002 > proc_0007:0008\n"));
+}
+
+TEST_F(ProfilerTest, HeapProfilerSameWhenStepping) {
+    // LOADL 3, CALL new, LOADL 5, CALL new, LOADL 3, LOAD(1) 0[SB],
+    // CALL dispose, HALT
+    this->program_ = tam::TamProgram::FromCode(std::vector<tam::TamCode>{
+        0x30000003, 0x6200001b, 0x30000005, 0x6200001b, 0x30000003,
+        0x04010000, 0x6200001c, 0xf0000000});
+
+    std::unique_ptr<tam::TamEmulator> emulator = this->NewEmulator();
+    tam::HeapProfiler run(*emulator);
+    ASSERT_EQ(tam::StopReason::kHalted, emulator->Run(100).reason);
+
+    std::unique_ptr<tam::TamEmulator> stepped = this->NewEmulator();
+    tam::HeapProfiler step(*stepped);
+    while (stepped->Execute(stepped->FetchDecode())) {
+    }
+
+    std::ostringstream run_report, step_report;
+    run.WriteReport(run_report);
+    step.WriteReport(step_report);
+    EXPECT_EQ(run_report.str(), step_report.str());
+    EXPECT_EQ(5, run.LiveWords());
+    EXPECT_EQ(5, run.Sites().at({1}).total_lifetime);
+}
@@ -0,0 +1,469 @@
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tam/io.h"
+#include "tam/program.h"
+#include "tam/tam.h"
+#include "tam/test/integration_test.h"
+
+#include <gtest/gtest.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <poll.h>
+#include <unistd.h>
+#define TAM_TEST_PIPES 1
+#endif
+
+// `testing::Test` also has a `Run` method, so calls must be qualified.
+class RunTest : public EmulatorTest {};
+
+TEST_F(RunTest, RunUntilHalt) {
+    // LOADL 88, CALL put, HALT
+    CodeVec code{0x3e000058, 0x62000016, 0xf0000000};
+    this->LoadProgram(code);
+
+    FILE* outstream = tmpfile();
+    this->setOutstream(outstream);
+
+    tam::RunResult result = this->TamEmulator::Run(100);
+    EXPECT_EQ(tam::StopReason::kHalted, result.reason);
+    EXPECT_EQ(3, result.steps);
+    EXPECT_EQ(3, this->registers_[tam::CP]);
+
+    rewind(outstream);
+    char c = getc(outstream);
+    ASSERT_EQ(88, c);
+}
+
+TEST_F(RunTest, RunBudgetExhausted) {
+    // LOADL 1, LOADL 2, CALL add, HALT
+    CodeVec code{0x30000001, 0x30000002, 0x62000008, 0xf0000000};
+    this->LoadProgram(code);
+
+    tam::RunResult result = this->TamEmulator::Run(2);
+    EXPECT_EQ(tam::StopReason::kBudgetExhausted, result.reason);
+    EXPECT_EQ(2, result.steps);
+    EXPECT_EQ(2, this->registers_[tam::CP]);
+    EXPECT_EQ(2, this->registers_[tam::ST]);
+
+    result = this->TamEmulator::Run(2);
+    EXPECT_EQ(tam::StopReason::kHalted, result.reason);
+    EXPECT_EQ(2, result.steps);
+    EXPECT_EQ(1, this->registers_[tam::ST]);
+    EXPECT_EQ(3, this->data_store_[0]);
+}
+
+TEST_F(RunTest, RunCallAndReturn) {
+    // LOADL 5, CALL(SB) 4[CB], HALT, HALT,
+    // LOAD(1) -1[LB], CALL succ, RETURN(1) 1
+    CodeVec code{0x30000005, 0x60040004, 0xf0000000, 0xf0000000,
+                 0x0801ffff, 0x62000005, 0x80010001};
+    this->LoadProgram(code);
+
+    tam::RunResult result = this->TamEmulator::Run(100);
+    EXPECT_EQ(tam::StopReason::kHalted, result.reason);
+    EXPECT_EQ(6, result.steps);
+    EXPECT_EQ(1, this->registers_[tam::ST]);
+    EXPECT_EQ(0, this->registers_[tam::LB]);
+    EXPECT_EQ(6, this->data_store_[0]);
+}
+
+TEST_F(RunTest, RunReportsError) {
+    // LOADL 1, CALL add
+    CodeVec code{0x30000001, 0x62000008};
+    this->LoadProgram(code);
+
+    tam::RunResult result = this->TamEmulator::Run(100);
+    EXPECT_EQ(tam::StopReason::kError, result.reason);
+    EXPECT_EQ("error: stack underflow: error at loc 0001", result.error);
+}
+
+TEST_F(RunTest, RunReturnWrapsFrameLinks) {
+    // CALL(CB) 3[CB], RETURN(0) 0, HALT,
+    // LOADL -1, STORE(1) 1[LB], RETURN(0) 0
+    CodeVec code{0x60000003, 0x80000000, 0xf0000000,
+                 0x3000ffff, 0x48010001, 0x80000000};
+    this->LoadProgram(code);
+
+    // the corrupted dynamic link sends the second RETURN to the frame
+    // words at the bottom of memory rather than past the end of it
+    tam::RunResult result = this->TamEmulator::Run(100);
+    EXPECT_EQ(tam::StopReason::kError, result.reason);
+    EXPECT_EQ("error: code access violation: error at loc 0001",
+              result.error);
+}
+
+#if TAM_FLIGHT_RECORDER
+TEST_F(RunTest, PostMortemShowsTransfers) {
+    // LOADL 2, CALL(SB) 4[CB], CALL add, HALT,
+    // LOAD(1) -1[LB], RETURN(1) 1
+    CodeVec code{0x30000002, 0x60040004, 0x62000008, 0xf0000000,
+                 0x0801ffff, 0x80010001};
+    this->LoadProgram(code);
+
+    tam::RunResult result = this->TamEmulator::Run(100);
+    ASSERT_EQ(tam::StopReason::kError, result.reason);
+
+    std::string post_mortem = this->GetPostMortem();
+    EXPECT_EQ(
+        "Last instructions executed\n"
+        "        ST   LB   HT\n"
+        "0000:                   LOADL 2\n"
+        "0001:                   CALL(4) 4[CB]\n"
+        "0004:   0004 0001 ffff  LOAD(1) -1[LB]\n"
+        "0005:                   RETURN(1) 1\n"
+        "0002:   0001 0000 ffff  CALL add\n"
+        "\n"
+        "Stack\n",
+        post_mortem);
+
+    // only the most recent instructions are listed
+    post_mortem = this->GetPostMortem(2);
+    EXPECT_EQ(std::string::npos, post_mortem.find("LOAD(1)"));
+    EXPECT_NE(std::string::npos, post_mortem.find("RETURN"));
+}
+#endif
+
+TEST_F(RunTest, PostMortemListsOnlyRecordedInstructions) {
+    // LOADL 1, JUMP 3[CB], HALT, LOADL 0, CALL div
+    CodeVec code{0x30000001, 0xc0000003, 0xf0000000, 0x30000000,
+                 0x6200000b};
+    this->LoadProgram(code);
+
+    tam::RunResult result = this->TamEmulator::Run(100);
+    ASSERT_EQ(tam::StopReason::kError, result.reason);
+
+    std::string post_mortem = this->GetPostMortem();
+    std::string history = post_mortem.substr(0, post_mortem.find("\n\n"));
+#if TAM_FLIGHT_RECORDER
+    EXPECT_EQ(
+        "Last instructions executed\n"
+        "        ST   LB   HT\n"
+        "0000:                   LOADL 1\n"
+        "0001:                   JUMP 3[CB]\n"
+        "0003:   0001 0000 ffff  LOADL 0\n"
+        "0004:                   CALL div",
+        history);
+#else
+    // the HALT skipped by the jump must not be listed
+    EXPECT_EQ(
+        "Last instructions executed\n"
+        "        ST   LB   HT\n"
+        "(earlier instructions were not recorded)\n"
+        "0004:                   CALL div",
+        history);
+#endif
+}
+
+#if TAM_FLIGHT_RECORDER
+TEST_F(RunTest, PostMortemStopsAtOldestRecord) {
+    // LOADL 300, CALL pred, LOAD(1) -1[ST], JUMPIF(0) 5[CB], JUMP 1[CB],
+    // LOADL 0, CALL div
+    CodeVec code{0x3000012c, 0x62000006, 0x0501ffff, 0xe0000005,
+                 0xc0000001, 0x30000000, 0x6200000b};
+    this->LoadProgram(code);
+
+    tam::RunResult result = this->TamEmulator::Run(10000);
+    ASSERT_EQ(tam::StopReason::kError, result.reason);
+
+    // the first jumps have been overwritten, so the listing starts with the
+    // jump that made the oldest transfer still recorded
+    std::string post_mortem = this->GetPostMortem(10000);
+    EXPECT_NE(std::string::npos,
+              post_mortem.find("        ST   LB   HT\n"
+                               "(earlier instructions were not recorded)\n"
+                               "0004:                   JUMP 1[CB]\n"
+                               "0001:   0001 0000 ffff  CALL pred\n"));
+    EXPECT_EQ(std::string::npos, this->GetPostMortem().find("not recorded"));
+}
+#endif
+
+TEST_F(RunTest, RunPrimitivesMatchExecute) {
+    // for each of the primitives `id` to `gt`: LOADL 7, LOADL -3, CALL prim
+    for (tam::TamCode prim = 1; prim <= 16; ++prim) {
+        CodeVec code{0x30000007, 0x3000fffd, 0x62000000 | prim, 0xf0000000};
+
+        this->LoadProgram(code);
+        this->registers_[tam::CP] = 0;
+        this->registers_[tam::ST] = 0;
+        ASSERT_EQ(tam::StopReason::kHalted,
+                  this->TamEmulator::Run(100).reason);
+        DataVec run_stack(
+            this->data_store_.begin(),
+            this->data_store_.begin() + this->registers_[tam::ST]);
+
+        this->registers_[tam::CP] = 0;
+        this->registers_[tam::ST] = 0;
+        while (this->Execute(this->FetchDecode()));
+        DataVec execute_stack(
+            this->data_store_.begin(),
+            this->data_store_.begin() + this->registers_[tam::ST]);
+
+        EXPECT_EQ(execute_stack, run_stack) << tam::primitive_names[prim];
+    }
+}
+
+TEST(RunMemoryIoTest, RunWithMemoryIo) {
+    // PUSH 1, LOADA 0[SB], CALL getint, LOAD(1) 0[SB], CALL succ,
+    // CALL putint, CALL puteol, HALT
+    CodeVec code{0xa0000001, 0x14000000, 0x62000019, 0x04010000,
+                 0x62000005, 0x6200001a, 0x62000018, 0xf0000000};
+
+    std::string input = "41\n";
+    auto output = std::make_unique<tam::BufferOutput>();
+    tam::BufferOutput& buffer = *output;
+    tam::TamEmulator emulator(std::make_unique<tam::MemoryInput>(input),
+                              std::move(output));
+    emulator.LoadProgram(code);
+
+    tam::RunResult result = emulator.Run(100);
+    EXPECT_EQ(tam::StopReason::kHalted, result.reason);
+    EXPECT_EQ("42\n", buffer.str());
+}
+
+TEST(RunMemoryIoTest, EmulatorsShareProgram) {
+    // PUSH 1, LOADA 0[SB], CALL getint, LOAD(1) 0[SB], CALL succ,
+    // CALL putint, CALL puteol, HALT
+    CodeVec code{0xa0000001, 0x14000000, 0x62000019, 0x04010000,
+                 0x62000005, 0x6200001a, 0x62000018, 0xf0000000};
+    std::shared_ptr<const tam::TamProgram> program =
+        tam::TamProgram::FromCode(code);
+
+    std::string input1 = "41\n", input2 = "-8\n";
+    auto output1 = std::make_unique<tam::BufferOutput>();
+    auto output2 = std::make_unique<tam::BufferOutput>();
+    tam::BufferOutput &buffer1 = *output1, &buffer2 = *output2;
+    tam::TamEmulator emulator1(std::make_unique<tam::MemoryInput>(input1),
+                               std::move(output1));
+    tam::TamEmulator emulator2(std::make_unique<tam::MemoryInput>(input2),
+                               std::move(output2));
+    emulator1.LoadProgram(program);
+    emulator2.LoadProgram(program);
+    EXPECT_EQ(program, emulator1.GetProgram());
+    EXPECT_EQ(3, program.use_count());
+
+    // interleave the two so that each relies only on its own state
+    EXPECT_EQ(4, emulator1.Run(4).steps);
+    EXPECT_EQ(4, emulator2.Run(4).steps);
+    EXPECT_EQ(tam::StopReason::kHalted, emulator2.Run(100).reason);
+    EXPECT_EQ(tam::StopReason::kHalted, emulator1.Run(100).reason);
+    EXPECT_EQ("42\n", buffer1.str());
+    EXPECT_EQ("-7\n", buffer2.str());
+}
+
+TEST_F(RunTest, RunSuspendsForInput) {
+    // PUSH 1, LOADA 0[SB], CALL getint, LOAD(1) 0[SB], CALL succ,
+    // CALL putint, CALL puteol, HALT
+    CodeVec code{0xa0000001, 0x14000000, 0x62000019, 0x04010000,
+                 0x62000005, 0x6200001a, 0x62000018, 0xf0000000};
+    this->LoadProgram(code);
+
+    // natively too, where supported
+    for (bool jit : {false, true}) {
+        if (jit && !this->EnableJit()) break;
+        auto channel = std::make_unique<tam::ChannelInput>();
+        tam::ChannelInput& input = *channel;
+        auto output = std::make_unique<tam::BufferOutput>();
+        tam::BufferOutput& buffer = *output;
+        this->Reset(std::move(channel), std::move(output));
+
+        // the CALL is not counted, and is executed again on resuming
+        tam::RunResult result = this->TamEmulator::Run(100);
+        EXPECT_EQ(tam::StopReason::kInputBlocked, result.reason);
+        EXPECT_EQ(2, result.steps);
+        EXPECT_EQ(2, this->registers_[tam::CP]);
+        EXPECT_EQ(2, this->registers_[tam::ST]);
+
+        input.Feed("4", 1);
+        result = this->TamEmulator::Run(100);
+        EXPECT_EQ(tam::StopReason::kInputBlocked, result.reason);
+        EXPECT_EQ(0, result.steps);
+
+        input.Feed("1\n", 2);
+        result = this->TamEmulator::Run(100);
+        EXPECT_EQ(tam::StopReason::kHalted, result.reason);
+        EXPECT_EQ(6, result.steps);
+        EXPECT_EQ("42\n", buffer.str());
+    }
+}
+
+#if TAM_TEST_PIPES
+TEST(RunMemoryIoTest, EventLoopServesPipes) {
+    // PUSH 1, LOADA 0[SB], CALL getint, LOAD(1) 0[SB], CALL succ,
+    // CALL putint, CALL puteol, HALT
+    CodeVec code{0xa0000001, 0x14000000, 0x62000019, 0x04010000,
+                 0x62000005, 0x6200001a, 0x62000018, 0xf0000000};
+    std::shared_ptr<const tam::TamProgram> program =
+        tam::TamProgram::FromCode(code);
+
+    struct Session {
+        int pipe[2];
+        tam::ChannelInput* input;
+        tam::BufferOutput* output;
+        std::unique_ptr<tam::TamEmulator> emulator;
+        tam::RunResult result;
+    };
+    Session sessions[2];
+    for (Session& session : sessions) {
+        ASSERT_EQ(0, pipe(session.pipe));
+        auto input = std::make_unique<tam::ChannelInput>();
+        auto output = std::make_unique<tam::BufferOutput>();
+        session.input = input.get();
+        session.output = output.get();
+        session.emulator = std::make_unique<tam::TamEmulator>(
+            std::move(input), std::move(output));
+        session.emulator->LoadProgram(program);
+        session.result = session.emulator->Run(100);
+        EXPECT_EQ(tam::StopReason::kInputBlocked, session.result.reason);
+    }
+
+    // input arrives in pieces, and the second session's first
+    std::vector<std::pair<int, std::string>> writes{
+        {1, "-"}, {0, "1"}, {1, "50\n"}, {0, "9"}, {0, "9\n"}};
+    for (auto& write : writes) {
+        Session& writer = sessions[write.first];
+        ASSERT_EQ(write.second.size(),
+                  ::write(writer.pipe[1], write.second.data(),
+                          write.second.size()));
+
+        pollfd fds[2];
+        for (int I = 0; I < 2; ++I)
+            fds[I] = pollfd{sessions[I].pipe[0], POLLIN, 0};
+        ASSERT_EQ(1, poll(fds, 2, 1000));
+        for (int I = 0; I < 2; ++I) {
+            if (!(fds[I].revents & POLLIN)) continue;
+            Session& session = sessions[I];
+            EXPECT_LT(0, session.input->FeedFrom(session.pipe[0]));
+            session.result = session.emulator->Run(100);
+        }
+    }
+
+    EXPECT_EQ(tam::StopReason::kHalted, sessions[0].result.reason);
+    EXPECT_EQ("200\n", sessions[0].output->str());
+    EXPECT_EQ(tam::StopReason::kHalted, sessions[1].result.reason);
+    EXPECT_EQ("-49\n", sessions[1].output->str());
+
+    // closing the write end is seen as the end of the input
+    close(sessions[0].pipe[1]);
+    EXPECT_EQ(0, sessions[0].input->FeedFrom(sessions[0].pipe[0]));
+    EXPECT_TRUE(sessions[0].input->Closed());
+    close(sessions[0].pipe[0]);
+    close(sessions[1].pipe[0]);
+    close(sessions[1].pipe[1]);
+}
+#endif
+
+TEST_F(RunTest, ResetAfterRun) {
+    // PUSH 3, LOADL 1, STORE(1) 2[SB], LOADL 2, CALL new, LOADL 1,
+    // CALL putint, HALT
+    CodeVec code{0xa0000003, 0x30000001, 0x44010002, 0x30000002,
+                 0x6200001b, 0x30000001, 0x6200001a, 0xf0000000};
+    this->LoadProgram(code);
+
+    auto output = std::make_unique<tam::BufferOutput>();
+    this->setOutput(std::move(output));
+    ASSERT_EQ(tam::StopReason::kHalted, this->TamEmulator::Run(100).reason);
+    EXPECT_EQ(1, this->data_store_[2]);
+    EXPECT_EQ(65533, this->registers_[tam::HT]);
+
+    auto second_output = std::make_unique<tam::BufferOutput>();
+    tam::BufferOutput& buffer = *second_output;
+    this->Reset(std::make_unique<tam::MemoryInput>(""),
+                std::move(second_output));
+    EXPECT_EQ(0, this->registers_[tam::CP]);
+    EXPECT_EQ(0, this->registers_[tam::ST]);
+    EXPECT_EQ(65535, this->registers_[tam::HT]);
+    EXPECT_EQ(8, this->registers_[tam::CT]);
+    EXPECT_EQ(37, this->registers_[tam::PT]);
+    EXPECT_EQ(0, this->data_store_[2]);
+    EXPECT_EQ(0, this->GetHeapStats().allocated_blocks);
+
+    ASSERT_EQ(tam::StopReason::kHalted, this->TamEmulator::Run(100).reason);
+    EXPECT_EQ("1", buffer.str());
+    EXPECT_EQ(65533, this->registers_[tam::HT]);
+}
+
+TEST_F(RunTest, ResetClearsWordsReadIntoGap) {
+    // LOADL 30000, CALL get, LOADL -536, CALL getint, HALT
+    CodeVec code{0x30007530, 0x62000015, 0x3000fde8, 0x62000019, 0xf0000000};
+    this->LoadProgram(code);
+    this->Reset(std::make_unique<tam::MemoryInput>("A\n42\n"),
+                std::make_unique<tam::BufferOutput>());
+    ASSERT_EQ(tam::StopReason::kHalted, this->TamEmulator::Run(100).reason);
+    EXPECT_EQ('A', this->data_store_[30000]);
+    EXPECT_EQ(42, this->data_store_[65000]);
+
+    // PUSH 30001, LOAD(1) 30000[SB], CALL putint, HALT
+    CodeVec reader{0xa0007531, 0x04017530, 0x6200001a, 0xf0000000};
+    this->LoadProgram(reader);
+    auto output = std::make_unique<tam::BufferOutput>();
+    tam::BufferOutput& buffer = *output;
+    this->Reset(std::make_unique<tam::MemoryInput>(""), std::move(output));
+    EXPECT_EQ(0, this->data_store_[65000]);
+    ASSERT_EQ(tam::StopReason::kHalted, this->TamEmulator::Run(100).reason);
+    EXPECT_EQ("0", buffer.str());
+}
+
+TEST_F(RunTest, ResetClearsDeepStack) {
+    // LOADL 1000, CALL(SB) rec[CB], HALT,
+    // rec: LOAD(1) -1[LB], JUMPIF(0) done[CB], LOAD(1) -1[LB], CALL pred,
+    // CALL(SB) rec[CB], done: RETURN(0) 1
+    // leaves 1000 frames above the final `ST`
+    CodeVec code{0x300003e8, 0x60040003, 0xf0000000, 0x0801ffff, 0xe0000008,
+                 0x0801ffff, 0x62000006, 0x60040003, 0x80000001};
+    this->LoadProgram(code);
+    ASSERT_EQ(tam::StopReason::kHalted, this->TamEmulator::Run(100000).reason);
+
+    this->Reset();
+    for (int I = 0; I < tam::kMemSize; ++I)
+        ASSERT_EQ(0, this->data_store_[I]) << "address " << I;
+}
+
+TEST_F(RunTest, RunCountsStats) {
+    // LOADL 1, LOADL 2, CALL add, LOADL 3, CALL new, HALT
+    // `LOADL 2; CALL add` is fused but still counted as two instructions
+    CodeVec code{0x30000001, 0x30000002, 0x62000008,
+                 0x30000003, 0x6200001b, 0xf0000000};
+
+    this->LoadProgram(code);
+    for (uint64_t budget : {1, 100}) {
+        this->Reset();
+        this->EnableJit();
+        this->EnableStats();
+
+        tam::RunResult result;
+        do {
+            result = this->TamEmulator::Run(budget);
+        } while (result.reason == tam::StopReason::kBudgetExhausted);
+        ASSERT_EQ(tam::StopReason::kHalted, result.reason);
+
+        const tam::ExecutionStats& stats = this->GetStats();
+        EXPECT_EQ(6, stats.instructions);
+        EXPECT_EQ(3, stats.opcodes[tam::LOADL]);
+        EXPECT_EQ(2, stats.opcodes[tam::CALL]);
+        EXPECT_EQ(1, stats.opcodes[tam::HALT]);
+        EXPECT_EQ(1, stats.primitives[8]);
+        EXPECT_EQ(1, stats.primitives[27]);
+        EXPECT_EQ(1, stats.allocations);
+        EXPECT_EQ(2, stats.peak_st);
+        EXPECT_EQ(65532, stats.lowest_ht);
+    }
+
+    // stepping through the program counts the same
+    this->Reset();
+    this->EnableStats();
+    while (this->Execute(this->FetchDecode())) {
+    }
+    EXPECT_EQ(6, this->GetStats().instructions);
+    EXPECT_EQ(1, this->GetStats().primitives[8]);
+
+    // nothing is counted once disabled
+    this->Reset();
+    this->EnableStats(false);
+    ASSERT_EQ(tam::StopReason::kHalted, this->TamEmulator::Run(100).reason);
+    EXPECT_EQ(6, this->GetStats().instructions);
+}
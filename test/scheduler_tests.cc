@@ -0,0 +1,119 @@
+#include <stddef.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tam/io.h"
+#include "tam/program.h"
+#include "tam/scheduler.h"
+#include "tam/tam.h"
+
+#include <gtest/gtest.h>
+
+class SchedulerTest : public testing::Test {
+   protected:
+    /// The outcome of a task, recorded by its callback.
+    ///
+    struct Outcome {
+        tam::RunResult result;
+        std::string output;
+    };
+
+    /// Submit a task that records its outcome in `outcomes_`.
+    ///
+    tam::Scheduler::TaskId Submit(
+        tam::Scheduler& scheduler,
+        const std::shared_ptr<const tam::TamProgram>& program) {
+        auto output = std::make_unique<tam::BufferOutput>();
+        tam::BufferOutput* buffer = output.get();
+        return scheduler.Submit(
+            program, std::move(output),
+            [this, buffer](tam::Scheduler::TaskId id, tam::TamEmulator&,
+                           const tam::RunResult& result) {
+                std::lock_guard<std::mutex> lock(this->mutex_);
+                this->outcomes_[id] = Outcome{result, buffer->str()};
+            });
+    }
+
+    std::mutex mutex_;
+    std::map<tam::Scheduler::TaskId, Outcome> outcomes_;
+};
+
+TEST_F(SchedulerTest, RunsManyTasks) {
+    // PUSH 1, LOADL 1000, STORE(1) 0[SB],
+    // loop: LOAD(1) 0[SB], JUMPIF(0) end[CB], LOAD(1) 0[SB], CALL pred,
+    // STORE(1) 0[SB], JUMP loop[CB],
+    // end: LOADL 7, CALL putint, HALT
+    auto program = tam::TamProgram::FromCode(std::vector<tam::TamCode>{
+        0xa0000001, 0x300003e8, 0x44010000, 0x04010000, 0xe0000009,
+        0x04010000, 0x62000006, 0x44010000, 0xc0000003, 0x30000007,
+        0x6200001a, 0xf0000000});
+
+    tam::SchedulerOptions options;
+    options.threads = 3;
+    options.quantum = 100;
+    tam::Scheduler scheduler(options);
+
+    std::vector<tam::Scheduler::TaskId> ids;
+    for (int I = 0; I < 200; ++I)
+        ids.push_back(this->Submit(scheduler, program));
+    scheduler.WaitIdle();
+
+    EXPECT_EQ(0, scheduler.TaskCount());
+    ASSERT_EQ(ids.size(), this->outcomes_.size());
+    for (tam::Scheduler::TaskId id : ids) {
+        const Outcome& outcome = this->outcomes_[id];
+        EXPECT_EQ(tam::StopReason::kHalted, outcome.result.reason);
+        EXPECT_EQ(6008, outcome.result.steps);
+        EXPECT_EQ("7", outcome.output);
+    }
+}
+
+TEST_F(SchedulerTest, ParksTasksWaitingForInput) {
+    // PUSH 1, LOADA 0[SB], CALL getint, LOAD(1) 0[SB], CALL succ,
+    // CALL putint, CALL puteol, HALT
+    auto program = tam::TamProgram::FromCode(std::vector<tam::TamCode>{
+        0xa0000001, 0x14000000, 0x62000019, 0x04010000, 0x62000005,
+        0x6200001a, 0x62000018, 0xf0000000});
+
+    tam::SchedulerOptions options;
+    options.threads = 2;
+    tam::Scheduler scheduler(options);
+
+    tam::Scheduler::TaskId first = this->Submit(scheduler, program),
+                           second = this->Submit(scheduler, program);
+    scheduler.WaitIdle();
+    EXPECT_EQ(2, scheduler.TaskCount());
+
+    EXPECT_TRUE(scheduler.Feed(first, "4", 1));
+    scheduler.WaitIdle();
+    EXPECT_EQ(2, scheduler.TaskCount());
+
+    EXPECT_TRUE(scheduler.Feed(first, "1\n", 2));
+    EXPECT_TRUE(scheduler.Feed(second, "-1", 2));
+    EXPECT_TRUE(scheduler.CloseInput(second));
+    scheduler.WaitIdle();
+    EXPECT_EQ(0, scheduler.TaskCount());
+    EXPECT_FALSE(scheduler.Feed(first, "1", 1));
+
+    EXPECT_EQ(tam::StopReason::kHalted, this->outcomes_[first].result.reason);
+    EXPECT_EQ("42\n", this->outcomes_[first].output);
+    EXPECT_EQ(tam::StopReason::kHalted, this->outcomes_[second].result.reason);
+    EXPECT_EQ("0\n", this->outcomes_[second].output);
+}
+
+TEST_F(SchedulerTest, ReportsErrors) {
+    // LOADL 1, LOADL 0, CALL div, HALT
+    auto program = tam::TamProgram::FromCode(std::vector<tam::TamCode>{
+        0x30000001, 0x30000000, 0x6200000b, 0xf0000000});
+
+    tam::Scheduler scheduler;
+    tam::Scheduler::TaskId id = this->Submit(scheduler, program);
+    scheduler.WaitIdle();
+
+    EXPECT_EQ(tam::StopReason::kError, this->outcomes_[id].result.reason);
+    EXPECT_EQ(3, this->outcomes_[id].result.steps);
+}
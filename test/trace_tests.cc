@@ -0,0 +1,108 @@
+#include <stdio.h>
+
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "tam/io.h"
+#include "tam/program.h"
+#include "tam/tam.h"
+#include "tam/trace.h"
+
+#include <gtest/gtest.h>
+
+/// The state of the emulator after an instruction, as a trace shows it.
+///
+struct Tick {
+    tam::TamAddr addr;
+    std::string mnemonic;
+    std::vector<tam::TamAddr> registers;
+    std::string snapshot;
+};
+
+class TraceTest : public testing::Test {
+   protected:
+    void TearDown() override { std::filesystem::remove(this->path_); }
+
+    std::string path_ =
+        (std::filesystem::temp_directory_path() / "tam_trace_test.bin")
+            .string();
+
+    /// Trace a program at level 3 and check that replaying the trace shows
+    /// the same state after every instruction as the emulator did.
+    void ExpectReplay(const std::vector<tam::TamCode>& code) {
+        tam::TamEmulator emulator(std::make_unique<tam::MemoryInput>(""),
+                                  std::make_unique<tam::BufferOutput>());
+        emulator.LoadProgram(tam::TamProgram::FromCode(code));
+
+        std::vector<Tick> expected;
+        {
+            FILE* file = fopen(this->path_.c_str(), "wb");
+            ASSERT_TRUE(file);
+            tam::TraceWriter writer(file, emulator, 3);
+            bool running = true;
+            while (running) {
+                tam::TamAddr addr = emulator.RegisterValue(tam::CP);
+                tam::TamInstruction instr = emulator.FetchDecode();
+                running = emulator.Execute(instr);
+                writer.Record(instr);
+
+                Tick tick{addr, tam::GetMnemonic(instr), {},
+                          emulator.GetSnapshot()};
+                for (int I = 0; I < 16; ++I)
+                    tick.registers.push_back(
+                        emulator.RegisterValue(tam::TamRegister(I)));
+                expected.push_back(tick);
+            }
+            ASSERT_TRUE(writer.Flush());
+        }
+
+        FILE* file = fopen(this->path_.c_str(), "rb");
+        ASSERT_TRUE(file);
+        tam::TraceReader reader(file);
+        EXPECT_EQ(3, reader.Level());
+        for (const Tick& tick : expected) {
+            ASSERT_TRUE(reader.Next());
+            EXPECT_EQ(tick.addr, reader.Address());
+            EXPECT_EQ(tick.mnemonic, tam::GetMnemonic(reader.Instruction()));
+            for (int I = 0; I < 16; ++I)
+                EXPECT_EQ(tick.registers[I],
+                          reader.RegisterValue(tam::TamRegister(I)))
+                    << "register " << I << " at " << tick.addr;
+            EXPECT_EQ(tick.snapshot, reader.GetSnapshot())
+                << "at " << tick.addr;
+        }
+        EXPECT_FALSE(reader.Next());
+    }
+};
+
+TEST_F(TraceTest, ReaderReplaysWriter) {
+    // PUSH 2, LOADL 3, CALL new, STORE(1) 0[SB], LOADL 7, LOAD(1) 0[SB],
+    // STOREI(1), LOADL 2, CALL new, STORE(1) 1[SB], LOADL 3, LOAD(1) 0[SB],
+    // CALL dispose, LOADL 5, LOAD(1) 1[SB], STOREI(1), HALT
+    this->ExpectReplay({0xa0000002, 0x30000003, 0x6200001b, 0x44010000,
+                        0x30000007, 0x04010000, 0x50010000, 0x30000002,
+                        0x6200001b, 0x44010001, 0x30000003, 0x04010000,
+                        0x6200001c, 0x30000005, 0x04010001, 0x50010000,
+                        0xf0000000});
+}
+
+TEST_F(TraceTest, ReaderReplaysWordsAbovePoppedStack) {
+    // LOADL 1, LOADL 2, POP(0) 2, PUSH 2, CALL(SB) proc[CB], HALT,
+    // proc: LOADL 9, RETURN(1) 0
+    this->ExpectReplay({0x30000001, 0x30000002, 0xb0000002, 0xa0000002,
+                        0x60040006, 0xf0000000, 0x30000009, 0x80010000});
+}
+
+TEST_F(TraceTest, ReaderRejectsOtherFiles) {
+    FILE* file = fopen(this->path_.c_str(), "wb");
+    ASSERT_TRUE(file);
+    fputs("not a trace", file);
+    fclose(file);
+
+    file = fopen(this->path_.c_str(), "rb");
+    ASSERT_TRUE(file);
+    EXPECT_THROW(tam::TraceReader reader(file), std::runtime_error);
+}
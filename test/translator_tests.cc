@@ -0,0 +1,61 @@
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "tam/translator.h"
+
+#include <gtest/gtest.h>
+
+TEST(TranslatorTests, LabelsEveryAddress) {
+    // LOADL 1, LOADL 2, CALL add, HALT
+    std::vector<uint32_t> program{0x30000001, 0x30000002, 0x62000008,
+                                  0xf0000000};
+    std::string source = TranslateProgram(program, "add.tam");
+
+    EXPECT_NE(std::string::npos, source.find("from add.tam"));
+    EXPECT_NE(std::string::npos, source.find("int main()"));
+    EXPECT_NE(std::string::npos, source.find("kCodeTop = 4;"));
+    for (int I = 0; I < 4; ++I) {
+        std::string label = "L" + std::to_string(I) + ":";
+        EXPECT_NE(std::string::npos, source.find(label)) << label;
+    }
+    EXPECT_EQ(std::string::npos, source.find("L4:"));
+    EXPECT_NE(std::string::npos, source.find("push(arg1 + arg2, 2);"));
+}
+
+TEST(TranslatorTests, StaticJumpsUseGoto) {
+    // JUMP 2[CB], HALT, JUMPIF(1) 1[CB], JUMP 0[SB]
+    std::vector<uint32_t> program{0xc0000002, 0xf0000000, 0xe0010001,
+                                  0xc4000000};
+    std::string source = TranslateProgram(program, "jump.tam");
+
+    EXPECT_NE(std::string::npos, source.find("goto L2;"));
+    EXPECT_NE(std::string::npos, source.find("goto L1;"));
+    EXPECT_NE(std::string::npos, source.find("target = regs[4];"));
+}
+
+TEST(TranslatorTests, DynamicJumpsUseDispatch) {
+    // LOADA 1[CB], JUMPI, HALT
+    std::vector<uint32_t> program{0x10000001, 0xd0000000, 0xf0000000};
+    std::string source = TranslateProgram(program, "jumpi.tam");
+
+    EXPECT_NE(std::string::npos, source.find("target = pop(1);"));
+    EXPECT_NE(std::string::npos, source.find("switch (target)"));
+    EXPECT_NE(std::string::npos, source.find("case 2:"));
+}
+
+TEST(TranslatorTests, FrameAddressesWrap) {
+    // CALL(CB) 2[CB], HALT, RETURN(1) 0
+    std::vector<uint32_t> program{0x60000002, 0xf0000000, 0x80010000};
+    std::string source = TranslateProgram(program, "return.tam");
+
+    EXPECT_NE(std::string::npos, source.find("data[TamAddr(lb + 1)]"));
+    EXPECT_NE(std::string::npos, source.find("data[TamAddr(lb + 2)]"));
+    EXPECT_NE(std::string::npos,
+              source.find("push(data[TamAddr(result_addr + I)], 2);"));
+}
+
+TEST(TranslatorTests, ProgramTooLarge) {
+    std::vector<uint32_t> program(65536, 0xf0000000);
+    EXPECT_THROW(TranslateProgram(program, "large.tam"), std::runtime_error);
+}